@@ -0,0 +1,39 @@
+/* clpc is a tiny client shim for programs that serve commands via
+ * clp_serve(), e.g., "clpc /tmp/prog.sock prog stats -j".  It passes
+ * its stdin, stdout, and stderr to the server, and exits with the
+ * exit code of the command.
+ */
+#include <stdio.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    { .name = "socket", .help = "path to the server's socket" },
+    { .name = "command...", .help = "command and its arguments" },
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc || clp_given('h', optionv, NULL))
+        return rc;
+
+    argc -= optind;
+    argv += optind;
+
+    rc = clp_client(argv[0], argc - 1, argv + 1);
+    if (rc && errno)
+        fprintf(stderr, "clpc: %s: %s\n", argv[0], strerror(errno));
+
+    return rc;
+}
@@ -9,11 +9,12 @@
 struct clp_option optionv[];
 struct clp_subcmd *subcmd;
 clp_posparam_cb do_cmd;
+clp_posparam_cb do_bar;
 
 char version[] = "1.2.3";
 int verbosity, dryrun;
 int foo, bar, baz;
-char *nvpair;
+struct clp_kvmap nvmap;
 FILE *fp;
 
 struct clp_posparam posparamv_foo[] = {
@@ -27,7 +28,7 @@ struct clp_option optionv_foo[] = {
 };
 
 struct clp_posparam posparamv_bar[] = {
-    CLP_POSPARAM("[name=value ...]", string, nvpair, NULL, do_cmd,
+    CLP_POSPARAM("[name=value ...]", kvmap, nvmap, NULL, do_bar,
                  "zero or more nv pairs"),
     CLP_POSPARAM_END
 };
@@ -77,6 +78,18 @@ do_cmd(struct clp_posparam *param)
     return 0;
 }
 
+int
+do_bar(struct clp_posparam *param)
+{
+    do_cmd(param);
+
+    for (size_t i = 0; i < nvmap.entc; ++i)
+        printf("%s: %s = %s\n", subcmd->name, nvmap.entv[i].key,
+               clp_kvmap_get(&nvmap, nvmap.entv[i].key, "(nil)"));
+
+    return 0;
+}
+
 int
 main(int argc, char **argv)
 {
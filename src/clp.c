@@ -25,6 +25,10 @@
  * $Id: clp.c 386 2016-01-27 13:25:47Z greg $
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE     // O_DIRECT, O_NOATIME, fallocate()
+#endif
+
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -36,7 +40,23 @@
 #include <getopt.h>
 #include <math.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/param.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <glob.h>
+#include <dirent.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #include "clp.h"
 
@@ -81,6 +101,126 @@ struct clp_posparam clp_posparam_none[] = {
     { .name = NULL }
 };
 
+/* Long options are sorted by name so that abbreviated long options
+ * can be resolved by binary search.
+ */
+struct clp_longopt {
+    const char          *name;
+    size_t               len;
+    int                  optidx;        // Index into level->optionv[]
+};
+
+/* Subcommands are sorted by name so that abbreviated subcommands
+ * can be resolved by binary search.
+ */
+struct clp_subent {
+    const char          *name;
+    size_t               len;
+    struct clp_subcmd   *subcmd;
+};
+
+struct clp_subidx {
+    struct clp_subcmd   *subcmdv;       // From cvtparms of a subcmd posparam
+    int                  subc;          // Count of elements in subcmdv[]
+    struct clp_subent   *subv;          // subcmdv[] sorted by name
+    struct clp_level   **levelv;        // Compiled level of each subcmdv[]
+};
+
+/* A level is the compiled form of one option vector and its posparam
+ * vectors, i.e., one node of a (possibly trivial) tree of subcommands.
+ */
+struct clp_level {
+    struct clp_level    *next;          // Table's list of levels
+    struct clp_option   *optionv;
+    struct clp_posparam *paramv;
+    size_t               optionc;       // Count of elements in optionv[]
+    int                  opthelp;       // The option tied to clp_help()
+    bool                 wlongopt;      // Enable "-W longopt" syntax
+    int                  longoptc;
+    int                  paramvc;
+    int                  subidxc;
+    struct clp_longopt  *longoptv;
+    struct clp_posparam **paramvv;      // paramv and all option paramvs
+    int                 *posminv;       // Min args of each paramvv[]
+    int                 *posmaxv;       // Max args of each paramvv[]
+    struct clp_subidx   *subidxv;
+    char                 usehelp[24];   // ", use -h for help"
+    struct clp_strbuf   *helpv[4];      // Cached help, indexed by CLP_HELP_*
+    unsigned short       optmap[UCHAR_MAX + 1]; // optopt to optionv[] index + 1
+};
+
+/* Help text is rendered once per level and then cached.  It does not
+ * depend upon argv[0], so the text records the offsets at which the
+ * basename must be inserted when it is emitted.
+ */
+struct clp_strbuf {
+    char                *data;
+    size_t               len;
+    size_t               size;
+    size_t              *basev;         // Basename insertion offsets
+    int                  basec;
+    int                  basemax;
+    int                  err;           // errno of first failure
+};
+
+/* The generation of the root level's option values last committed by
+ * clp_table_reload(), along with the default value of each option.
+ */
+struct clp_gen {
+    char               **textv;         // Last optarg of each option (if any)
+    struct clp_hold    **holdv;         // Hold on each value shared with snapshots
+    int                 *givenv;        // Given count of each option
+    size_t              *offv;          // Offset of each option in dfltv[]
+    unsigned char       *dfltv;         // Default value of each option
+    unsigned char       *stagev;        // Staged value of each option
+    size_t               valsz;         // Size of dfltv[] (and of stagev[])
+};
+
+/* A reference counted hold on a value (e.g., a file descriptor or FILE
+ * pointer) shared by the live options of a table with its snapshots.
+ * The value is released only when the option no longer has it and the
+ * last snapshot that shares it has been released.
+ */
+struct clp_hold {
+    long                 refcnt;
+    clp_cvt_cb          *cvtfunc;
+    unsigned char        val[] __attribute__((__aligned__(16)));
+};
+
+/* An immutable copy of the values of a table's root options, as made by
+ * clp_table_publish().  Strings, lists and maps are copied into strv[],
+ * and other values that own resources (e.g., FILE pointers) are shared
+ * with the live options via a hold in holdv[].
+ */
+struct clp_snap {
+    long                 refcnt;
+    unsigned long        gen;
+    const struct clp_level *lvl;
+    const size_t        *offv;          // Offset of each option in valv[]
+    struct clp_hold    **holdv;         // Hold on each shared value (if any)
+    unsigned char       *valv;
+    char                 strv[];
+};
+
+struct clp_table {
+    struct clp_level    *root;
+    struct clp_level    *levels;
+    struct clp_gen      *gen;
+
+    struct clp_snap     *snap;          // The published snapshot (if any)
+    unsigned long        snapgen;       // Generation of the last snapshot
+    unsigned int         snapepoch;     // Selects the active snapreaders[]
+    long                 snapreaders[2]; // Readers in clp_snap_acquire()
+
+    int                  watchfd;       // inotify fd (see clp_table_watch())
+    char                *watchname;     // Name of the watched file
+
+    void                *blob;          // Mapping bound by clp_table_restore()
+    size_t               blobsz;
+
+    struct clp_cache    *cache;         // See clp_table_cache()
+};
+
 
 #ifdef CLP_DEBUG
 static int clp_debug;
@@ -149,10 +289,218 @@ clp_eprint(struct clp *clp, const char *fmt, ...)
     errno = xerrno;
 }
 
+/* Record an error detected while parsing into clp->error, where index
+ * is the index into the given argv[] of the offending argument (or -1).
+ * Other than copying whatever a converter or callback may have left in
+ * clp->errbuf, nothing is formatted here (see clp_error_format()).
+ *
+ * Returns the given exit code.
+ */
+static int
+clp_fail(struct clp *clp, int code, int kind, char **argv, int index,
+         const char *arg, const struct clp_option *o, int count)
+{
+    struct clp_error *err = clp->error;
+
+    err->code = code;
+    err->kind = kind;
+    err->argind = (index >= 0) ? (argv + index) - clp->argv : -1;
+    err->optopt = o ? o->optopt : 0;
+    err->xoptopt = 0;
+    err->count = count;
+    err->xerrno = errno;
+    err->opthelp = clp->opthelp;
+    err->basename = clp->basename;
+    err->arg = arg;
+    err->longopt = (o && o->longidx >= 0) ? o->longopt : NULL;
+    strcpy(err->detail, clp->errbuf);
+
+    return code;
+}
+
+/* Render the message for the given error into buf[] in the manner of
+ * snprintf(3).  The message is the same as would have been printed to
+ * stderr by clp_parsev() (sans the basename prefix).
+ */
+int
+clp_error_format(const struct clp_error *err, char *buf, size_t bufsz)
+{
+    char usehelp[24] = "";
+    const char *suffix;
+    int n;
+
+    if (!err || (!buf && bufsz > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (err->opthelp > 0)
+        snprintf(usehelp, sizeof(usehelp), ", use -%c for help", err->opthelp);
+
+    switch (err->kind) {
+    case CLP_ERR_OPTION:
+        return snprintf(buf, bufsz, "invalid option %s%s", err->arg, usehelp);
+
+    case CLP_ERR_NOARG:
+        return snprintf(buf, bufsz, "option %s requires a parameter%s",
+                        err->arg, usehelp);
+
+    case CLP_ERR_EXCLUDES:
+        return snprintf(buf, bufsz, "option -%c excludes -%c%s",
+                        err->xoptopt, err->optopt, usehelp);
+
+    case CLP_ERR_SUBCMD:
+        return snprintf(buf, bufsz, "%s subcommand '%s', use -h for help",
+                        (err->count > 1) ? "ambiguous" : "invalid", err->arg);
+
+    case CLP_ERR_TOOFEW:
+        return snprintf(buf, bufsz, "%d%s positional argument%s required%s",
+                        err->count, err->arg ? " more" : "",
+                        (err->count > 1) ? "s" : "", usehelp);
+
+    case CLP_ERR_TOOMANY:
+        return snprintf(buf, bufsz, "%d extraneous positional argument%s detected%s",
+                        err->count, (err->count > 1) ? "s" : "", usehelp);
+
+    case CLP_ERR_CONVERT:
+        /* As with clp_eprint(), a message from the converter supersedes
+         * ours unless it begins with punctuation, in which case it is
+         * appended to ours.
+         */
+        if (err->detail[0] && !ispunct(err->detail[0]))
+            break;
+
+        if (err->optopt > 0) {
+            char optstr[] = { err->optopt, '\000' };
+
+            n = snprintf(buf, bufsz, "unable to convert '%s%s %s'",
+                         err->longopt ? "--" : "-",
+                         err->longopt ? err->longopt : optstr, err->arg);
+        } else {
+            n = snprintf(buf, bufsz, "unable to convert '%s'", err->arg);
+        }
+
+        suffix = err->detail;
+        if (!suffix[0] && err->xerrno)
+            suffix = strerror(err->xerrno);
+
+        return n + snprintf(((size_t)n < bufsz) ? buf + n : NULL,
+                            ((size_t)n < bufsz) ? bufsz - n : 0,
+                            "%s%s", (suffix == err->detail) ? "" : ": ", suffix);
+
+    default:
+        break;
+    }
+
+    return snprintf(buf, bufsz, "%s", err->detail);
+}
+
 static bool
 clp_optopt_valid(int c)
 {
-    return isgraph(c) && !strchr(":?-", c);
+    return c > 0 && c <= UCHAR_MAX && isgraph(c) && !strchr(":?-", c);
+}
+
+/* Return the subcommand index of the given level for the given
+ * vector of subcommands, if any.
+ */
+static const struct clp_subidx *
+clp_level_subidx(const struct clp_level *lvl, const struct clp_subcmd *subcmdv)
+{
+    int i;
+
+    for (i = 0; lvl && i < lvl->subidxc; ++i) {
+        if (lvl->subidxv[i].subcmdv == subcmdv)
+            return lvl->subidxv + i;
+    }
+
+    return NULL;
+}
+
+static const struct clp_subidx *
+clp_subidx_find(const struct clp *clp, const struct clp_subcmd *subcmdv)
+{
+    return clp_level_subidx(clp ? clp->level : NULL, subcmdv);
+}
+
+/* Search the given subcommand index for the first len bytes of str,
+ * which may be an abbreviation of a subcommand name.  Returns the
+ * matching entry, if any, and the number of subcommands that matched
+ * via *nmatchp (an exact match is never ambiguous).
+ */
+static const struct clp_subent *
+clp_subidx_search(const struct clp_subidx *idx, const char *str, size_t len,
+                  int *nmatchp)
+{
+    const struct clp_subent *ent, *match = NULL;
+    int lb = 0, ub = idx->subc;
+    int nmatch = 0;
+
+    /* All subcommands that begin with str are adjacent in subv[],
+     * the first of which is at the lower bound of str.
+     */
+    while (lb < ub) {
+        int mid = (lb + ub) / 2;
+
+        if (strncmp(idx->subv[mid].name, str, len) < 0)
+            lb = mid + 1;
+        else
+            ub = mid;
+    }
+
+    for (ent = idx->subv + lb; ent < idx->subv + idx->subc; ++ent) {
+        if (strncmp(ent->name, str, len) || ++nmatch > 1)
+            break;
+
+        match = ent; // found a full or partial match
+
+        if (ent->len == len)
+            break; // an exact match is never ambiguous
+    }
+
+    *nmatchp = nmatch;
+
+    return match;
+}
+
+/* Return the subcommand from subcmdv[] named by str, which may be an
+ * unambiguous abbreviation, and the count of matching subcommands via
+ * *nmatchp.  Uses the index of the current level if there is one.
+ */
+static struct clp_subcmd *
+clp_subcmd_match(const struct clp *clp, struct clp_subcmd *subcmdv,
+                 const char *str, int *nmatchp)
+{
+    const struct clp_subidx *idx = clp_subidx_find(clp, subcmdv);
+    struct clp_subcmd *subcmd, *match = NULL;
+    size_t len = strlen(str);
+    int nmatch = 0;
+
+    if (idx) {
+        const struct clp_subent *ent;
+
+        ent = clp_subidx_search(idx, str, len, &nmatch);
+        if (ent)
+            match = ent->subcmd;
+    } else if (subcmdv) {
+        for (subcmd = subcmdv; subcmd->name; ++subcmd) {
+            if (strncmp(subcmd->name, str, len))
+                continue;
+
+            if (!subcmd->name[len]) {
+                match = subcmd;
+                nmatch = 1;
+                break;
+            }
+
+            if (nmatch++ == 0)
+                match = subcmd; // found a partial match
+        }
+    }
+
+    *nmatchp = nmatch;
+
+    return match;
 }
 
 #pragma GCC diagnostic push
@@ -191,1429 +539,9799 @@ clp_cvt_string(struct clp *clp, const char *optarg, int flags, void *parms, void
     return *result ? 0 : EX_OSERR;
 }
 
+/* Append optarg to the list at dst.  Unless flags includes CLP_LIST_REF,
+ * optarg is copied into the list's string buffer, which like the list's
+ * vector grows geometrically so that n appends cost O(n) time and only
+ * O(log n) calls to realloc().
+ */
 int
-clp_cvt_open(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+clp_cvt_list(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
 {
-    int *result = dst;
+    struct clp_list *list = dst;
+    const char *arg = optarg;
 
-    if (!result) {
+    if (!list || !optarg) {
         errno = EINVAL;
         return EX_DATAERR;
     }
 
-    *result = open(optarg, flags ? flags : O_RDONLY, 0644);
+    if (list->argc + 1 >= list->argmax) {
+        size_t argmax = list->argmax ? list->argmax * 2 : 16;
+        const char **argv;
 
-    return (*result >= 0) ? 0 : EX_NOINPUT;
-}
+        argv = realloc(list->argv, sizeof(*argv) * argmax);
+        if (!argv)
+            return EX_OSERR;
 
-int
-clp_cvt_fopen(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
-{
-    const char *mode = parms ? parms : "r";
-    FILE **result = dst;
+        list->argv = argv;
+        list->argmax = argmax;
+    }
 
-    if (!result) {
-        errno = EINVAL;
-        return EX_DATAERR;
+    if (!(flags & CLP_LIST_REF)) {
+        size_t len = strlen(optarg) + 1;
+
+        if (list->buflen + len > list->bufsz) {
+            size_t bufsz = MAX(list->bufsz * 2, list->buflen + len);
+            uintptr_t old = (uintptr_t)list->buf;
+            char *buf;
+
+            bufsz = MAX(bufsz, 256);
+
+            buf = realloc(list->buf, bufsz);
+            if (!buf)
+                return EX_OSERR;
+
+            /* Rebase the copies made thus far into the new buffer.
+             */
+            if ((uintptr_t)buf != old) {
+                for (size_t i = 0; i < list->argc; ++i)
+                    list->argv[i] = buf + ((uintptr_t)list->argv[i] - old);
+            }
+
+            list->buf = buf;
+            list->bufsz = bufsz;
+        }
+
+        arg = memcpy(list->buf + list->buflen, optarg, len);
+        list->buflen += len;
     }
 
-    *result = fopen(optarg, mode);
+    list->argv[list->argc++] = arg;
+    list->argv[list->argc] = NULL;
 
-    return *result ? 0 : EX_NOINPUT;
+    return 0;
 }
 
-int
-clp_cvt_incr(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+
+/* Free the storage of a list built by clp_cvt_list().
+ */
+void
+clp_list_free(struct clp_list *list)
 {
-    int *result = dst;
+    if (!list)
+        return;
 
-    if (!result) {
-        errno = EINVAL;
-        return EX_DATAERR;
-    }
+    free(list->argv);
+    free(list->buf);
+    memset(list, 0, sizeof(*list));
+}
 
-    *result += 1;
+/* Return the FNV-1a hash of the first len bytes of key.
+ */
+static uint32_t
+clp_kvmap_hash(const char *key, size_t len)
+{
+    uint32_t hash = 2166136261u;
 
-    return 0;
+    while (len-- > 0)
+        hash = (hash ^ (unsigned char)*key++) * 16777619u;
+
+    return hash;
 }
 
-/* The following macros will explode into a bunch of conversion functions.
- * With any luck the unused functions will be eliminated by the linker.
+/* Return the slot of map->idxv[] that refers to the entry of the given
+ * key, or else the empty slot at which it would be inserted.
  */
-CLP_CVT_TMPL(char,      char,       CHAR_MIN,   CHAR_MAX,    clp_suftab_default);
-CLP_CVT_TMPL(u_char,    u_char,     0,          UCHAR_MAX,   clp_suftab_default);
+static size_t
+clp_kvmap_probe(const struct clp_kvmap *map, const char *key, size_t len,
+                uint32_t hash)
+{
+    size_t mask = map->idxmax - 1;
+    size_t slot = hash & mask;
 
-CLP_CVT_TMPL(short,     short,      SHRT_MIN,   SHRT_MAX,    clp_suftab_default);
-CLP_CVT_TMPL(u_short,   u_short,    0,          USHRT_MAX,   clp_suftab_default);
+    while (map->idxv[slot]) {
+        const struct clp_kvent *ent = map->entv + map->idxv[slot] - 1;
 
-CLP_CVT_TMPL(int,       int,        INT_MIN,    INT_MAX,     clp_suftab_default);
-CLP_CVT_TMPL(u_int,     u_int,      0,          UINT_MAX,    clp_suftab_default);
+        if (ent->hash == hash && 0 == strncmp(ent->key, key, len) && !ent->key[len])
+            break;
 
-CLP_CVT_TMPL(long,      long,       LONG_MIN,   LONG_MAX,    clp_suftab_default);
-CLP_CVT_TMPL(u_long,    u_long,     0,          ULONG_MAX,   clp_suftab_default);
+        slot = (slot + 1) & mask;
+    }
 
-CLP_CVT_TMPL(float,     float,      -FLT_MAX,   FLT_MAX,     clp_suftab_default);
-CLP_CVT_TMPL(double,    double,     -DBL_MAX,   DBL_MAX,     clp_suftab_default);
+    return slot;
+}
 
-CLP_CVT_TMPL(int8_t,    int8_t,     INT8_MIN,   INT8_MAX,    clp_suftab_default);
-CLP_CVT_TMPL(uint8_t,   uint8_t,    0,          UINT8_MAX,   clp_suftab_default);
+/* Copy len bytes of src into the map's string buffer and terminate
+ * them, rebasing the keys and values of all the entries if the buffer
+ * moves.
+ */
+static const char *
+clp_kvmap_save(struct clp_kvmap *map, const char *src, size_t len)
+{
+    char *dst;
 
-CLP_CVT_TMPL(int16_t,   int16_t,    INT16_MIN,  INT16_MAX,   clp_suftab_default);
-CLP_CVT_TMPL(uint16_t,  uint16_t,   0,          UINT16_MAX,  clp_suftab_default);
+    if (map->buflen + len + 1 > map->bufsz) {
+        size_t bufsz = MAX(map->bufsz * 2, map->buflen + len + 1);
+        uintptr_t old = (uintptr_t)map->buf;
+        char *buf;
 
-CLP_CVT_TMPL(int32_t,   int32_t,    INT32_MIN,  INT32_MAX,   clp_suftab_default);
-CLP_CVT_TMPL(uint32_t,  uint32_t,   0,          UINT32_MAX,  clp_suftab_default);
+        bufsz = MAX(bufsz, 256);
 
-CLP_CVT_TMPL(int64_t,   int64_t,    INT64_MIN,  INT64_MAX,   clp_suftab_default);
-CLP_CVT_TMPL(uint64_t,  uint64_t,   0,          UINT64_MAX,  clp_suftab_default);
+        buf = realloc(map->buf, bufsz);
+        if (!buf)
+            return NULL;
 
-CLP_CVT_TMPL(intmax_t,  intmax_t,   INTMAX_MIN, INTMAX_MAX,  clp_suftab_default);
-CLP_CVT_TMPL(uintmax_t, uintmax_t,  0,          UINTMAX_MAX, clp_suftab_default);
+        if ((uintptr_t)buf != old) {
+            for (size_t i = 0; i < map->entc; ++i) {
+                struct clp_kvent *ent = map->entv + i;
 
-CLP_CVT_TMPL(intptr_t,  intptr_t,   INTPTR_MIN, INTPTR_MAX,  clp_suftab_default);
-CLP_CVT_TMPL(uintptr_t, uintptr_t,  0,          UINTPTR_MAX, clp_suftab_default);
+                ent->key = buf + ((uintptr_t)ent->key - old);
+                if (ent->val)
+                    ent->val = buf + ((uintptr_t)ent->val - old);
+            }
+        }
 
-CLP_CVT_TMPL(size_t,    size_t,     0,          SIZE_MAX,    clp_suftab_default);
-CLP_CVT_TMPL(time_t,    time_t,     0,          LONG_MAX,    clp_suftab_time);
+        map->buf = buf;
+        map->bufsz = bufsz;
+    }
 
-CLP_GET_TMPL(bool,      bool);
-CLP_GET_TMPL(incr,      int);
-CLP_GET_TMPL(open,      int);
-CLP_GET_TMPL(fopen,     FILE *);
-CLP_GET_TMPL(string,    char *);
+    dst = map->buf + map->buflen;
+    memcpy(dst, src, len);
+    dst[len] = '\000';
+    map->buflen += len + 1;
 
+    return dst;
+}
 
-int
-clp_cvt_subcmd(struct clp *clp, const char *str, int flags, void *parms, void *dst)
+/* Double the size of the map's index, and rehash its entries.
+ */
+static int
+clp_kvmap_grow(struct clp_kvmap *map)
 {
-    struct clp_subcmd *subcmd = parms;
-    struct clp_subcmd *match = NULL;
+    size_t idxmax = map->idxmax ? map->idxmax * 2 : 32;
+    uint32_t *idxv;
 
-    if (subcmd) {
-        for (; subcmd->name; ++subcmd) {
-            char *pc = strstr(subcmd->name, str);
-
-            if (!pc || pc != subcmd->name)
-                continue;
+    idxv = calloc(idxmax, sizeof(*idxv));
+    if (!idxv)
+        return ENOMEM;
 
-            if (match) {
-                clp_eprint(clp, "ambiguous subcommand '%s', use -h for help", str);
-                errno = EINVAL;
-                return EX_USAGE;
-            }
+    free(map->idxv);
+    map->idxv = idxv;
+    map->idxmax = idxmax;
 
-            match = subcmd; // found a full or partial match
-        }
-    }
+    for (size_t i = 0; i < map->entc; ++i) {
+        size_t slot = map->entv[i].hash & (idxmax - 1);
 
-    if (!match) {
-        clp_eprint(clp, "invalid subcommand '%s', use -h for help", str);
-        errno = EINVAL;
-        return EX_USAGE;
+        while (idxv[slot])
+            slot = (slot + 1) & (idxmax - 1);
+        idxv[slot] = i + 1;
     }
 
-    *(void **)dst = match;
-
     return 0;
 }
 
-int
-clp_action_subcmd(struct clp_posparam *param)
+/* Add the "key[=value]" pair given by the first len bytes of pair to
+ * the map, resolving a duplicate key per flags.
+ */
+static int
+clp_kvmap_put(struct clp *clp, struct clp_kvmap *map, const char *pair,
+              size_t len, int flags)
 {
-    struct clp_subcmd *subcmd = *(void **)param->cvtdst;
-    int rc;
+    const char *eq = memchr(pair, '=', len);
+    size_t keylen = eq ? (size_t)(eq - pair) : len;
+    const char *key, *val = NULL;
+    struct clp_kvent *ent;
+    uint32_t hash;
+    size_t slot;
+
+    if (keylen == 0) {
+        snprintf(clp->errbuf, sizeof(clp->errbuf), ": missing key");
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-    rc = clp_parsev(param->argc, param->argv, subcmd->optionv, subcmd->posparamv);
+    if ((map->entc + 1) * 2 > map->idxmax && clp_kvmap_grow(map))
+        return EX_OSERR;
 
-    return rc ?: -1;
-}
+    hash = clp_kvmap_hash(pair, keylen);
+    slot = clp_kvmap_probe(map, pair, keylen, hash);
 
-#pragma GCC diagnostic pop
+    if (map->idxv[slot]) {
+        ent = map->entv + map->idxv[slot] - 1;
 
-struct clp_option *
-clp_find(int c, struct clp_option *optionv)
-{
-    if (optionv) {
-        struct clp_option *o;
+        if (flags & CLP_KVMAP_UNIQUE) {
+            snprintf(clp->errbuf, sizeof(clp->errbuf), ": duplicate key '%s'", ent->key);
+            errno = EEXIST;
+            return EX_DATAERR;
+        }
 
-        for (o = optionv; o->optopt > 0; ++o) {
-            if (o->optopt == c)
-                return o;
+        if (flags & CLP_KVMAP_FIRST)
+            return 0;
+
+        if (eq) {
+            val = clp_kvmap_save(map, eq + 1, len - keylen - 1);
+            if (!val)
+                return EX_OSERR;
         }
+
+        map->entv[map->idxv[slot] - 1].val = val;
+
+        return 0;
     }
 
-    return NULL;
-}
+    if (map->entc >= map->entmax) {
+        size_t entmax = map->entmax ? map->entmax * 2 : 16;
+        struct clp_kvent *entv;
 
+        entv = realloc(map->entv, sizeof(*entv) * entmax);
+        if (!entv)
+            return EX_OSERR;
 
-struct clp_option *
-clp_given(int c, struct clp_option *optionv, void *dst)
-{
-    struct clp_option *o = clp_find(c, optionv);
+        map->entv = entv;
+        map->entmax = entmax;
+    }
 
-    if (o && o->given) {
-        if (dst && o->getfunc)
-            o->getfunc(o, dst);
+    key = clp_kvmap_save(map, pair, keylen);
+    if (!key)
+        return EX_OSERR;
 
-        return o;
+    if (eq) {
+        /* Saving the value may move the key.
+         */
+        size_t keyoff = key - map->buf;
+
+        val = clp_kvmap_save(map, eq + 1, len - keylen - 1);
+        if (!val)
+            return EX_OSERR;
+        key = map->buf + keyoff;
     }
 
-    return NULL;
+    ent = map->entv + map->entc++;
+    ent->key = key;
+    ent->val = val;
+    ent->hash = hash;
+
+    map->idxv[slot] = map->entc;
+
+    return 0;
 }
 
-/* Return true if the two specified options are mutually exclusive.
+/* Add each "key[=value]" pair of optarg to the map at dst, where parms
+ * (if not nil) is a string of the delimiters that separate the pairs
+ * (e.g., ",").  A key given without a value has a nil value.  Keys and
+ * values are copied into the map's string buffer, and the map's index
+ * is kept at most half full so that lookups take O(1) probes.
  */
-static int
-clp_excludes2(const struct clp_option *l, const struct clp_option *r)
+int
+clp_cvt_kvmap(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
 {
-    if (l && r && l != r) {
-        if (l->excludes) {
-            if (l->excludes[0] == '^') {
-                if (!strchr(l->excludes, r->optopt)) {
-                    return true;
-                }
-            } else {
-                if (l->excludes[0] == '*' || strchr(l->excludes, r->optopt)) {
-                    return true;
-                }
-            }
-        }
-        if (r->excludes) {
-            if (r->excludes[0] == '^') {
-                if (!strchr(r->excludes, l->optopt)) {
-                    return true;
-                }
-            } else {
-                if (r->excludes[0] == '*' || strchr(r->excludes, l->optopt)) {
-                    return true;
-                }
-            }
-        }
-        if (l->paramv && r->paramv && l->paramv != r->paramv) {
-            return true;
+    const char *delim = parms;
+    struct clp_kvmap *map = dst;
+    const char *str = optarg;
+
+    if (!map || !optarg) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    while (1) {
+        size_t len = delim ? strcspn(str, delim) : strlen(str);
+
+        if (len > 0) {
+            int rc = clp_kvmap_put(clp, map, str, len, flags);
+
+            if (rc)
+                return rc;
         }
+
+        if (!str[len])
+            break;
+
+        str += len + 1;
     }
 
-    return false;
+    return 0;
 }
 
-/* Return the opt letter of any option that is mutually exclusive
- * with the specified option and which appeared on the command line
- * at least the specified number of times.
+/* Return the entry of the given key (if any).
  */
-struct clp_option *
-clp_excludes(struct clp_option *first, const struct clp_option *option, int given)
+const struct clp_kvent *
+clp_kvmap_find(const struct clp_kvmap *map, const char *key)
 {
-    struct clp_option *o;
+    size_t len, slot;
 
-    for (o = first; o->optopt > 0; ++o) {
-        if (o->given >= given && clp_excludes2(option, o)) {
-            return o;
-        }
-    }
+    if (!map || !key || map->entc == 0)
+        return NULL;
 
-    return NULL;
+    len = strlen(key);
+    slot = clp_kvmap_probe(map, key, len, clp_kvmap_hash(key, len));
+
+    return map->idxv[slot] ? map->entv + map->idxv[slot] - 1 : NULL;
 }
 
-/* Trim leading white space from given string.  Returns NULL
- * if resulting string is zero length.  Typically, str is
- * either NULL or a zero length string on entry.
+/* Return the value of the given key, or dflt if the key is not in the
+ * map or was given without a value.
  */
-static const char *
-clp_trim(const char *str)
+const char *
+clp_kvmap_get(const struct clp_kvmap *map, const char *key, const char *dflt)
 {
-    while (str && isspace(str[0]))
-        ++str;
+    const struct clp_kvent *ent = clp_kvmap_find(map, key);
 
-    return (str && !str[0] ? NULL : str);
+    return (ent && ent->val) ? ent->val : dflt;
 }
 
-/* Return the count of leading open brackets, and the given name copied
- * to buf[] and stripped of brackets and leading/trailing white space.
+/* Free the storage of a map built by clp_cvt_kvmap().
  */
-int
-clp_unbracket(const char *name, char *buf, size_t bufsz)
+void
+clp_kvmap_free(struct clp_kvmap *map)
 {
-    char *bufbase = buf;
-    int obrackets = 0;
+    if (!map)
+        return;
 
-    if (!name || !buf || bufsz < 1) {
-        abort();
-    }
+    free(map->entv);
+    free(map->idxv);
+    free(map->buf);
+    memset(map, 0, sizeof(*map));
+}
 
-    // Count open brackets up to first non-space character.
-    while (isspace(*name) || *name == '[') {
-        obrackets += (*name == '[');
-        ++name;
-    }
+/* A name (or a prefix of a name) of an enum table, as indexed by the
+ * table's perfect hash.  A prefix shared by names of different values
+ * is ambiguous (unless it is itself one of the names).
+ */
+struct clp_enumkey {
+    const char          *name;          // The name (of which this is a prefix)
+    uint64_t             hash;
+    uint32_t             idx;           // Index into enumv[] of the name
+    uint32_t             len;           // Length of the prefix (zero if slot empty)
+    bool                 ambig;
+};
 
-    strncpy(buf, name, bufsz - 1);
-    buf[bufsz - 1] = '\000';
+/* The compiled form of an enum table, which is a perfect hash of every
+ * name and every prefix of a name built by "hash and displace":  Each
+ * key is first hashed to a bucket, and then the keys of each bucket
+ * (largest buckets first) are placed by searching for a displacement
+ * (d0, d1) that maps them all to distinct empty slots.  A lookup thus
+ * hashes its key once, and compares it with exactly one slot.
+ */
+struct clp_enumhash {
+    uint32_t             mask;          // Number of slots - 1
+    uint32_t             nbuckets;
+    uint32_t            *dispv;         // (d0, d1) of each bucket
+    struct clp_enumkey  *slotv;
+};
 
-    // Terminate buf at first bracket
-    while (*buf && *buf != ']' && *buf != '[')
-        ++buf;
-    *buf = '\000';
+static uint64_t
+clp_enum_hash(const char *str, size_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
 
-    // Eliminate trailing white space
-    while (buf-- > bufbase && isspace(*buf))
-        *buf = '\000';
+    while (len-- > 0)
+        hash = (hash ^ (unsigned char)*str++) * 1099511628211ull;
 
-    return obrackets;
+    return hash;
 }
 
-static struct clp_subcmd *
-clp_subcmd(const struct clp_posparam *param)
+static inline uint32_t
+clp_enum_bucket(const struct clp_enumhash *eh, uint64_t hash)
 {
-    struct clp_subcmd *subcmd = NULL;
+    return (uint32_t)(hash >> 32) % eh->nbuckets;
+}
 
-    if (param && param->cvtsubcmd)
-        subcmd = param->cvtparms;
+static inline uint32_t
+clp_enum_slot(const struct clp_enumhash *eh, uint64_t hash, uint32_t d0, uint32_t d1)
+{
+    uint32_t h1 = hash, h2 = (uint32_t)(hash >> 21) | 1;
 
-    return (subcmd && subcmd->name) ? subcmd : NULL;
+    return (h1 + d0 * h2 + d1) & eh->mask;
 }
 
-/* Lexical string comparator for qsort (e.g., AaBbCcDd...)
+/* Order prefixes by their text, and then by their length.
  */
 static int
-clp_string_cmp(const void *lhs, const void *rhs)
+clp_enum_keycmp(const void *lhs, const void *rhs)
 {
-    const char *l = (const char *)lhs;
-    const char *r = (const char *)rhs;
-    int lc = tolower(*l);
-    int rc = tolower(*r);
+    const struct clp_enumkey *l = lhs, *r = rhs;
+    int rc;
 
-    if (lc == rc) {
-        return (isupper(*l) ? -1 : 1);
-    }
+    rc = memcmp(l->name, r->name, MIN(l->len, r->len));
+    if (rc)
+        return rc;
 
-    return (lc - rc);
+    if (l->len != r->len)
+        return (l->len > r->len) ? 1 : -1;
+
+    return (l->idx > r->idx) - (l->idx < r->idx);
 }
 
-/* Print just the usage line, i.e., lines of the general form
- *   "usage: progname [options] args..."
+/* The number of displacements tried for each bucket by clp_enum_place(),
+ * and the number of times clp_enum_build() doubles the number of slots,
+ * before giving up.
  */
-static void  __attribute__((__nonnull__(1)))
-clp_usage(struct clp *clp, const struct clp_option *limit)
+#define CLP_ENUM_D0_MAX     (64)
+#define CLP_ENUM_D1_MAX     (256)
+#define CLP_ENUM_GROW_MAX   (4)
+
+/* Place the keyc keys of keyv[] into a perfect hash of nslots slots (a
+ * power of two).  Occupied slots are tracked in a bitmap, wherein the
+ * keys of the bucket being placed are marked as they are tried (and
+ * unmarked on collision), so that each displacement is checked in time
+ * proportional to the size of the bucket.  Returns nil and sets errno
+ * to ENOSPC if a bucket could not be placed within CLP_ENUM_D0_MAX *
+ * CLP_ENUM_D1_MAX displacements (in which case the caller should retry
+ * with more slots), or to ENOMEM.
+ */
+static struct clp_enumhash *
+clp_enum_place(const struct clp_enumkey *keyv, uint32_t keyc, uint32_t nslots)
 {
-    struct clp_posparam *paramv = clp->paramv;
-    char *pc_optarg, *pc_opt, *pc;
-    struct clp_posparam *param;
-    struct clp_option *o;
-    char *pc_excludes;
-    FILE *fp = stdout;
+    uint32_t nbuckets = keyc / 2 + 1;
+    struct clp_enumhash *eh;
+    uint32_t maxcount = 0;
+    uint64_t *usedv;
+    size_t sz;
 
-    if (clp->optionc > CLP_OPTION_MAX) {
-        abort();
+    sz = sizeof(*eh) + sizeof(*eh->slotv) * nslots + sizeof(*eh->dispv) * nbuckets * 2;
+
+    eh = calloc(1, sz);
+    if (!eh)
+        return NULL;
+
+    eh->slotv = (void *)(eh + 1);
+    eh->dispv = (void *)(eh->slotv + nslots);
+    eh->mask = nslots - 1;
+    eh->nbuckets = nbuckets;
+
+    usedv = calloc((nslots + 63) / 64, sizeof(*usedv));
+    uint32_t *startv = malloc(sizeof(*startv) * ((nbuckets + 1) * 2 + keyc * 2));
+    if (!startv || !usedv) {
+        free(startv);
+        free(usedv);
+        free(eh);
+        errno = ENOMEM;
+        return NULL;
     }
 
-    if (limit) {
-        bool limit_excl_all = limit->excludes && strchr("*^", limit->excludes[0]);
+    uint32_t *countv = startv + nbuckets + 1;
+    uint32_t *memberv = countv + nbuckets + 1;
+    uint32_t *slots = memberv + keyc;
 
-        if (!limit_excl_all && !limit->paramv) {
-            return;
-        }
+    memset(countv, 0, sizeof(*countv) * (nbuckets + 1));
 
-        if (limit->paramv) {
-            paramv = limit->paramv;
-        }
+    for (uint32_t i = 0; i < keyc; ++i) {
+        uint32_t b = clp_enum_bucket(eh, keyv[i].hash);
+
+        if (++countv[b] > maxcount)
+            maxcount = countv[b];
     }
 
-    char excludes_buf[clp->optionc + 1];
-    char optarg_buf[clp->optionc + 1];
-    char opt_buf[clp->optionc + 1];
+    startv[0] = 0;
+    for (uint32_t b = 0; b < nbuckets; ++b)
+        startv[b + 1] = startv[b] + countv[b];
 
-    pc_excludes = excludes_buf;
-    pc_optarg = optarg_buf;
-    pc_opt = opt_buf;
+    for (uint32_t i = 0; i < keyc; ++i) {
+        uint32_t b = clp_enum_bucket(eh, keyv[i].hash);
 
-    /* Build three lists of option characters:
-     *
-     * 1) excludes_buf[] contains all the options that might exclude
-     * or be excluded by another option that share the same parameter vector.
-     *
-     * 2) optarg_buf[] contains all the options not in (1) that require
-     * an argument.
-     *
-     * 3) opt_buf[] contains all the rest not covered by (1) or (2).
-     *
-     * Note: if 'limit' is not NULL, then only options that share
-     * the same paramv or have a NULL paramv may appear in one of
-     * the three lists.
-     */
-    for (o = clp->optionv; o->optopt > 0; ++o) {
-        if (!clp_optopt_valid(o->optopt))
-            continue;
+        memberv[startv[b] + --countv[b]] = i;
+    }
 
-        o->help = clp_trim(o->help);
+    /* Place the buckets in order of decreasing size, searching for the
+     * first displacement of each that puts all its keys in empty slots.
+     */
+    for (uint32_t size = maxcount; size > 0 && eh; --size) {
+        for (uint32_t b = 0; b < nbuckets && eh; ++b) {
+            uint32_t first = startv[b];
+            bool placed = false;
 
-        if (limit) {
-            if (clp_excludes2(limit, o)) {
+            if (startv[b + 1] - first != size)
                 continue;
-            }
-        } else if (o->paramv) {
-            continue;
-        }
 
-        if (o != limit && o->help) {
-            if (o->excludes) {
-                *pc_excludes++ = o->optopt;
-            } else {
-                struct clp_option *x = clp_excludes(clp->optionv, o, 0);
+            for (uint32_t d0 = 0; d0 < CLP_ENUM_D0_MAX && !placed; ++d0) {
+                for (uint32_t d1 = 0; d1 < CLP_ENUM_D1_MAX && !placed; ++d1) {
+                    uint32_t j;
 
-                if (x && x->paramv == o->paramv) {
-                    *pc_excludes++ = o->optopt;
-                } else if (o->argname) {
-                    *pc_optarg++ = o->optopt;
-                } else {
-                    *pc_opt++ = o->optopt;
+                    for (j = 0; j < size; ++j) {
+                        uint32_t slot;
+
+                        slot = clp_enum_slot(eh, keyv[memberv[first + j]].hash, d0, d1);
+                        if (usedv[slot / 64] & (1ull << (slot % 64)))
+                            break;
+
+                        usedv[slot / 64] |= 1ull << (slot % 64);
+                        slots[j] = slot;
+                    }
+
+                    if (j < size) {
+                        while (j-- > 0)
+                            usedv[slots[j] / 64] &= ~(1ull << (slots[j] % 64));
+                        continue;
+                    }
+
+                    for (j = 0; j < size; ++j)
+                        eh->slotv[slots[j]] = keyv[memberv[first + j]];
+
+                    eh->dispv[b * 2] = d0;
+                    eh->dispv[b * 2 + 1] = d1;
+                    placed = true;
                 }
             }
+
+            if (!placed) {
+                free(eh);
+                eh = NULL;
+                errno = ENOSPC;
+            }
         }
     }
 
-    *pc_excludes = '\000';
-    *pc_optarg = '\000';
-    *pc_opt = '\000';
-
-    qsort(opt_buf, strlen(opt_buf), 1, clp_string_cmp);
-    qsort(optarg_buf, strlen(optarg_buf), 1, clp_string_cmp);
-    qsort(excludes_buf, strlen(excludes_buf), 1, clp_string_cmp);
+    free(startv);
+    free(usedv);
 
-    if (limit)
-        clp_dprint(1, "  limit -%c:\n", limit->optopt);
-    clp_dprint(1, "  has excludes: %s\n", excludes_buf);
-    clp_dprint(1, "  has optarg:   %s\n", optarg_buf);
-    clp_dprint(1, "  bool opts:    %s\n", opt_buf);
+    return eh;
+}
 
-    /* Now print out the usage line in the form of:
-     *
-     * usage: basename [mandatory-opt] [bool-opts] [opts-with-args] [excl-opts] [posparams...]
-     */
+/* Compile the given enum table into a perfect hash of its names and of
+ * their prefixes, such that a name may be abbreviated to any prefix not
+ * shared with a name of a different value.  Sets errno and returns nil
+ * on error.
+ */
+static struct clp_enumhash *
+clp_enum_build(const struct clp_enum *enumv)
+{
+    struct clp_enumhash *eh = NULL;
+    struct clp_enumkey *keyv;
+    uint32_t keyc, nslots;
+    size_t n = 0;
 
-    /* [mandatory-opt]
-     */
-    fprintf(fp, "usage: %s", clp->basename);
-    if (limit) {
-        fprintf(fp, " -%c", limit->optopt);
-    }
+    for (size_t i = 0; enumv[i].name; ++i)
+        n += strlen(enumv[i].name);
 
-    /* [bool-opts]
-     */
-    if (opt_buf[0]) {
-        fprintf(fp, " [-%s]", opt_buf);
+    if (n == 0 || n > (1u << 24)) {
+        errno = EINVAL;
+        return NULL;
     }
 
-    /* [opts-with-args]
-     */
-    for (pc = optarg_buf; *pc; ++pc) {
-        o = clp_find(*pc, clp->optionv);
-        if (o) {
-            fprintf(fp, " [-%c %s]", o->optopt, o->argname);
+    keyv = malloc(sizeof(*keyv) * n);
+    if (!keyv)
+        return NULL;
+
+    keyc = 0;
+    for (uint32_t i = 0; enumv[i].name; ++i) {
+        for (size_t len = strlen(enumv[i].name); len > 0; --len) {
+            keyv[keyc].name = enumv[i].name;
+            keyv[keyc].idx = i;
+            keyv[keyc].len = len;
+            keyv[keyc].ambig = false;
+            ++keyc;
         }
     }
 
-    /* Generate the mutually exclusive option usage message...
-     * [excl-args]
+    /* Merge identical prefixes, preferring a complete name (the first
+     * if a name appears more than once).
      */
-    if (excludes_buf[0]) {
-        char *listv[clp->optionc + 1];
-        int listc = 0;
-        char *cur;
-        int i;
+    qsort(keyv, keyc, sizeof(*keyv), clp_enum_keycmp);
 
-        /* Build a vector of strings where each string contains
-         * mutually exclusive options.
-         */
-        for (cur = excludes_buf; *cur; ++cur) {
-            struct clp_option *l = clp_find(*cur, clp->optionv);
-            char buf[1024], *pc_buf;
-            char *tmp;
+    n = 0;
+    for (uint32_t i = 0; i < keyc; ) {
+        struct clp_enumkey key = keyv[i];
+        bool exact = !key.name[key.len];
 
-            pc_buf = buf;
+        while (++i < keyc && keyv[i].len == key.len &&
+               0 == memcmp(keyv[i].name, key.name, key.len)) {
+            const struct clp_enumkey *dup = keyv + i;
 
-            for (pc = excludes_buf; *pc; ++pc) {
-                if (cur == pc) {
-                    *pc_buf++ = *pc;
-                } else {
-                    struct clp_option *r = clp_find(*pc, clp->optionv);
+            if (exact)
+                continue;
 
-                    if (clp_excludes2(l, r)) {
-                        *pc_buf++ = *pc;
-                    }
-                }
+            if (!dup->name[dup->len]) {
+                key = *dup;
+                key.ambig = false;
+                exact = true;
+            } else if (enumv[dup->idx].value != enumv[key.idx].value) {
+                key.ambig = true;
             }
+        }
 
-            *pc_buf = '\000';
-
-            tmp = strdup(buf);
-            if (!tmp)
-                abort();
+        key.hash = clp_enum_hash(key.name, key.len);
+        keyv[n++] = key;
+    }
 
-            listv[listc++] = tmp;
-        }
+    keyc = n;
 
-        /* Eliminate duplicate strings.
-         */
-        for (i = 0; i < listc; ++i) {
-            int j;
-
-            for (j = i + 1; j < listc; ++j) {
-                if (listv[i] && listv[j]) {
-                    if (0 == strcmp(listv[i], listv[j])) {
-                        free(listv[j]);
-                        listv[j] = NULL;
-                    }
-                }
-            }
-        }
+    for (nslots = 8; nslots < keyc * 2; nslots *= 2)
+        continue;
 
-        /* Ensure that all options within a list are mutually exclusive.
-         */
-        for (i = 0; i < listc; ++i) {
-            if (listv[i]) {
-                for (pc = listv[i]; *pc; ++pc) {
-                    struct clp_option *l = clp_find(*pc, clp->optionv);
-                    char *pc2;
+    for (int i = 0; i <= CLP_ENUM_GROW_MAX && !eh; ++i) {
+        eh = clp_enum_place(keyv, keyc, nslots);
+        if (!eh && errno != ENOSPC)
+            break;
+        nslots *= 2;
+    }
 
-                    for (pc2 = listv[i]; *pc2; ++pc2) {
-                        if (pc2 != pc) {
-                            struct clp_option *r = clp_find(*pc2, clp->optionv);
-
-                            if (!clp_excludes2(l, r)) {
-                                free(listv[i]);
-                                listv[i] = NULL;
-                                goto next;
-                            }
-                        }
-                    }
-                }
-            }
+    free(keyv);
 
-          next:
-            continue;
-        }
+    return eh;
+}
 
-        /* Now, print out the remaining strings of mutually exclusive options.
-         */
-        for (i = 0; i < listc; ++i) {
-            if (listv[i]) {
-                const char *bar = " [";
+/* Return the perfect hash of the given enum table, compiling it if need
+ * be.  Concurrent callers may each compile the table, but only one
+ * result is retained.
+ */
+static const struct clp_enumhash *
+clp_enum_compile(struct clp_enumtab *tab)
+{
+    struct clp_enumhash *eh, *expected = NULL;
 
-                for (pc = listv[i]; *pc; ++pc) {
-                    o = clp_find(*pc, clp->optionv);
-                    if (o->argname) {
-                        fprintf(fp, "%s-%c %s", bar, *pc, o->argname);
-                    } else {
-                        fprintf(fp, "%s-%c", bar, *pc);
-                    }
+    eh = __atomic_load_n(&tab->hash, __ATOMIC_ACQUIRE);
+    if (eh)
+        return eh;
 
-                    bar = " | ";
-                }
+    if (!tab->enumv) {
+        errno = EINVAL;
+        return NULL;
+    }
 
-                fprintf(fp, "]");
+    eh = clp_enum_build(tab->enumv);
+    if (!eh)
+        return NULL;
 
-                free(listv[i]);
-            }
-        }
+    if (!__atomic_compare_exchange_n(&tab->hash, &expected, eh, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(eh);
+        eh = expected;
     }
 
-    /* Finally, print out all the positional parameters.
-     * [posparams...]
-     */
-    if (paramv) {
-        int noptional = 0;
-
-        for (param = paramv; param->name; ++param) {
-            char namebuf[128];
-            int isopt;
+    return eh;
+}
 
-            isopt = clp_unbracket(param->name, namebuf, sizeof(namebuf));
+/* Free the perfect hash compiled from the given enum table (if any).
+ */
+void
+clp_enumtab_free(struct clp_enumtab *tab)
+{
+    if (tab) {
+        free(tab->hash);
+        tab->hash = NULL;
+    }
+}
 
-            if (isopt) {
-                ++noptional;
-            }
+/* Look up the first len bytes of str in the given enum table, returning
+ * its entry if str is a name or an unambiguous prefix of a name.
+ * Otherwise, records why in clp->errbuf and returns nil.
+ */
+static const struct clp_enum *
+clp_enum_lookup(struct clp *clp, const struct clp_enumtab *tab,
+                const struct clp_enumhash *eh, const char *str, size_t len)
+{
+    const struct clp_enumkey *key;
+    uint64_t hash;
+    uint32_t b;
 
-            fprintf(fp, "%s%s", isopt ? " [" : " ", namebuf);
+    hash = clp_enum_hash(str, len);
+    b = clp_enum_bucket(eh, hash);
+    key = eh->slotv + clp_enum_slot(eh, hash, eh->dispv[b * 2], eh->dispv[b * 2 + 1]);
 
-            if (param[1].name) {
-                isopt = clp_unbracket(param[1].name, namebuf, sizeof(namebuf));
-            }
+    if (key->len == len && len > 0 && key->hash == hash &&
+        0 == memcmp(key->name, str, len)) {
+        if (!key->ambig)
+            return tab->enumv + key->idx;
 
-            /* If we're at the end of the list or the next parameter
-             * is not optional then print all the closing brackets.
-             */
-            if (!param[1].name || !isopt) {
-                for (; noptional > 0; --noptional) {
-                    fputc(']', fp);
-                }
-            }
-        }
+        snprintf(clp->errbuf, sizeof(clp->errbuf), ": ambiguous name '%.*s'", (int)len, str);
+    } else {
+        snprintf(clp->errbuf, sizeof(clp->errbuf), ": invalid name '%.*s'", (int)len, str);
     }
 
-    fprintf(fp, "%s\n", paramv ? "" : " [args...]");
+    errno = EINVAL;
+
+    return NULL;
 }
 
+/* Convert optarg to the value (an int) of the name it gives (or of the
+ * name of which it is an unambiguous prefix) per the enum table given by
+ * parms (a struct clp_enumtab *).
+ */
 int
-clp_version(struct clp_option *option)
+clp_cvt_enum(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
 {
-    printf("%s\n", (char *)option->cvtdst);
+    const struct clp_enumhash *eh;
+    const struct clp_enum *ent;
+    int *result = dst;
+
+    if (!result || !parms || !optarg) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    eh = clp_enum_compile(parms);
+    if (!eh) {
+        snprintf(clp->errbuf, sizeof(clp->errbuf), ": unable to compile enum table: %s",
+                 strerror(errno));
+        return EX_SOFTWARE;
+    }
+
+    ent = clp_enum_lookup(clp, parms, eh, optarg, strlen(optarg));
+    if (!ent)
+        return EX_DATAERR;
+
+    *result = ent->value;
 
     return 0;
 }
 
-/* Lexical option comparator for qsort (e.g., AaBbCcDd...)
+/* Convert optarg, a comma separated list of names, to the bitwise OR of
+ * their values (an unsigned int) as per clp_cvt_enum().
  */
-static int
-clp_help_cmp(const void *lhs, const void *rhs)
+int
+clp_cvt_flags(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
 {
-    struct clp_option const *l = *(struct clp_option * const *)lhs;
-    struct clp_option const *r = *(struct clp_option * const *)rhs;
+    const struct clp_enumhash *eh;
+    unsigned int *result = dst;
+    unsigned int bits = 0;
+    const char *str = optarg;
 
-    int lc = tolower(l->optopt);
-    int rc = tolower(r->optopt);
+    if (!result || !parms || !optarg) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-    if (lc == rc) {
-        return (isupper(l->optopt) ? -1 : 1);
+    eh = clp_enum_compile(parms);
+    if (!eh) {
+        snprintf(clp->errbuf, sizeof(clp->errbuf), ": unable to compile enum table: %s",
+                 strerror(errno));
+        return EX_SOFTWARE;
     }
 
-    return (lc - rc);
+    while (1) {
+        size_t len = strcspn(str, ",");
+
+        if (len > 0) {
+            const struct clp_enum *ent = clp_enum_lookup(clp, parms, eh, str, len);
+
+            if (!ent)
+                return EX_DATAERR;
+
+            bits |= ent->value;
+        }
+
+        if (!str[len])
+            break;
+
+        str += len + 1;
+    }
+
+    *result = bits;
+
+    return 0;
 }
 
-/* Print the entire help message, for example:
- *
- * usage: prog [-v] [-i intarg] src... dst
- * usage: prog -h
- * usage: prog -V
- * -h         print this help list
- * -i intarg  specify an integer argument
- * -V         print version
- * -v         increase verbosity
- * src...  specify one or more source files
- * dst     specify destination directory
+/* Empty the given list or map, retaining its storage for reuse.  Lists
+ * and maps accumulate all the occurrences of their option (or posparam)
+ * within one parse, but start anew in each parse.
  */
+static void
+clp_value_reset(clp_cvt_cb *cvtfunc, void *val)
+{
+    if (cvtfunc == clp_cvt_list) {
+        struct clp_list *list = val;
+
+        list->argc = 0;
+        list->buflen = 0;
+        if (list->argv)
+            list->argv[0] = NULL;
+    } else if (cvtfunc == clp_cvt_kvmap) {
+        struct clp_kvmap *map = val;
+
+        map->entc = 0;
+        map->buflen = 0;
+        if (map->idxv)
+            memset(map->idxv, 0, sizeof(*map->idxv) * map->idxmax);
+    }
+}
+
 int
-clp_help(struct clp_option *opthelp)
+clp_cvt_open(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
 {
-    struct clp_posparam *paramv, *param;
-    struct clp_option *option;
-    int subcmd_width, width;
-    size_t optionc;
-    bool longhelp;
-    struct clp *clp;
-    FILE *fp;
+    int *result = dst;
 
-    /* opthelp is the option that triggered clp into calling clp_help().
-     * Ususally -h, but the user could have changed it...
-     */
-    if (!opthelp) {
-        return 0;
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
     }
 
-    clp = opthelp->clp;
+    *result = open(optarg, flags ? flags : O_RDONLY, 0644);
 
-    /* Create an array of pointers to options and sort it.
-     */
-    struct clp_option *optionv[clp->optionc];
+    return (*result >= 0) ? 0 : EX_NOINPUT;
+}
 
-    for (size_t i = optionc = 0; i < clp->optionc; ++i) {
-        struct clp_option *o = clp->optionv + i;
+int
+clp_cvt_fopen(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+{
+    const char *mode = parms ? parms : "r";
+    FILE **result = dst;
 
-        if (clp_optopt_valid(o->optopt))
-            optionv[optionc++] = o;
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
     }
 
-    qsort(optionv, optionc, sizeof(optionv[0]), clp_help_cmp);
+    *result = fopen(optarg, mode);
 
-    /* Print the default usage line.
-     */
-    fp = opthelp->priv ? opthelp->priv : stdout;
-    clp_usage(clp, NULL);
+    return *result ? 0 : EX_NOINPUT;
+}
 
-    /* Print usage lines for each option that has positional parameters
-     * different than the default usage.
-     * Also, determine the width of the longest combination of option
-     * argument and long option names.
-     */
-    longhelp = (opthelp->longidx >= 0);
-    width = 0;
+#define CLP_MMAP_FLAGS      (MAP_POPULATE | MAP_NORESERVE)
 
-    for (size_t i = 0; i < optionc; ++i) {
-        int len = 0;
+/* Open and map the named file read-only.  flags are additional mmap()
+ * flags, of which only those in CLP_MMAP_FLAGS are honored (the mapping
+ * is always private), and parms (if not nil) points to the int advice
+ * to give madvise() (e.g., MADV_SEQUENTIAL).
+ */
+int
+clp_cvt_mmap(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+{
+    struct clp_mmap *result = dst;
+    struct stat sb;
 
-        option = optionv[i];
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-        if (!option->help) {
-            continue;
-        }
+    result->ptr = NULL;
+    result->len = 0;
 
-        clp_usage(clp, option);
+    result->fd = open(optarg, O_RDONLY | O_CLOEXEC);
+    if (result->fd == -1)
+        return EX_NOINPUT;
 
-        if (option->argname) {
-            len += strlen(option->argname) + 1;
-        }
-        if (longhelp && option->longopt) {
-            len += strlen(option->longopt) + 4;
-        }
-        if (len > width) {
-            width = len;
+    if (fstat(result->fd, &sb)) {
+        clp_munmap(result);
+        return EX_NOINPUT;
+    }
+
+    if (!S_ISREG(sb.st_mode)) {
+        clp_munmap(result);
+        errno = S_ISDIR(sb.st_mode) ? EISDIR : EINVAL;
+        return EX_NOINPUT;
+    }
+
+    if (sb.st_size > 0) {
+        void *ptr = mmap(NULL, sb.st_size, PROT_READ,
+                         MAP_PRIVATE | (flags & CLP_MMAP_FLAGS), result->fd, 0);
+
+        if (ptr == MAP_FAILED) {
+            clp_munmap(result);
+            return EX_NOINPUT;
         }
+
+        result->ptr = ptr;
+        result->len = sb.st_size;
+
+        if (parms)
+            madvise(ptr, result->len, *(const int *)parms);
     }
 
-    /* Print a line of help for each option.
-     */
-    for (size_t i = 0; i < optionc; ++i) {
-        char buf[width + 8];
+    return 0;
+}
 
-        option = optionv[i];
+/* Unmap and close a file mapped by clp_cvt_mmap().
+ */
+void
+clp_munmap(struct clp_mmap *map)
+{
+    int xerrno = errno;
 
-        if (!option->help)
-            continue;
+    if (!map)
+        return;
 
-        buf[0] = '\000';
+    if (map->ptr)
+        munmap(map->ptr, map->len);
+    if (map->fd >= 0)
+        close(map->fd);
 
-        if (longhelp && option->longopt) {
-            strcat(buf, ", --");
-            strcat(buf, option->longopt);
-        }
-        if (option->argname) {
-            strcat(buf, " ");
-            strcat(buf, option->argname);
-        }
+    map->ptr = NULL;
+    map->len = 0;
+    map->fd = -1;
 
-        fprintf(fp, "-%c%-*s  %s\n", option->optopt, width, buf, option->help);
+    errno = xerrno;
+}
+
+/* Open path per the given flags and the file parameters (if any) of the
+ * openx and fopenx converters.  O_DIRECT and O_NOATIME are requests that
+ * are dropped if the file system (or the file's owner) won't have them.
+ */
+static int
+clp_file_open(struct clp *clp, const char *path, int flags,
+              const struct clp_fileparms *parms, int *fdp)
+{
+    mode_t perm = 0644;
+    int fd;
+
+    if (parms) {
+        flags |= parms->flags;
+        if (parms->cloexec)
+            flags |= O_CLOEXEC;
+#ifdef O_DIRECT
+        if (parms->direct)
+            flags |= O_DIRECT;
+#endif
+#ifdef O_NOATIME
+        if (parms->noatime)
+            flags |= O_NOATIME;
+#endif
+        if (parms->perm)
+            perm = parms->perm;
     }
 
-    /* Determine the width of the longest positional parameter name.
-     */
-    subcmd_width = 0;
-    width = 0;
+    fd = open(path, flags, perm);
 
-    for (paramv = clp->params; paramv; paramv = paramv->next) {
-        for (param = paramv; param->name; ++param) {
-            struct clp_subcmd *subcmd = clp_subcmd(param);
-            char namebuf[width + 128];
-            int namelen;
+#ifdef O_DIRECT
+    if (fd == -1 && errno == EINVAL && (flags & O_DIRECT)) {
+        flags &= ~O_DIRECT;
+        fd = open(path, flags, perm);
+    }
+#endif
+#ifdef O_NOATIME
+    if (fd == -1 && errno == EPERM && (flags & O_NOATIME)) {
+        flags &= ~O_NOATIME;
+        fd = open(path, flags, perm);
+    }
+#endif
 
-            for (; subcmd && subcmd->name; ++subcmd) {
-                subcmd->help = clp_trim(subcmd->help);
-                if (subcmd->help) {
-                    namelen = strlen(namebuf);
-                    if (namelen > subcmd_width) {
-                        subcmd_width = namelen;
-                    }
-                }
-            }
+    if (fd == -1)
+        return EX_NOINPUT;
 
-            param->help = clp_trim(param->help);
-            if (!param->help)
-                continue;
+    if (parms && parms->advice)
+        posix_fadvise(fd, 0, 0, parms->advice);
 
-            clp_unbracket(param->name, namebuf, sizeof(namebuf));
-            namelen = strlen(namebuf);
+    /* Preallocate space for output files (without changing their size
+     * where possible).  File systems that can't are not an error.
+     */
+    if (parms && parms->prealloc > 0 && (flags & O_ACCMODE) != O_RDONLY) {
+        int rc;
 
-            if (namelen > width) {
-                width = namelen;
-            }
+#ifdef __linux__
+        rc = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, parms->prealloc) ? errno : 0;
+#else
+        rc = posix_fallocate(fd, 0, parms->prealloc);
+#endif
+
+        if (rc && rc != EOPNOTSUPP && rc != ENOSYS && rc != EINVAL) {
+            close(fd);
+            errno = rc;
+            return EX_CANTCREAT;
         }
     }
 
-    if (!clp->paramv)
-        fprintf(fp, "%-*s  %s\n", width, "args...", "zero or more positional arguments");
+    *fdp = fd;
 
-    /* Print a line of help for each positional paramter.
-     */
-    for (paramv = clp->params; paramv; paramv = paramv->next) {
-        for (param = paramv; param->name; ++param) {
-            struct clp_subcmd *subcmd;
-            char namebuf[width + 1];
-            char *comma = "";
+    return 0;
+}
 
-            clp_unbracket(param->name, namebuf, sizeof(namebuf));
+/* Like clp_cvt_open(), but parms (if not nil) is a struct clp_fileparms
+ * that tunes the file for the I/O that will be done on it.
+ */
+int
+clp_cvt_openx(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+{
+    int *result = dst;
 
-            param->help = clp_trim(param->help);
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-            subcmd = clp_subcmd(param);
-            if (!subcmd) {
-                if (param->help)
-                    fprintf(fp, "%-*s  %s\n", width, namebuf, param->help);
-                continue;
-            }
+    *result = -1;
 
-            /* Print subcommand help.  If caller didn't provide a help
-             * string for the subcommand posparam then we build one
-             * from the list of subcommands.
-             */
-            if (param->help) {
-                fprintf(fp, "%s  %s\n", namebuf, param->help);
-            } else {
-                fprintf(fp, "%s  one of {", namebuf);
+    return clp_file_open(clp, optarg, flags ? flags : O_RDONLY, parms, result);
+}
+
+/* stdio buffers allocated by clp_cvt_fopenx(), which are freed by
+ * clp_fclose().
+ */
+struct clp_fbuf {
+    struct clp_fbuf     *next;
+    FILE                *fp;
+    char                 buf[];
+};
+
+static pthread_mutex_t clp_fbuf_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct clp_fbuf *clp_fbuf_head;
+
+/* Like clp_cvt_fopen(), but parms (if not nil) is a struct clp_fileparms
+ * that gives the fopen() mode and tunes the file for the I/O that will be
+ * done on it.  Files given a buffer size should be closed by clp_fclose().
+ */
+int
+clp_cvt_fopenx(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+{
+    const struct clp_fileparms *fparms = parms;
+    const char *mode = (fparms && fparms->mode) ? fparms->mode : "r";
+    struct clp_fbuf *fbuf = NULL;
+    FILE **result = dst;
+    int fd, rc;
+
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    *result = NULL;
+
+    switch (mode[0]) {
+    case 'r':
+        flags = O_RDONLY;
+        break;
+
+    case 'w':
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+        break;
+
+    case 'a':
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+        break;
+
+    default:
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    for (const char *pc = mode + 1; *pc; ++pc) {
+        if (*pc == '+')
+            flags = (flags & ~O_ACCMODE) | O_RDWR;
+        else if (*pc == 'x')
+            flags |= O_EXCL;
+        else if (*pc == 'e')
+            flags |= O_CLOEXEC;
+    }
+
+    rc = clp_file_open(clp, optarg, flags, fparms, &fd);
+    if (rc)
+        return rc;
+
+    if (fparms && fparms->bufsz > 0) {
+        fbuf = malloc(sizeof(*fbuf) + fparms->bufsz);
+        if (!fbuf) {
+            close(fd);
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+    }
+
+    *result = fdopen(fd, mode);
+    if (!*result) {
+        close(fd);
+        free(fbuf);
+        return EX_NOINPUT;
+    }
+
+    if (fbuf) {
+        setvbuf(*result, fbuf->buf, _IOFBF, fparms->bufsz);
+
+        fbuf->fp = *result;
+        pthread_mutex_lock(&clp_fbuf_mtx);
+        fbuf->next = clp_fbuf_head;
+        clp_fbuf_head = fbuf;
+        pthread_mutex_unlock(&clp_fbuf_mtx);
+    }
+
+    return 0;
+}
+
+/* Close a file opened by clp_cvt_fopenx() (or by clp_cvt_fopen()), and
+ * free its stdio buffer.
+ */
+int
+clp_fclose(FILE *fp)
+{
+    struct clp_fbuf *fbuf, **prev;
+    int rc;
+
+    if (!fp)
+        return 0;
+
+    /* Unlink the buffer before closing the file, as once closed another
+     * thread may obtain the same FILE pointer from clp_cvt_fopenx().
+     */
+    pthread_mutex_lock(&clp_fbuf_mtx);
+    for (prev = &clp_fbuf_head; (fbuf = *prev); prev = &fbuf->next) {
+        if (fbuf->fp == fp) {
+            *prev = fbuf->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clp_fbuf_mtx);
+
+    rc = fclose(fp);
+
+    free(fbuf);
+
+    return rc;
+}
+
+/* Return true if the given converter produces a value that holds an open
+ * file or heap storage (i.e., one that cannot simply be copied).
+ */
+static bool
+clp_cvt_opaque(clp_cvt_cb *cvtfunc)
+{
+    return cvtfunc == clp_cvt_open || cvtfunc == clp_cvt_fopen ||
+        cvtfunc == clp_cvt_openx || cvtfunc == clp_cvt_fopenx ||
+        cvtfunc == clp_cvt_mmap || cvtfunc == clp_cvt_list ||
+        cvtfunc == clp_cvt_kvmap;
+}
+
+/* Return true if the given converter accumulates the optargs of every
+ * occurrence of its option (e.g., lists and maps), rather than retaining
+ * only the value of the last.
+ */
+static bool
+clp_cvt_accumulates(clp_cvt_cb *cvtfunc)
+{
+    return cvtfunc == clp_cvt_list || cvtfunc == clp_cvt_kvmap;
+}
+
+/* Return true if the given converter is one of clp's own, and its result
+ * depends only upon its input (and hence may be replayed from the parse
+ * cache).  Custom converters are never presumed to be pure.
+ */
+static bool
+clp_cvt_pure(clp_cvt_cb *cvtfunc)
+{
+    static clp_cvt_cb * const purev[] = {
+        clp_cvt_char, clp_cvt_u_char, clp_cvt_short, clp_cvt_u_short,
+        clp_cvt_int, clp_cvt_u_int, clp_cvt_long, clp_cvt_u_long,
+        clp_cvt_float, clp_cvt_double,
+        clp_cvt_int8_t, clp_cvt_uint8_t, clp_cvt_int16_t, clp_cvt_uint16_t,
+        clp_cvt_int32_t, clp_cvt_uint32_t, clp_cvt_int64_t, clp_cvt_uint64_t,
+        clp_cvt_intmax_t, clp_cvt_uintmax_t, clp_cvt_intptr_t, clp_cvt_uintptr_t,
+        clp_cvt_size_t, clp_cvt_time_t,
+        clp_cvt_subcmd, clp_cvt_enum, clp_cvt_flags,
+    };
+
+    for (size_t i = 0; i < sizeof(purev) / sizeof(purev[0]); ++i) {
+        if (cvtfunc == purev[i])
+            return true;
+    }
+
+    return false;
+}
+
+int
+clp_cvt_incr(struct clp *clp, const char *optarg, int flags, void *parms, void *dst)
+{
+    int *result = dst;
+
+    if (!result) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    *result += 1;
+
+    return 0;
+}
+
+/* The following macros will explode into a bunch of conversion functions.
+ * With any luck the unused functions will be eliminated by the linker.
+ */
+CLP_CVT_TMPL(char,      char,       CHAR_MIN,   CHAR_MAX,    clp_suftab_default);
+CLP_CVT_TMPL(u_char,    u_char,     0,          UCHAR_MAX,   clp_suftab_default);
+
+CLP_CVT_TMPL(short,     short,      SHRT_MIN,   SHRT_MAX,    clp_suftab_default);
+CLP_CVT_TMPL(u_short,   u_short,    0,          USHRT_MAX,   clp_suftab_default);
+
+CLP_CVT_TMPL(int,       int,        INT_MIN,    INT_MAX,     clp_suftab_default);
+CLP_CVT_TMPL(u_int,     u_int,      0,          UINT_MAX,    clp_suftab_default);
+
+CLP_CVT_TMPL(long,      long,       LONG_MIN,   LONG_MAX,    clp_suftab_default);
+CLP_CVT_TMPL(u_long,    u_long,     0,          ULONG_MAX,   clp_suftab_default);
+
+CLP_CVT_TMPL(float,     float,      -FLT_MAX,   FLT_MAX,     clp_suftab_default);
+CLP_CVT_TMPL(double,    double,     -DBL_MAX,   DBL_MAX,     clp_suftab_default);
+
+CLP_CVT_TMPL(int8_t,    int8_t,     INT8_MIN,   INT8_MAX,    clp_suftab_default);
+CLP_CVT_TMPL(uint8_t,   uint8_t,    0,          UINT8_MAX,   clp_suftab_default);
+
+CLP_CVT_TMPL(int16_t,   int16_t,    INT16_MIN,  INT16_MAX,   clp_suftab_default);
+CLP_CVT_TMPL(uint16_t,  uint16_t,   0,          UINT16_MAX,  clp_suftab_default);
+
+CLP_CVT_TMPL(int32_t,   int32_t,    INT32_MIN,  INT32_MAX,   clp_suftab_default);
+CLP_CVT_TMPL(uint32_t,  uint32_t,   0,          UINT32_MAX,  clp_suftab_default);
+
+CLP_CVT_TMPL(int64_t,   int64_t,    INT64_MIN,  INT64_MAX,   clp_suftab_default);
+CLP_CVT_TMPL(uint64_t,  uint64_t,   0,          UINT64_MAX,  clp_suftab_default);
+
+CLP_CVT_TMPL(intmax_t,  intmax_t,   INTMAX_MIN, INTMAX_MAX,  clp_suftab_default);
+CLP_CVT_TMPL(uintmax_t, uintmax_t,  0,          UINTMAX_MAX, clp_suftab_default);
+
+CLP_CVT_TMPL(intptr_t,  intptr_t,   INTPTR_MIN, INTPTR_MAX,  clp_suftab_default);
+CLP_CVT_TMPL(uintptr_t, uintptr_t,  0,          UINTPTR_MAX, clp_suftab_default);
+
+CLP_CVT_TMPL(size_t,    size_t,     0,          SIZE_MAX,    clp_suftab_default);
+CLP_CVT_TMPL(time_t,    time_t,     0,          LONG_MAX,    clp_suftab_time);
+
+CLP_GET_TMPL(bool,      bool);
+CLP_GET_TMPL(incr,      int);
+CLP_GET_TMPL(open,      int);
+CLP_GET_TMPL(fopen,     FILE *);
+CLP_GET_TMPL(openx,     int);
+CLP_GET_TMPL(fopenx,    FILE *);
+CLP_GET_TMPL(string,    char *);
+CLP_GET_TMPL(mmap,      struct clp_mmap);
+CLP_GET_TMPL(list,      struct clp_list);
+CLP_GET_TMPL(kvmap,     struct clp_kvmap);
+CLP_GET_TMPL(enum,      int);
+CLP_GET_TMPL(flags,     unsigned int);
+
+
+int
+clp_cvt_subcmd(struct clp *clp, const char *str, int flags, void *parms, void *dst)
+{
+    struct clp_subcmd *match;
+    int nmatch;
+
+    match = clp_subcmd_match(clp, parms, str, &nmatch);
+
+    /* clp_parsev_impl() records the error in clp->error, from which
+     * the message is rendered only if needed (see clp_error_format()).
+     */
+    if (nmatch > 1) {
+        if (!clp->error)
+            clp_eprint(clp, "ambiguous subcommand '%s', use -h for help", str);
+        errno = EINVAL;
+        return EX_USAGE;
+    }
+
+    if (!match) {
+        if (!clp->error)
+            clp_eprint(clp, "invalid subcommand '%s', use -h for help", str);
+        errno = EINVAL;
+        return EX_USAGE;
+    }
+
+    *(void **)dst = match;
+
+    return 0;
+}
+
+/* Note that clp_parsev_impl() descends into the subcommand's level
+ * itself rather than calling this action, hence clp_action_subcmd()
+ * is only called if the caller invokes it directly.
+ */
+int
+clp_action_subcmd(struct clp_posparam *param)
+{
+    struct clp_subcmd *subcmd = *(void **)param->cvtdst;
+    int rc;
+
+    rc = clp_parsev(param->argc, param->argv, subcmd->optionv, subcmd->posparamv);
+
+    return rc ?: -1;
+}
+
+#pragma GCC diagnostic pop
+
+struct clp_option *
+clp_find(int c, struct clp_option *optionv)
+{
+    if (optionv) {
+        struct clp_option *o;
+
+        for (o = optionv; o->optopt > 0; ++o) {
+            if (o->optopt == c)
+                return o;
+        }
+    }
+
+    return NULL;
+}
+
+struct clp_option *
+clp_given(int c, struct clp_option *optionv, void *dst)
+{
+    struct clp_option *o = clp_find(c, optionv);
+
+    if (o && o->given) {
+        if (dst && o->getfunc)
+            o->getfunc(o, dst);
+
+        return o;
+    }
+
+    return NULL;
+}
+
+/* Return a pointer to the value (i.e., the cvtdst) of the given option
+ * of the level being parsed by clp, or nil if there is no such option.
+ * Callbacks of commands parsed by clp_batch() must reach the values of
+ * other options this way, as each worker's values are private to it
+ * (whereas the variables named by the vectors are not touched).
+ */
+void *
+clp_value(struct clp *clp, int optopt)
+{
+    struct clp_option *o;
+
+    if (!clp)
+        return NULL;
+
+    o = clp_find(optopt, clp->optionv);
+
+    return o ? o->cvtdst : NULL;
+}
+
+/* Return true if the two specified options are mutually exclusive.
+ */
+static int
+clp_excludes2(const struct clp_option *l, const struct clp_option *r)
+{
+    if (l && r && l != r) {
+        if (l->excludes) {
+            if (l->excludes[0] == '^') {
+                if (!strchr(l->excludes, r->optopt)) {
+                    return true;
+                }
+            } else {
+                if (l->excludes[0] == '*' || strchr(l->excludes, r->optopt)) {
+                    return true;
+                }
+            }
+        }
+        if (r->excludes) {
+            if (r->excludes[0] == '^') {
+                if (!strchr(r->excludes, l->optopt)) {
+                    return true;
+                }
+            } else {
+                if (r->excludes[0] == '*' || strchr(r->excludes, l->optopt)) {
+                    return true;
+                }
+            }
+        }
+        if (l->paramv && r->paramv && l->paramv != r->paramv) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Return the opt letter of any option that is mutually exclusive
+ * with the specified option and which appeared on the command line
+ * at least the specified number of times.
+ */
+struct clp_option *
+clp_excludes(struct clp_option *first, const struct clp_option *option, int given)
+{
+    struct clp_option *o;
+
+    for (o = first; o->optopt > 0; ++o) {
+        if (o->given >= given && clp_excludes2(option, o)) {
+            return o;
+        }
+    }
+
+    return NULL;
+}
+
+/* Trim leading white space from given string.  Returns NULL
+ * if resulting string is zero length.  Typically, str is
+ * either NULL or a zero length string on entry.
+ */
+static const char *
+clp_trim(const char *str)
+{
+    while (str && isspace(str[0]))
+        ++str;
+
+    return (str && !str[0] ? NULL : str);
+}
+
+/* Return the count of leading open brackets, and the given name copied
+ * to buf[] and stripped of brackets and leading/trailing white space.
+ */
+int
+clp_unbracket(const char *name, char *buf, size_t bufsz)
+{
+    char *bufbase = buf;
+    int obrackets = 0;
+
+    if (!name || !buf || bufsz < 1) {
+        abort();
+    }
+
+    // Count open brackets up to first non-space character.
+    while (isspace(*name) || *name == '[') {
+        obrackets += (*name == '[');
+        ++name;
+    }
+
+    strncpy(buf, name, bufsz - 1);
+    buf[bufsz - 1] = '\000';
+
+    // Terminate buf at first bracket
+    while (*buf && *buf != ']' && *buf != '[')
+        ++buf;
+    *buf = '\000';
+
+    // Eliminate trailing white space
+    while (buf-- > bufbase && isspace(*buf))
+        *buf = '\000';
+
+    return obrackets;
+}
+
+static struct clp_subcmd *
+clp_subcmd(const struct clp_posparam *param)
+{
+    struct clp_subcmd *subcmd = NULL;
+
+    if (param && param->cvtsubcmd)
+        subcmd = param->cvtparms;
+
+    return (subcmd && subcmd->name) ? subcmd : NULL;
+}
+
+/* Lexical string comparator for qsort (e.g., AaBbCcDd...)
+ */
+static int
+clp_string_cmp(const void *lhs, const void *rhs)
+{
+    const char *l = (const char *)lhs;
+    const char *r = (const char *)rhs;
+    int lc = tolower(*l);
+    int rc = tolower(*r);
+
+    if (lc == rc) {
+        return (isupper(*l) ? -1 : 1);
+    }
+
+    return (lc - rc);
+}
+
+/* Grow the given string buffer to accommodate at least need more bytes.
+ */
+static int
+clp_sbgrow(struct clp_strbuf *sb, size_t need)
+{
+    size_t size = sb->size ? sb->size : 1024;
+    char *data;
+
+    while (size < sb->len + need)
+        size *= 2;
+
+    data = realloc(sb->data, size);
+    if (!data) {
+        sb->err = ENOMEM;
+        return ENOMEM;
+    }
+
+    sb->data = data;
+    sb->size = size;
+
+    return 0;
+}
+
+/* Append formatted text to the given string buffer.  Errors are latched
+ * in sb->err and checked once rendering is complete.
+ */
+static void __printflike(2, 3)
+clp_sbprintf(struct clp_strbuf *sb, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (sb->err || (!sb->data && clp_sbgrow(sb, 1)))
+        return;
+
+    va_start(ap, fmt);
+    n = vsnprintf(sb->data + sb->len, sb->size - sb->len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        sb->err = EINVAL;
+        return;
+    }
+
+    if ((size_t)n >= sb->size - sb->len) {
+        if (clp_sbgrow(sb, n + 1))
+            return;
+
+        va_start(ap, fmt);
+        vsnprintf(sb->data + sb->len, sb->size - sb->len, fmt, ap);
+        va_end(ap);
+    }
+
+    sb->len += n;
+}
+
+/* Record the end of the given string buffer as a place at which
+ * to insert the basename.
+ */
+static void
+clp_sbbase(struct clp_strbuf *sb)
+{
+    if (sb->err)
+        return;
+
+    if (sb->basec >= sb->basemax) {
+        int basemax = sb->basemax ? sb->basemax * 2 : 8;
+        size_t *basev;
+
+        basev = realloc(sb->basev, sizeof(*basev) * basemax);
+        if (!basev) {
+            sb->err = ENOMEM;
+            return;
+        }
+
+        sb->basev = basev;
+        sb->basemax = basemax;
+    }
+
+    sb->basev[sb->basec++] = sb->len;
+}
+
+static void
+clp_sbfree(struct clp_strbuf *sb)
+{
+    if (sb) {
+        free(sb->basev);
+        free(sb->data);
+        free(sb);
+    }
+}
+
+/* Return the option of the given level whose optopt is c (if any).
+ */
+static struct clp_option *
+clp_level_find(const struct clp_level *lvl, int c)
+{
+    int idx = clp_optopt_valid(c) ? lvl->optmap[c] : 0;
+
+    return idx ? lvl->optionv + idx - 1 : NULL;
+}
+
+/* Render just the usage line, i.e., lines of the general form
+ *   "usage: progname [options] args..."
+ */
+static void
+clp_usage(const struct clp_level *lvl, const struct clp_option *limit,
+          struct clp_strbuf *sb)
+{
+    struct clp_posparam *paramv = lvl->paramv;
+    char *pc_optarg, *pc_opt, *pc;
+    struct clp_posparam *param;
+    struct clp_option *o, *x;
+    char *pc_excludes;
+    int nexcludes;
+
+    if (limit) {
+        bool limit_excl_all = limit->excludes && strchr("*^", limit->excludes[0]);
+
+        if (!limit_excl_all && !limit->paramv) {
+            return;
+        }
+
+        if (limit->paramv) {
+            paramv = limit->paramv;
+        }
+    }
+
+    char excludes_buf[lvl->optionc + 1];
+    char optarg_buf[lvl->optionc + 1];
+    char opt_buf[lvl->optionc + 1];
+
+    pc_excludes = excludes_buf;
+    pc_optarg = optarg_buf;
+    pc_opt = opt_buf;
+
+    /* Build three lists of option characters:
+     *
+     * 1) excludes_buf[] contains all the options that might exclude
+     * or be excluded by another option that share the same parameter vector.
+     *
+     * 2) optarg_buf[] contains all the options not in (1) that require
+     * an argument.
+     *
+     * 3) opt_buf[] contains all the rest not covered by (1) or (2).
+     *
+     * Note: if 'limit' is not NULL, then only options that share
+     * the same paramv or have a NULL paramv may appear in one of
+     * the three lists.
+     */
+    for (o = lvl->optionv; o && o->optopt > 0; ++o) {
+        if (!clp_optopt_valid(o->optopt))
+            continue;
+
+        if (limit) {
+            if (clp_excludes2(limit, o)) {
+                continue;
+            }
+        } else if (o->paramv) {
+            continue;
+        }
+
+        if (o != limit && o->help) {
+            if (o->excludes) {
+                *pc_excludes++ = o->optopt;
+            } else {
+                for (x = lvl->optionv; x->optopt > 0; ++x) {
+                    if (clp_excludes2(o, x))
+                        break;
+                }
+
+                if (x->optopt > 0 && x->paramv == o->paramv) {
+                    *pc_excludes++ = o->optopt;
+                } else if (o->argname) {
+                    *pc_optarg++ = o->optopt;
+                } else {
+                    *pc_opt++ = o->optopt;
+                }
+            }
+        }
+    }
+
+    *pc_excludes = '\000';
+    *pc_optarg = '\000';
+    *pc_opt = '\000';
+
+    qsort(opt_buf, strlen(opt_buf), 1, clp_string_cmp);
+    qsort(optarg_buf, strlen(optarg_buf), 1, clp_string_cmp);
+    qsort(excludes_buf, strlen(excludes_buf), 1, clp_string_cmp);
+
+    if (limit)
+        clp_dprint(1, "  limit -%c:\n", limit->optopt);
+    clp_dprint(1, "  has excludes: %s\n", excludes_buf);
+    clp_dprint(1, "  has optarg:   %s\n", optarg_buf);
+    clp_dprint(1, "  bool opts:    %s\n", opt_buf);
+
+    /* Now render the usage line in the form of:
+     *
+     * usage: basename [mandatory-opt] [bool-opts] [opts-with-args] [excl-opts] [posparams...]
+     */
+
+    /* [mandatory-opt]
+     */
+    clp_sbprintf(sb, "usage: ");
+    clp_sbbase(sb);
+    if (limit) {
+        clp_sbprintf(sb, " -%c", limit->optopt);
+    }
+
+    /* [bool-opts]
+     */
+    if (opt_buf[0]) {
+        clp_sbprintf(sb, " [-%s]", opt_buf);
+    }
+
+    /* [opts-with-args]
+     */
+    for (pc = optarg_buf; *pc; ++pc) {
+        o = clp_level_find(lvl, *pc);
+        if (o) {
+            clp_sbprintf(sb, " [-%c %s]", o->optopt, o->argname);
+        }
+    }
+
+    /* Generate the mutually exclusive option usage message...
+     * [excl-args]
+     */
+    nexcludes = strlen(excludes_buf);
+
+    if (nexcludes > 0) {
+        char listv[nexcludes][nexcludes + 1];
+        bool livev[nexcludes];
+        int i, j;
+
+        /* Build a vector of strings where each string contains
+         * mutually exclusive options.
+         */
+        for (i = 0; i < nexcludes; ++i) {
+            struct clp_option *l = clp_level_find(lvl, excludes_buf[i]);
+            char *pc_buf = listv[i];
+
+            for (j = 0; j < nexcludes; ++j) {
+                if (i == j || clp_excludes2(l, clp_level_find(lvl, excludes_buf[j]))) {
+                    *pc_buf++ = excludes_buf[j];
+                }
+            }
+
+            *pc_buf = '\000';
+            livev[i] = true;
+        }
+
+        /* Eliminate duplicate strings.
+         */
+        for (i = 0; i < nexcludes; ++i) {
+            for (j = i + 1; livev[i] && j < nexcludes; ++j) {
+                if (livev[j] && 0 == strcmp(listv[i], listv[j])) {
+                    livev[j] = false;
+                }
+            }
+        }
+
+        /* Ensure that all options within a list are mutually exclusive.
+         */
+        for (i = 0; i < nexcludes; ++i) {
+            if (livev[i]) {
+                for (pc = listv[i]; *pc && livev[i]; ++pc) {
+                    struct clp_option *l = clp_level_find(lvl, *pc);
+                    char *pc2;
+
+                    for (pc2 = listv[i]; *pc2; ++pc2) {
+                        if (pc2 != pc && !clp_excludes2(l, clp_level_find(lvl, *pc2))) {
+                            livev[i] = false;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        /* Now, render the remaining strings of mutually exclusive options.
+         */
+        for (i = 0; i < nexcludes; ++i) {
+            if (livev[i]) {
+                const char *bar = " [";
+
+                for (pc = listv[i]; *pc; ++pc) {
+                    o = clp_level_find(lvl, *pc);
+                    if (o->argname) {
+                        clp_sbprintf(sb, "%s-%c %s", bar, *pc, o->argname);
+                    } else {
+                        clp_sbprintf(sb, "%s-%c", bar, *pc);
+                    }
+
+                    bar = " | ";
+                }
+
+                clp_sbprintf(sb, "]");
+            }
+        }
+    }
+
+    /* Finally, render all the positional parameters.
+     * [posparams...]
+     */
+    if (paramv) {
+        int noptional = 0;
+
+        for (param = paramv; param->name; ++param) {
+            char namebuf[128];
+            int isopt;
+
+            isopt = clp_unbracket(param->name, namebuf, sizeof(namebuf));
+
+            if (isopt) {
+                ++noptional;
+            }
+
+            clp_sbprintf(sb, "%s%s", isopt ? " [" : " ", namebuf);
+
+            if (param[1].name) {
+                isopt = clp_unbracket(param[1].name, namebuf, sizeof(namebuf));
+            }
+
+            /* If we're at the end of the list or the next parameter
+             * is not optional then render all the closing brackets.
+             */
+            if (!param[1].name || !isopt) {
+                for (; noptional > 0; --noptional) {
+                    clp_sbprintf(sb, "]");
+                }
+            }
+        }
+    }
+
+    clp_sbprintf(sb, "%s\n", paramv ? "" : " [args...]");
+}
+
+int
+clp_version(struct clp_option *option)
+{
+    printf("%s\n", (char *)option->cvtdst);
+
+    return 0;
+}
+
+/* Lexical option comparator for qsort (e.g., AaBbCcDd...)
+ */
+static int
+clp_help_cmp(const void *lhs, const void *rhs)
+{
+    struct clp_option const *l = *(struct clp_option * const *)lhs;
+    struct clp_option const *r = *(struct clp_option * const *)rhs;
+
+    int lc = tolower(l->optopt);
+    int rc = tolower(r->optopt);
+
+    if (lc == rc) {
+        return (isupper(l->optopt) ? -1 : 1);
+    }
+
+    return (lc - rc);
+}
+
+/* Render the entire help message, for example:
+ *
+ * usage: prog [-v] [-i intarg] src... dst
+ * usage: prog -h
+ * usage: prog -V
+ * -h         print this help list
+ * -i intarg  specify an integer argument
+ * -V         print version
+ * -v         increase verbosity
+ * src...  specify one or more source files
+ * dst     specify destination directory
+ *
+ * If CLP_HELP_USAGE is given then only the usage lines are rendered.
+ */
+static void
+clp_help_render(const struct clp_level *lvl, int flags, struct clp_strbuf *sb)
+{
+    struct clp_posparam *paramv, *param;
+    struct clp_option *option;
+    int subcmd_width, width;
+    size_t optionc;
+    bool longhelp;
+
+    /* Create an array of pointers to options and sort it.
+     */
+    struct clp_option *optionv[lvl->optionc + 1];
+
+    for (size_t i = optionc = 0; i < lvl->optionc; ++i) {
+        struct clp_option *o = lvl->optionv + i;
+
+        if (clp_optopt_valid(o->optopt))
+            optionv[optionc++] = o;
+    }
+
+    qsort(optionv, optionc, sizeof(optionv[0]), clp_help_cmp);
+
+    /* Render the default usage line.
+     */
+    clp_usage(lvl, NULL, sb);
+
+    /* Render usage lines for each option that has positional parameters
+     * different than the default usage.
+     * Also, determine the width of the longest combination of option
+     * argument and long option names.
+     */
+    longhelp = (flags & CLP_HELP_LONG);
+    width = 0;
+
+    for (size_t i = 0; i < optionc; ++i) {
+        int len = 0;
+
+        option = optionv[i];
+
+        if (!option->help) {
+            continue;
+        }
+
+        clp_usage(lvl, option, sb);
+
+        if (option->argname) {
+            len += strlen(option->argname) + 1;
+        }
+        if (longhelp && option->longopt) {
+            len += strlen(option->longopt) + 4;
+        }
+        if (len > width) {
+            width = len;
+        }
+    }
+
+    if (flags & CLP_HELP_USAGE)
+        return;
+
+    /* Render a line of help for each option.
+     */
+    for (size_t i = 0; i < optionc; ++i) {
+        char buf[width + 8];
+
+        option = optionv[i];
+
+        if (!option->help)
+            continue;
+
+        buf[0] = '\000';
+
+        if (longhelp && option->longopt) {
+            strcat(buf, ", --");
+            strcat(buf, option->longopt);
+        }
+        if (option->argname) {
+            strcat(buf, " ");
+            strcat(buf, option->argname);
+        }
+
+        clp_sbprintf(sb, "-%c%-*s  %s\n", option->optopt, width, buf, option->help);
+    }
+
+    /* Determine the width of the longest positional parameter name.
+     */
+    subcmd_width = 0;
+    width = 0;
+
+    for (int k = 0; k < lvl->paramvc; ++k) {
+        paramv = lvl->paramvv[k];
+
+        for (param = paramv; param->name; ++param) {
+            struct clp_subcmd *subcmd = clp_subcmd(param);
+            char namebuf[width + 128];
+            int namelen;
+
+            for (; subcmd && subcmd->name; ++subcmd) {
+                if (subcmd->help) {
+                    namelen = strlen(subcmd->name);
+                    if (namelen > subcmd_width) {
+                        subcmd_width = namelen;
+                    }
+                }
+            }
+
+            if (!param->help && !clp_subcmd(param))
+                continue;
+
+            clp_unbracket(param->name, namebuf, sizeof(namebuf));
+            namelen = strlen(namebuf);
+
+            if (namelen > width) {
+                width = namelen;
+            }
+        }
+    }
+
+    if (!lvl->paramv)
+        clp_sbprintf(sb, "%-*s  %s\n", width, "args...", "zero or more positional arguments");
+
+    /* Render a line of help for each positional paramter.
+     */
+    for (int k = 0; k < lvl->paramvc; ++k) {
+        paramv = lvl->paramvv[k];
+
+        for (param = paramv; param->name; ++param) {
+            struct clp_subcmd *subcmd;
+            char namebuf[width + 1];
+            char *comma = "";
+
+            clp_unbracket(param->name, namebuf, sizeof(namebuf));
+
+            subcmd = clp_subcmd(param);
+            if (!subcmd) {
+                if (param->help)
+                    clp_sbprintf(sb, "%-*s  %s\n", width, namebuf, param->help);
+                continue;
+            }
+
+            /* Render subcommand help.  If caller didn't provide a help
+             * string for the subcommand posparam then we build one
+             * from the list of subcommands.
+             */
+            if (param->help) {
+                clp_sbprintf(sb, "%s  %s\n", namebuf, param->help);
+            } else {
+                clp_sbprintf(sb, "%s  one of {", namebuf);
+
+                for (subcmd = param->cvtparms; subcmd->name; ++subcmd) {
+                    if (subcmd->help) {
+                        clp_sbprintf(sb, "%s%s", comma, subcmd->name);
+                        comma = ", ";
+                    }
+                }
+                clp_sbprintf(sb, "}\n");
+            }
+
+            for (subcmd = param->cvtparms; subcmd->name; ++subcmd) {
+                if (subcmd->help)
+                    clp_sbprintf(sb, "  %-*s  %s\n", subcmd_width, subcmd->name, subcmd->help);
+            }
+        }
+    }
+}
+
+/* Return the help text of the given level, rendering and caching it
+ * on first use.  The level's vectors are never modified by rendering,
+ * so concurrent callers may race to render the text, in which case
+ * the loser discards its copy in favor of the winner's.
+ *
+ * On error, sets errno and returns NULL.
+ */
+static const struct clp_strbuf *
+clp_level_help(struct clp_level *lvl, int flags)
+{
+    struct clp_strbuf *sb, *cached;
+
+    flags &= CLP_HELP_LONG | CLP_HELP_USAGE;
+
+    cached = __atomic_load_n(&lvl->helpv[flags], __ATOMIC_ACQUIRE);
+    if (cached)
+        return cached;
+
+    sb = calloc(1, sizeof(*sb));
+    if (!sb) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    clp_help_render(lvl, flags, sb);
+
+    if (sb->err || clp_sbgrow(sb, 1)) {
+        errno = sb->err;
+        clp_sbfree(sb);
+        return NULL;
+    }
+
+    sb->data[sb->len] = '\000';
+
+    if (!__atomic_compare_exchange_n(&lvl->helpv[flags], &cached, sb, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        clp_sbfree(sb);
+        return cached;
+    }
+
+    return sb;
+}
+
+/* Split the given help text into a vector of segments in which the
+ * basename is inserted between each of the text's segments.  iov[]
+ * must have room for (help->basec * 2 + 1) elements.  Returns the
+ * number of segments.
+ */
+static int
+clp_help_iov(const struct clp_strbuf *help, const char *basename,
+             struct iovec *iov)
+{
+    size_t off = 0;
+    int iovc = 0;
+
+    for (int i = 0; i < help->basec; ++i) {
+        iov[iovc].iov_base = help->data + off;
+        iov[iovc++].iov_len = help->basev[i] - off;
+        iov[iovc].iov_base = (char *)basename;
+        iov[iovc++].iov_len = strlen(basename);
+        off = help->basev[i];
+    }
+
+    iov[iovc].iov_base = help->data + off;
+    iov[iovc++].iov_len = help->len - off;
+
+    return iovc;
+}
+
+/* Print the help message of the current level to opthelp->priv (if
+ * not nil) or stdout.  The help text is rendered only once per level
+ * (or once per table, see clp_table_help()).
+ */
+int
+clp_help(struct clp_option *opthelp)
+{
+    const struct clp_strbuf *help;
+    struct clp *clp;
+    FILE *fp;
+
+    /* opthelp is the option that triggered clp into calling clp_help().
+     * Ususally -h, but the user could have changed it...
+     */
+    if (!opthelp) {
+        return 0;
+    }
+
+    clp = opthelp->clp;
+
+    help = clp_level_help(clp->level, (opthelp->longidx >= 0) ? CLP_HELP_LONG : 0);
+    if (!help) {
+        clp_eprint(clp, "unable to render help");
+        return EX_OSERR;
+    }
+
+    struct iovec iov[help->basec * 2 + 1];
+    int iovc;
+
+    fp = opthelp->priv ? opthelp->priv : stdout;
+    iovc = clp_help_iov(help, clp->basename, iov);
+
+    for (int i = 0; i < iovc; ++i)
+        fwrite(iov[i].iov_base, 1, iov[i].iov_len, fp);
+
+    return 0;
+}
+
+/* Determine the minimum and maximum number of arguments that the
+ * given posparam vector could consume.
+ */
+static void
+clp_posparam_minmax(struct clp_posparam *paramv, int *posminp, int *posmaxp)
+{
+    struct clp_posparam *param;
+
+    if (!paramv || !posminp || !posmaxp) {
+        abort();
+    }
+
+    *posminp = 0;
+    *posmaxp = 0;
+
+    for (param = paramv; param->name; ++param) {
+        struct clp_subcmd *subcmd = clp_subcmd(param);
+        char namebuf[128];
+        int isoptional;
+        int len;
+
+        isoptional = clp_unbracket(param->name, namebuf, sizeof(namebuf));
+
+        param->posmin = (isoptional || param->stream) ? 0 : 1;
+
+        len = strlen(namebuf);
+        if (len >= 3 && 0 == strncmp(namebuf + len - 3, "...", 3)) {
+            param->posmax = CLP_POSPARAM_MAX;
+        } else {
+            param->posmax = subcmd ? CLP_POSPARAM_MAX : 1;
+        }
+
+        *posminp += param->posmin;
+
+        if (*posmaxp > CLP_POSPARAM_MAX - param->posmax)
+            *posmaxp = CLP_POSPARAM_MAX;
+        else
+            *posmaxp += param->posmax;
+
+        if (subcmd)
+            break;
+    }
+}
+
+/* Lexical long option comparator for qsort (stable w.r.t. optionv[])
+ */
+static int
+clp_longopt_cmp(const void *lhs, const void *rhs)
+{
+    const struct clp_longopt *l = lhs;
+    const struct clp_longopt *r = rhs;
+    int rc = strcmp(l->name, r->name);
+
+    return rc ? rc : (l->optidx - r->optidx);
+}
+
+/* Lexical subcommand comparator for qsort (stable w.r.t. subcmdv[])
+ */
+static int
+clp_subent_cmp(const void *lhs, const void *rhs)
+{
+    const struct clp_subent *l = lhs;
+    const struct clp_subent *r = rhs;
+    int rc = strcmp(l->name, r->name);
+
+    return rc ? rc : (l->subcmd < r->subcmd ? -1 : 1);
+}
+
+static void
+clp_level_destroy(struct clp_level *lvl)
+{
+    for (size_t i = 0; i < sizeof(lvl->helpv) / sizeof(lvl->helpv[0]); ++i)
+        clp_sbfree(lvl->helpv[i]);
+
+    free(lvl);
+}
+
+/* Compile the given option and posparam vectors into a level, which
+ * contains everything needed to parse a command line against them:
+ * An index from option letter to option, a sorted vector of long
+ * options, the min/max argument counts of every posparam vector,
+ * and a sorted index of every subcommand vector.
+ *
+ * Validates and initializes the options in the same manner as did
+ * clp_parsev() prior to the advent of levels.  Note that the levels
+ * of subcommands are not compiled (see clp_table_level()).
+ */
+static int
+clp_level_create(struct clp_option *optionv, struct clp_posparam *paramv,
+                 struct clp_level **lvlp)
+{
+    size_t optionc, longoptc, paramvc, subidxc, subc, sz;
+    struct clp_posparam *param;
+    struct clp_level *lvl;
+    struct clp_option *o;
+    char *pc;
+    int opthelp;
+
+    optionc = longoptc = paramvc = subidxc = subc = 0;
+    opthelp = 0;
+
+    /* Validate options and initialize/reset from previous run.
+     */
+    for (o = optionv; o && o->optopt > 0; ++o) {
+
+        /* Trim leading whitespace and set to NULL if empty.
+         */
+        o->help = clp_trim(o->help);
+        o->argname = clp_trim(o->argname);
+        o->excludes = clp_trim(o->excludes);
+
+        if (o->cvtfunc && !o->cvtdst) {
+            o->cvtdst = memset(o->cvtdstbuf, 0, sizeof(o->cvtdstbuf));
+            o->cvtdstsz = sizeof(o->cvtdstbuf);
+        }
+
+        /* Compile enum tables now rather than upon first use.
+         */
+        if ((o->cvtfunc == clp_cvt_enum || o->cvtfunc == clp_cvt_flags) && o->cvtparms)
+            clp_enum_compile(o->cvtparms);
+
+        if (o->cvtfunc == clp_cvt_bool || o->cvtfunc == clp_cvt_incr) {
+            o->argname = NULL;
+        } else if (!o->longopt && o->argname && strlen(o->argname) > 1) {
+            o->longopt = o->argname;
+        }
+
+        if (o->after == clp_help) {
+            opthelp = o->optopt;
+        }
+
+        ++optionc;
+    }
+
+    if (optionc > CLP_OPTION_MAX) {
+        fprintf(stderr, "%s: invalid optionc %zu\n", __func__, optionc);
+        abort();
+    }
+
+    unsigned short optmap[UCHAR_MAX + 1];
+    struct clp_posparam *paramvv[optionc + 1];
+
+    memset(optmap, 0, sizeof(optmap));
+
+    if (paramv)
+        paramvv[paramvc++] = paramv;
+
+    for (o = optionv; o && o->optopt > 0; ++o) {
+        size_t i;
+
+        if (!clp_optopt_valid(o->optopt)) {
+            clp_dprint(1, "invalid option %d (index %ld) ignored\n",
+                       o->optopt, o - optionv);
+            continue;
+        }
+
+        if (optmap[o->optopt]) {
+            clp_dprint(1, "duplicate option %d (index %ld) ignored\n",
+                       o->optopt, o - optionv);
+            continue;
+        }
+
+        optmap[o->optopt] = (o - optionv) + 1;
+
+        if (o->longopt)
+            ++longoptc;
+
+        for (i = 0; o->paramv && i < paramvc; ++i) {
+            if (paramvv[i] == o->paramv)
+                break;
+        }
+
+        if (o->paramv && i == paramvc)
+            paramvv[paramvc++] = o->paramv;
+    }
+
+    /* Only the first subcommand posparam of each posparam vector
+     * can be given (see clp_posparam_minmax()).
+     */
+    struct clp_subcmd *subcmdvv[paramvc + 1];
+
+    for (size_t k = 0; k < paramvc; ++k) {
+        struct clp_subcmd *subcmd;
+        size_t i;
+
+        for (param = paramvv[k]; param->name; ++param) {
+            if (clp_subcmd(param))
+                break;
+        }
+
+        subcmd = clp_subcmd(param);
+        if (!subcmd)
+            continue;
+
+        for (i = 0; i < subidxc; ++i) {
+            if (subcmdvv[i] == subcmd)
+                break;
+        }
+
+        if (i < subidxc)
+            continue;
+
+        subcmdvv[subidxc++] = subcmd;
+
+        for (; subcmd->name; ++subcmd)
+            ++subc;
+    }
+
+    /* Allocate a single chunk of memory to hold the level and all
+     * of its indices.
+     */
+    sz = sizeof(*lvl);
+    sz += sizeof(*lvl->longoptv) * longoptc;
+    sz += sizeof(*lvl->paramvv) * paramvc;
+    sz += sizeof(*lvl->subidxv) * subidxc;
+    sz += (sizeof(*lvl->subidxv->subv) + sizeof(*lvl->subidxv->levelv)) * subc;
+    sz += sizeof(*lvl->posminv) * paramvc * 2;
+
+    lvl = calloc(1, sz);
+    if (!lvl) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    pc = (char *)(lvl + 1);
+    lvl->longoptv = (void *)pc;
+    pc += sizeof(*lvl->longoptv) * longoptc;
+    lvl->paramvv = (void *)pc;
+    pc += sizeof(*lvl->paramvv) * paramvc;
+    lvl->subidxv = (void *)pc;
+    pc += sizeof(*lvl->subidxv) * subidxc;
+
+    lvl->optionv = optionv;
+    lvl->paramv = paramv;
+    lvl->optionc = optionc;
+    lvl->opthelp = opthelp;
+    memcpy(lvl->optmap, optmap, sizeof(lvl->optmap));
+
+    strcpy(lvl->usehelp, ", use -h for help");
+    if (opthelp > 0) {
+        lvl->usehelp[7] = opthelp;
+    } else {
+        lvl->usehelp[0] = '\000';
+    }
+
+    for (o = optionv; o && o->optopt > 0; ++o) {
+        struct clp_longopt *longopt;
+
+        if (!o->longopt || !clp_optopt_valid(o->optopt))
+            continue;
+
+        if (optmap[o->optopt] != (o - optionv) + 1)
+            continue;
+
+        longopt = lvl->longoptv + lvl->longoptc++;
+        longopt->name = o->longopt;
+        longopt->len = strlen(o->longopt);
+        longopt->optidx = o - optionv;
+    }
+
+    qsort(lvl->longoptv, lvl->longoptc, sizeof(*lvl->longoptv), clp_longopt_cmp);
+
+    /* "-W foo" is equivalent to "--foo" if there are long options
+     * and the caller hasn't claimed the -W option.
+     */
+    lvl->wlongopt = (lvl->longoptc > 0 && !optmap['W']);
+
+    for (size_t i = 0; i < subidxc; ++i) {
+        struct clp_subidx *idx = lvl->subidxv + i;
+        struct clp_subcmd *subcmd;
+
+        idx->subcmdv = subcmdvv[i];
+        idx->subv = (void *)pc;
+
+        for (subcmd = idx->subcmdv; subcmd->name; ++subcmd) {
+            struct clp_subent *ent = idx->subv + idx->subc++;
+
+            ent->name = subcmd->name;
+            ent->len = strlen(subcmd->name);
+            ent->subcmd = subcmd;
+        }
+
+        pc += sizeof(*idx->subv) * idx->subc;
+        idx->levelv = (void *)pc;
+        pc += sizeof(*idx->levelv) * idx->subc;
+
+        qsort(idx->subv, idx->subc, sizeof(*idx->subv), clp_subent_cmp);
+    }
+
+    lvl->subidxc = subidxc;
+    lvl->paramvc = paramvc;
+    lvl->posminv = (void *)pc;
+    lvl->posmaxv = lvl->posminv + paramvc;
+
+    for (size_t k = 0; k < paramvc; ++k) {
+        lvl->paramvv[k] = paramvv[k];
+
+        /* Trim help strings here so that rendering help never
+         * modifies the vectors (see clp_level_help()).
+         */
+        for (param = paramvv[k]; param->name; ++param) {
+            struct clp_subcmd *subcmd = clp_subcmd(param);
+
+            param->help = clp_trim(param->help);
+
+            for (; subcmd && subcmd->name; ++subcmd)
+                subcmd->help = clp_trim(subcmd->help);
+        }
+
+        clp_posparam_minmax(paramvv[k], lvl->posminv + k, lvl->posmaxv + k);
+    }
+
+    *lvlp = lvl;
+
+    return 0;
+}
+
+/* Reset the state of the options and parameters of the current level
+ * from any previous run in preparation to parse the given arguments.
+ */
+static void
+clp_level_enter(struct clp *clp, char **argv)
+{
+    struct clp_level *lvl = clp->level;
+    struct clp_posparam *param;
+    struct clp_option *o;
+
+    clp->basename = strrchr(argv[0], '/');
+    clp->basename = (clp->basename ? clp->basename + 1 : argv[0]);
+
+    clp->optionv = lvl->optionv;
+    clp->paramv = lvl->paramv;
+    clp->optionc = lvl->optionc;
+    clp->opthelp = lvl->opthelp;
+    clp->optind = 1;
+    clp->nextchar = NULL;
+
+    for (o = lvl->optionv; o && o->optopt > 0; ++o) {
+        o->clp = clp;
+        o->given = 0;
+        o->optarg = NULL;
+        o->next = NULL;
+    }
+
+    for (param = lvl->paramv; param && param->name; ++param) {
+        param->clp = clp;
+        param->argc = 0;
+        param->argv = NULL;
+        param->next = NULL;
+    }
+}
+
+/* Return the compiled level of the subcommand just converted by the
+ * given subcommand posparam, creating it if we are not parsing against
+ * a compiled table.  Returns NULL if param's cvtfunc produced a subcmd
+ * that does not belong to cvtparms.
+ */
+static struct clp_level *
+clp_level_child(struct clp *clp, struct clp_posparam *param)
+{
+    struct clp_subcmd *subcmd = *(void **)param->cvtdst;
+    const struct clp_subidx *idx;
+    struct clp_level *lvl;
+
+    idx = clp_subidx_find(clp, param->cvtparms);
+    if (!idx || subcmd < idx->subcmdv || subcmd >= idx->subcmdv + idx->subc)
+        return NULL;
+
+    if (clp->table)
+        return idx->levelv[subcmd - idx->subcmdv];
+
+    if (clp_level_create(subcmd->optionv, subcmd->posparamv, &lvl))
+        return NULL;
+
+    return lvl;
+}
+
+#define CLP_SCAN_END        (-1)    // No more options
+#define CLP_SCAN_INVALID    (-2)    // Invalid or ambiguous option
+#define CLP_SCAN_NOARG      (-3)    // Option requires an argument
+
+/* Resolve the long option at the beginning of str (i.e., "name" or
+ * "name=value") against the long options of the current level.
+ * Like getopt_long(3), str may be an abbreviation of a long option
+ * name so long as it is unambiguous or an exact match.
+ */
+static int
+clp_scan_long(struct clp *clp, int argc, char **argv, const char *str,
+              const char **optargp, int *longidxp)
+{
+    const struct clp_level *lvl = clp->level;
+    const struct clp_longopt *longopt = NULL;
+    struct clp_option *o;
+    size_t namelen;
+    int lb, ub;
+
+    namelen = strcspn(str, "=");
+    lb = 0;
+    ub = lvl->longoptc;
+
+    /* All long options that begin with str are adjacent in longoptv[],
+     * the first of which is at the lower bound of str.
+     */
+    while (lb < ub) {
+        int mid = (lb + ub) / 2;
+
+        if (strncmp(lvl->longoptv[mid].name, str, namelen) < 0)
+            lb = mid + 1;
+        else
+            ub = mid;
+    }
+
+    if (lb < lvl->longoptc && !strncmp(lvl->longoptv[lb].name, str, namelen)) {
+        longopt = lvl->longoptv + lb;
+
+        if (longopt->len > namelen && lb + 1 < lvl->longoptc &&
+            !strncmp(longopt[1].name, str, namelen)) {
+            longopt = NULL; // ambiguous abbreviation
+        }
+    }
+
+    clp->nextchar = NULL;
+    clp->optind++;
+    clp->optopt = 0;
+
+    if (!longopt)
+        return CLP_SCAN_INVALID;
+
+    o = lvl->optionv + longopt->optidx;
+    clp->optopt = o->optopt;
+
+    if (str[namelen]) {
+        if (!o->argname)
+            return CLP_SCAN_INVALID;
+
+        *optargp = str + namelen + 1;
+    } else if (o->argname) {
+        if (clp->optind >= argc)
+            return CLP_SCAN_NOARG;
+
+        *optargp = argv[clp->optind++];
+    }
+
+    *longidxp = longopt - lvl->longoptv;
+
+    return longopt->optidx;
+}
+
+/* Scan the next option from argv[] in the manner of getopt_long(3)
+ * given an optstring that begins with "+:" (i.e., POSIXLY_CORRECT
+ * and no error reporting).  Unlike getopt_long(3), all the scanner
+ * state resides in clp, and options are resolved via the indices
+ * of the current level.
+ *
+ * Returns the index into clp->optionv[] of the option, or one of the
+ * CLP_SCAN_* codes.
+ */
+static int
+clp_scan(struct clp *clp, int argc, char **argv,
+         const char **optargp, int *longidxp)
+{
+    const struct clp_level *lvl = clp->level;
+    const char *pc = clp->nextchar;
+    int idx, c;
+
+    *optargp = NULL;
+    *longidxp = -1;
+
+    if (!pc || !*pc) {
+        if (clp->optind >= argc)
+            return CLP_SCAN_END;
+
+        pc = argv[clp->optind];
+
+        if (pc[0] != '-' || pc[1] == '\000')
+            return CLP_SCAN_END;
+
+        if (pc[1] == '-') {
+            if (pc[2] == '\000') {
+                clp->optind++;
+                return CLP_SCAN_END;
+            }
+
+            return clp_scan_long(clp, argc, argv, pc + 2, optargp, longidxp);
+        }
+
+        ++pc;
+    }
+
+    c = (unsigned char)*pc++;
+    clp->nextchar = pc;
+    clp->optopt = c;
+
+    /* Advance optind upon reaching the last letter of an argument.
+     */
+    if (!*pc)
+        clp->optind++;
+
+    idx = (int)lvl->optmap[c] - 1;
+    if (idx < 0) {
+        if (c != 'W' || !lvl->wlongopt)
+            return CLP_SCAN_INVALID;
+
+        if (!*pc) {
+            if (clp->optind >= argc)
+                return CLP_SCAN_NOARG;
+
+            pc = argv[clp->optind];
+        }
+
+        return clp_scan_long(clp, argc, argv, pc, optargp, longidxp);
+    }
+
+    if (lvl->optionv[idx].argname) {
+        if (*pc) {
+            *optargp = pc;
+            clp->optind++;
+        } else if (clp->optind < argc) {
+            *optargp = argv[clp->optind++];
+        } else {
+            return CLP_SCAN_NOARG;
+        }
+
+        clp->nextchar = NULL;
+    }
+
+    return idx;
+}
+
+/* A conversion log records the results of the conversions made by one
+ * parse of a command line, so that the conversions may be replayed by
+ * subsequent parses of the same line (see clp_table_cache()).
+ */
+struct clp_cvtlog {
+    unsigned char       *buf;
+    size_t               len;
+    size_t               size;
+    size_t               off;           // Offset of the next record to replay
+    bool                 record;        // Recording conversions
+    bool                 replay;        // Replaying conversions
+    bool                 uncacheable;   // Parse had side effects
+};
+
+struct clp_cvtrec {
+    void                *dst;
+    size_t               sz;
+};
+
+#define CLP_CVTREC_SZ(_xsz) \
+    (roundup(sizeof(struct clp_cvtrec), 16) + roundup((_xsz), 16))
+
+/* Convert str via cvtfunc, recording or replaying the result per
+ * clp->cvtlog (if any).  Converters that depend upon the previous value
+ * (e.g., incr) or that are cheaper to run than to replay (e.g., string)
+ * are always run, as are custom converters (which may have side effects
+ * unknown to us).  Converters with side effects (e.g., open), and those
+ * whose cvtparms they might modify (e.g., vectors) or whose result size
+ * is not known, cannot be replayed and render the parse uncacheable.
+ */
+static int
+clp_convert(struct clp *clp, clp_cvt_cb *cvtfunc, const char *str, int flags,
+            void *parms, void *dst, size_t dstsz)
+{
+    struct clp_cvtlog *log = clp->cvtlog;
+    struct clp_cvtrec *rec;
+    size_t recsz;
+    int rc;
+
+    if (!log || cvtfunc == clp_cvt_string || cvtfunc == clp_cvt_bool ||
+        cvtfunc == clp_cvt_incr)
+        return cvtfunc(clp, str, flags, parms, dst);
+
+    if (clp_cvt_opaque(cvtfunc) || !dst || dstsz == 0 ||
+        (parms && cvtfunc != clp_cvt_subcmd &&
+         cvtfunc != clp_cvt_enum && cvtfunc != clp_cvt_flags)) {
+        log->uncacheable = true;
+        return cvtfunc(clp, str, flags, parms, dst);
+    }
+
+    if (!clp_cvt_pure(cvtfunc))
+        return cvtfunc(clp, str, flags, parms, dst);
+
+    recsz = CLP_CVTREC_SZ(dstsz);
+
+    if (log->replay) {
+        rec = (void *)(log->buf + log->off);
+
+        if (log->off + recsz <= log->len && rec->dst == dst && rec->sz == dstsz) {
+            memcpy(dst, (char *)rec + CLP_CVTREC_SZ(0), dstsz);
+            log->off += recsz;
+            return 0;
+        }
+
+        log->replay = false; // Parse diverged from the recorded parse
+    }
+
+    rc = cvtfunc(clp, str, flags, parms, dst);
+
+    if (rc == 0 && log->record) {
+        if (log->len + recsz > log->size) {
+            size_t size = MAX(log->size * 2, log->len + recsz + 256);
+            unsigned char *buf = realloc(log->buf, size);
+
+            if (!buf) {
+                log->uncacheable = true;
+                return 0;
+            }
+
+            log->buf = buf;
+            log->size = size;
+        }
+
+        rec = (void *)(log->buf + log->len);
+        rec->dst = dst;
+        rec->sz = dstsz;
+        memcpy((char *)rec + CLP_CVTREC_SZ(0), dst, dstsz);
+        log->len += recsz;
+    }
+
+    return rc;
+}
+
+/* Convert one streamed argument (i.e., one read from a response file or
+ * from stdin) and call the param's action, in the manner of arguments
+ * given in argv[].  src and lineno identify the source of the argument
+ * for error messages (if src is not nil), and argv[i] the argument that
+ * named the source (if any).
+ *
+ * Returns zero on success, -1 if a callback asked that parsing stop
+ * quietly, or an exit code from sysexits.h (having recorded the error).
+ */
+static int
+clp_stream_arg(struct clp *clp, struct clp_posparam *param, const char *arg,
+               const char *src, long lineno, char **argv, int i)
+{
+    const char *given = (i >= 0) ? argv[i] : NULL;
+    int rc;
+
+    ++param->streamc;
+
+    if (clp->cvtlog)
+        clp->cvtlog->uncacheable = true;
+
+    if (param->cvtfunc) {
+        errno = 0;
+
+        rc = param->cvtfunc(clp, arg, param->cvtflags, param->cvtparms, param->cvtdst);
+        if (rc > 0) {
+            if (src)
+                clp_eprint(clp, "%s:%ld: unable to convert '%s'", src, lineno, arg);
+            else
+                clp_eprint(clp, "unable to convert '%s'", arg);
+            return clp_fail(clp, rc, CLP_ERR_CONVERT, argv, i, given, NULL, 0);
+        }
+        if (rc)
+            return -1;
+    }
+
+    if (param->action) {
+        rc = param->action(param);
+        if (rc > 0)
+            return clp_fail(clp, rc, CLP_ERR_CALLBACK, argv, i, given, NULL, 0);
+        if (rc)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Stream arguments from stdin to the given posparam, each of which is
+ * terminated by a newline (or by a NUL if param->stream is
+ * CLP_STREAM_NUL).  Empty lines are ignored.  Only the longest argument
+ * need fit in memory, and each argument is valid only for the duration
+ * of the calls made for it.
+ *
+ * Returns as per clp_stream_arg().
+ */
+static int
+clp_stdin_stream(struct clp *clp, struct clp_posparam *param, char **argv, int i)
+{
+    int delim = (param->stream == CLP_STREAM_NUL) ? '\000' : '\n';
+    size_t bufsz = 0;
+    char *buf = NULL;
+    long lineno = 0;
+    ssize_t cc;
+    int rc = 0;
+
+    while (( cc = getdelim(&buf, &bufsz, delim, stdin) ) > 0) {
+        ++lineno;
+
+        if (buf[cc - 1] == delim)
+            buf[--cc] = '\000';
+        if (cc == 0 && delim == '\n')
+            continue;
+
+        rc = clp_stream_arg(clp, param, buf, "stdin", lineno, argv, i);
+        if (rc)
+            break;
+    }
+
+    if (!rc && ferror(stdin)) {
+        clp_eprint(clp, "unable to read stdin");
+        rc = clp_fail(clp, EX_IOERR, CLP_ERR_CONVERT, argv, i, (i >= 0) ? argv[i] : NULL, NULL, 0);
+    }
+
+    free(buf);
+
+    return rc;
+}
+
+/* Find the next word in src[] (bounded by end) per the rules of
+ * clp_breakargs() (with a nil delimiter), unquoting and unescaping it
+ * in place.  Returns the length of the word (which starts at *tokp),
+ * zero if there are no more words, or -1 if a quote is unterminated.
+ * *srcp is advanced past the word, *linenop is set to the line on
+ * which the word starts, and *nlp counts the newlines within (and
+ * just after) the word.
+ */
+static ssize_t
+clp_rsp_token(char **srcp, char *end, int *linenop, int *nlp, char **tokp)
+{
+    bool backslash, dquote, squote;
+    char *src = *srcp, *dst;
+
+    *linenop += *nlp;
+    *nlp = 0;
+
+    while (1) {
+        while (src < end && (isspace(*src) || !*src)) {
+            if (*src++ == '\n')
+                ++*linenop;
+        }
+
+        if (src >= end) {
+            *srcp = src;
+            return 0;
+        }
+
+        backslash = dquote = squote = false;
+        *tokp = dst = src;
+
+        for (; src < end; ++src) {
+            if (backslash) {
+                backslash = false;
+
+                switch (*src) {
+                case 'a': *dst++ = '\a'; break;
+                case 'b': *dst++ = '\b'; break;
+                case 'f': *dst++ = '\f'; break;
+                case 'n': *dst++ = '\n'; break;
+                case 'r': *dst++ = '\r'; break;
+                case 't': *dst++ = '\t'; break;
+                case 'v': *dst++ = '\v'; break;
+
+                default:
+                    if (*src >= '0' && *src <= '7') {
+                        int val = 0;
+
+                        for (int n = 0; n < 3 && src < end && *src >= '0' && *src <= '7'; ++n)
+                            val = val * 8 + (*src++ - '0');
+                        *dst++ = val;
+                        --src;
+                        break;
+                    }
+
+                    if (*src == '\n')
+                        ++*nlp;
+                    *dst++ = *src;
+                    break;
+                }
+            }
+            else if (*src == '\\') {
+                backslash = true;
+            }
+            else if (*src == '"' && !squote) {
+                dquote = !dquote;
+            }
+            else if (*src == '\'' && !dquote) {
+                squote = !squote;
+            }
+            else if (!dquote && !squote && (isspace(*src) || !*src)) {
+                if (*src++ == '\n')
+                    ++*nlp;
+                break;
+            }
+            else {
+                if (*src == '\n')
+                    ++*nlp;
+                *dst++ = *src;
+            }
+        }
+
+        if (dquote || squote)
+            return -1;
+
+        *srcp = src;
+
+        /* Empty words (e.g., "") are elided, as per clp_breakargs().
+         */
+        if (dst > *tokp)
+            return dst - *tokp;
+    }
+}
+
+/* The contents of a file, either mapped privately or, if the file is not
+ * a regular file (e.g., a pipe or a terminal), read into a buffer.  The
+ * contents may be modified in place, and if termok then a NUL may also be
+ * written at end (i.e., just past the contents).
+ */
+struct clp_fload {
+    char                *base;
+    char                *end;
+    size_t               mapsz;         // Size of the mapping (zero if read)
+    bool                 termok;
+};
+
+#define CLP_FLOAD_CHUNK     (65536)
+
+/* Load the contents of the given open file (see struct clp_fload), giving
+ * advice (e.g., MADV_SEQUENTIAL) to madvise() if the file is mapped.
+ *
+ * On error, sets errno and returns -1.
+ */
+static int
+clp_fload(int fd, int advice, struct clp_fload *fl)
+{
+    size_t len = 0, size = 0;
+    struct stat sb;
+    char *buf = NULL;
+
+    memset(fl, 0, sizeof(*fl));
+
+    if (fstat(fd, &sb))
+        return -1;
+
+    if (S_ISREG(sb.st_mode)) {
+        if (sb.st_size == 0)
+            return 0;
+
+        fl->base = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (fl->base == MAP_FAILED) {
+            fl->base = NULL;
+            return -1;
+        }
+
+        madvise(fl->base, sb.st_size, advice);
+
+        fl->mapsz = sb.st_size;
+        fl->end = fl->base + sb.st_size;
+        fl->termok = (sb.st_size % getpagesize()) != 0;
+
+        return 0;
+    }
+
+    while (1) {
+        ssize_t cc;
+
+        if (len + 1 >= size) {
+            size_t newsz = size ? size * 2 : CLP_FLOAD_CHUNK;
+            char *tmp = realloc(buf, newsz);
+
+            if (!tmp) {
+                free(buf);
+                errno = ENOMEM;
+                return -1;
+            }
+
+            buf = tmp;
+            size = newsz;
+        }
+
+        cc = read(fd, buf + len, size - len - 1);
+        if (cc == -1) {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            return -1;
+        }
+
+        if (cc == 0)
+            break;
+
+        len += cc;
+    }
+
+    fl->base = buf;
+    fl->end = buf + len;
+    fl->termok = true;
+
+    return 0;
+}
+
+static void
+clp_funload(struct clp_fload *fl)
+{
+    if (fl->mapsz > 0)
+        munmap(fl->base, fl->mapsz);
+    else
+        free(fl->base);
+}
+
+/* Stream the words of the response file named by arg (sans its leading
+ * '@') to the given posparam, calling its converter and action for each
+ * word in turn without first building an argument vector.  The file is
+ * mapped privately (or read, if it's not a regular file) so that words
+ * can be terminated in place, and each word is valid only for the
+ * duration of the calls made for it.
+ *
+ * Returns as per clp_stream_arg().
+ */
+static int
+clp_rsp_stream(struct clp *clp, struct clp_posparam *param, char **argv, int i)
+{
+    const char *path = argv[i] + 1;
+    char *src, *end, *tok, *last = NULL;
+    int lineno, nl, rc, fd;
+    struct clp_fload fl;
+    ssize_t len;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        clp_eprint(clp, "unable to open response file '%s'", path);
+        return clp_fail(clp, EX_NOINPUT, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+    }
+
+    rc = clp_fload(fd, MADV_SEQUENTIAL, &fl);
+    close(fd);
+
+    if (rc) {
+        clp_eprint(clp, "unable to load response file '%s'", path);
+        return clp_fail(clp, EX_IOERR, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+    }
+
+    src = fl.base;
+    end = fl.end;
+    lineno = 1;
+    nl = 0;
+    rc = 0;
+
+    while (( len = clp_rsp_token(&src, end, &lineno, &nl, &tok) ) > 0) {
+        /* The last word of the file might abut the end of the mapping,
+         * in which case it must be copied in order to terminate it.
+         */
+        if (tok + len < end) {
+            tok[len] = '\000';
+        } else {
+            last = strndup(tok, len);
+            if (!last) {
+                clp_eprint(clp, "%s: unable to load", path);
+                rc = clp_fail(clp, EX_OSERR, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+                break;
+            }
+            tok = last;
+        }
+
+        rc = clp_stream_arg(clp, param, tok, path, lineno, argv, i);
+        if (rc)
+            break;
+    }
+
+    if (len < 0) {
+        clp_eprint(clp, "%s:%d: unterminated quote", path, lineno);
+        rc = clp_fail(clp, EX_DATAERR, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+    }
+
+    free(last);
+    clp_funload(&fl);
+
+    return rc;
+}
+
+/* A directory to be walked.  Directories found by the walk are opened
+ * relative to their parent, whose descriptor is kept open for as long
+ * as any of its subdirectories remain to be opened (each of which holds
+ * a reference on it).  Roots (i.e., those named on the command line)
+ * have neither a parent nor a name.
+ */
+struct clp_walkent {
+    struct clp_walkent  *parent;
+    int                  refcnt;
+    int                  fd;            // Open once a subdirectory is queued
+    const char          *name;          // Last component of path
+    char                 path[];
+};
+
+/* A deque of the directories yet to be walked by one walker thread.  The
+ * owner pushes and pops at the tail (i.e., depth first), whereas threads
+ * that run out of work steal from the head.
+ */
+struct clp_walkdq {
+    struct clp_walker   *wkr;
+    pthread_mutex_t      mtx;
+    struct clp_walkent **dirv;
+    size_t               head;
+    size_t               tail;
+    size_t               size;
+} __attribute__((__aligned__(64)));
+
+/* A batch of NUL terminated paths found by a walker thread.
+ */
+struct clp_walkbatch {
+    struct clp_walkbatch *next;
+    size_t               len;
+    size_t               size;
+    char                 buf[];
+};
+
+#define CLP_WALK_BATCHSZ    (16384) // Bytes of paths per batch
+#define CLP_WALK_BACKLOG    (64)    // Max batches awaiting the parser
+#define CLP_WALK_THREADS    (16)    // Max walker threads by default
+
+/* State shared by the parser and the threads of a directory walk.
+ */
+struct clp_walker {
+    const struct clp_walk *walk;
+    struct clp_walkdq   *dqv;
+    int                  dqc;
+
+    pthread_mutex_t      mtx;           // Protects all of the following
+    pthread_cond_t       workcv;        // Directories were queued (or the walk ended)
+    pthread_cond_t       outcv;         // A batch was published (or a thread finished)
+    pthread_cond_t       spacecv;       // A batch was consumed (or the walk was canceled)
+    long                 pending;       // Directories queued or being walked
+    int                  running;       // Walker threads yet to finish
+    int                  idle;          // Walker threads awaiting work
+    struct clp_walkbatch *head;
+    struct clp_walkbatch **tail;
+    int                  batchc;
+    bool                 cancel;
+    int                  xerrno;        // errno of the first directory that failed
+    char                *errpath;
+};
+
+/* Return true if a path of the type and size given by sb passes the
+ * walk's filters.
+ */
+static bool
+clp_walk_match(const struct clp_walk *walk, const struct stat *sb)
+{
+    int type = CLP_WALK_OTHER;
+
+    if (S_ISREG(sb->st_mode))
+        type = CLP_WALK_REG;
+    else if (S_ISDIR(sb->st_mode))
+        type = CLP_WALK_DIR;
+    else if (S_ISLNK(sb->st_mode))
+        type = CLP_WALK_LNK;
+
+    if (walk->types && !(walk->types & type))
+        return false;
+
+    if (type == CLP_WALK_REG) {
+        if (sb->st_size < walk->minsize)
+            return false;
+        if (walk->maxsize > 0 && sb->st_size > walk->maxsize)
+            return false;
+    }
+
+    return true;
+}
+
+static void
+clp_walk_cancel(struct clp_walker *wkr)
+{
+    __atomic_store_n(&wkr->cancel, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&wkr->workcv);
+    pthread_cond_broadcast(&wkr->spacecv);
+}
+
+/* Record the first error encountered by the walk and cancel it.
+ */
+static void
+clp_walk_fail(struct clp_walker *wkr, const char *path, int xerrno)
+{
+    pthread_mutex_lock(&wkr->mtx);
+    if (!wkr->errpath) {
+        wkr->errpath = strdup(path);
+        wkr->xerrno = xerrno;
+    }
+    clp_walk_cancel(wkr);
+    pthread_mutex_unlock(&wkr->mtx);
+}
+
+/* Create a walk entry for the directory dir/name, which holds a
+ * reference on parent (if given).  If name is nil then dir is a root.
+ */
+static struct clp_walkent *
+clp_walk_ent(struct clp_walkent *parent, const char *dir, const char *name)
+{
+    size_t dirlen = strlen(dir);
+    size_t len = dirlen + (name ? strlen(name) + 2 : 1);
+    struct clp_walkent *ent;
+
+    ent = malloc(sizeof(*ent) + len);
+    if (!ent)
+        return NULL;
+
+    ent->parent = parent;
+    ent->refcnt = 1;
+    ent->fd = -1;
+    ent->name = NULL;
+
+    if (name) {
+        int n = snprintf(ent->path, len, "%s%s", dir, (dirlen > 0 && dir[dirlen - 1] == '/') ? "" : "/");
+
+        snprintf(ent->path + n, len - n, "%s", name);
+        ent->name = ent->path + n;
+    } else {
+        memcpy(ent->path, dir, len);
+    }
+
+    if (parent)
+        __atomic_add_fetch(&parent->refcnt, 1, __ATOMIC_RELAXED);
+
+    return ent;
+}
+
+/* Drop a reference on the given entry, and on its ancestors in turn as
+ * each is freed.
+ */
+static void
+clp_walk_put(struct clp_walkent *ent)
+{
+    while (ent && __atomic_sub_fetch(&ent->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        struct clp_walkent *parent = ent->parent;
+
+        if (ent->fd != -1)
+            close(ent->fd);
+        free(ent);
+        ent = parent;
+    }
+}
+
+/* Queue a directory to be walked, preferably by the thread that owns
+ * the given deque.  Takes ownership of dir.
+ */
+static int
+clp_walk_push(struct clp_walkdq *dq, struct clp_walkent *dir)
+{
+    struct clp_walker *wkr = dq->wkr;
+
+    pthread_mutex_lock(&dq->mtx);
+    if (dq->tail >= dq->size) {
+        if (dq->head > 0) {
+            memmove(dq->dirv, dq->dirv + dq->head, sizeof(*dq->dirv) * (dq->tail - dq->head));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        } else {
+            size_t size = dq->size ? dq->size * 2 : 64;
+            struct clp_walkent **dirv = realloc(dq->dirv, sizeof(*dirv) * size);
+
+            if (!dirv) {
+                pthread_mutex_unlock(&dq->mtx);
+                clp_walk_put(dir);
+                return ENOMEM;
+            }
+
+            dq->dirv = dirv;
+            dq->size = size;
+        }
+    }
+    dq->dirv[dq->tail++] = dir;
+    pthread_mutex_unlock(&dq->mtx);
+
+    pthread_mutex_lock(&wkr->mtx);
+    ++wkr->pending;
+    if (wkr->idle > 0)
+        pthread_cond_signal(&wkr->workcv);
+    pthread_mutex_unlock(&wkr->mtx);
+
+    return 0;
+}
+
+/* Take the next directory to walk from the given deque, or else steal
+ * one from another thread's deque.
+ */
+static struct clp_walkent *
+clp_walk_take(struct clp_walkdq *dq)
+{
+    struct clp_walker *wkr = dq->wkr;
+    int w = dq - wkr->dqv;
+    struct clp_walkent *dir = NULL;
+
+    for (int n = 0; n < wkr->dqc && !dir; ++n) {
+        dq = wkr->dqv + (w + n) % wkr->dqc;
+
+        pthread_mutex_lock(&dq->mtx);
+        if (dq->head < dq->tail)
+            dir = (n == 0) ? dq->dirv[--dq->tail] : dq->dirv[dq->head++];
+        pthread_mutex_unlock(&dq->mtx);
+    }
+
+    return dir;
+}
+
+/* Hand a batch of paths off to the parser, waiting for it to catch up
+ * if it has fallen too far behind.
+ */
+static void
+clp_walk_publish(struct clp_walker *wkr, struct clp_walkbatch *batch)
+{
+    if (!batch)
+        return;
+
+    pthread_mutex_lock(&wkr->mtx);
+    while (wkr->batchc >= CLP_WALK_BACKLOG && !wkr->cancel)
+        pthread_cond_wait(&wkr->spacecv, &wkr->mtx);
+
+    if (!wkr->cancel) {
+        batch->next = NULL;
+        *wkr->tail = batch;
+        wkr->tail = &batch->next;
+        ++wkr->batchc;
+        pthread_cond_signal(&wkr->outcv);
+        batch = NULL;
+    }
+    pthread_mutex_unlock(&wkr->mtx);
+
+    free(batch);
+}
+
+/* Append the path dir/name to *batchp, publishing the batch and starting
+ * a new one when it is full.
+ */
+static int
+clp_walk_emit(struct clp_walker *wkr, struct clp_walkbatch **batchp,
+              const char *dir, const char *name)
+{
+    struct clp_walkbatch *batch = *batchp;
+    size_t dirlen = strlen(dir);
+    const char *sep = (dirlen > 0 && dir[dirlen - 1] == '/') ? "" : "/";
+    size_t len = dirlen + strlen(name) + 2;
+
+    if (batch && batch->len + len > batch->size) {
+        clp_walk_publish(wkr, batch);
+        *batchp = batch = NULL;
+    }
+
+    if (!batch) {
+        size_t size = MAX(len, CLP_WALK_BATCHSZ);
+
+        batch = malloc(sizeof(*batch) + size);
+        if (!batch)
+            return ENOMEM;
+
+        batch->len = 0;
+        batch->size = size;
+        *batchp = batch;
+    }
+
+    batch->len += snprintf(batch->buf + batch->len, len, "%s%s%s", dir, sep, name) + 1;
+
+    return 0;
+}
+
+/* Open the given directory, relative to its parent if possible.  Roots
+ * are opened by path, following symbolic links (as per find -H),
+ * whereas directories found by the walk are never followed.
+ */
+static int
+clp_walk_open(struct clp_walkent *ent)
+{
+    struct clp_walkent *parent = ent->parent;
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd;
+
+    if (!parent)
+        return open(ent->path, flags);
+
+    if (parent->fd != -1)
+        fd = openat(parent->fd, ent->name, flags | O_NOFOLLOW);
+    else
+        fd = openat(AT_FDCWD, ent->path, flags | O_NOFOLLOW);
+
+    ent->parent = NULL;
+    clp_walk_put(parent);
+
+    return fd;
+}
+
+/* Read the entries of one directory, queueing its subdirectories to be
+ * walked and appending those entries that pass the walk's filters to
+ * *batchp.  The type of each entry is taken from readdir() if possible,
+ * as it is fstat'd only if its type is unknown or its size is needed.
+ * Symbolic links found by the walk are never followed.
+ */
+static void
+clp_walk_dir(struct clp_walkdq *dq, struct clp_walkent *ent, struct clp_walkbatch **batchp)
+{
+    struct clp_walker *wkr = dq->wkr;
+    const struct clp_walk *walk = wkr->walk;
+    bool sized = (walk->minsize > 0 || walk->maxsize > 0);
+    const char *dir = ent->path;
+    bool root = !ent->parent;
+    bool held = false;
+    struct dirent *dent;
+    DIR *dp;
+    int fd;
+
+    fd = clp_walk_open(ent);
+    if (fd == -1) {
+        if (errno != ENOENT && errno != ENOTDIR && (root || errno != ELOOP))
+            clp_walk_fail(wkr, dir, errno);
+        return; // Removed (or replaced) since it was found
+    }
+
+    dp = fdopendir(fd);
+    if (!dp) {
+        clp_walk_fail(wkr, dir, errno);
+        close(fd);
+        return;
+    }
+
+    while (!__atomic_load_n(&wkr->cancel, __ATOMIC_RELAXED)) {
+        struct clp_walkent *sub;
+        const char *name;
+        struct stat sb;
+
+        errno = 0;
+        dent = readdir(dp);
+        if (!dent) {
+            if (errno)
+                clp_walk_fail(wkr, dir, errno);
+            break;
+        }
+
+        name = dent->d_name;
+
+        if (name[0] == '.') {
+            if (!name[1] || (name[1] == '.' && !name[2]))
+                continue;
+            if (!(walk->flags & CLP_WALK_HIDDEN))
+                continue;
+        }
+
+        memset(&sb, 0, sizeof(sb));
+
+        if (dent->d_type == DT_UNKNOWN || (dent->d_type == DT_REG && sized)) {
+            if (fstatat(fd, name, &sb, AT_SYMLINK_NOFOLLOW))
+                continue; // Removed since readdir()
+        } else {
+            sb.st_mode = (dent->d_type == DT_DIR) ? S_IFDIR :
+                (dent->d_type == DT_REG) ? S_IFREG :
+                (dent->d_type == DT_LNK) ? S_IFLNK : S_IFIFO;
+        }
+
+        if (clp_walk_match(walk, &sb) && clp_walk_emit(wkr, batchp, dir, name)) {
+            clp_walk_fail(wkr, dir, ENOMEM);
+            break;
+        }
+
+        if (!S_ISDIR(sb.st_mode))
+            continue;
+
+        /* Keep a descriptor open for our subdirectories to be opened
+         * relative to.  If we can't then they're opened by path.
+         */
+        if (!held) {
+            ent->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            held = true;
+        }
+
+        sub = clp_walk_ent(ent, dir, name);
+        if (!sub || clp_walk_push(dq, sub)) {
+            clp_walk_fail(wkr, dir, ENOMEM);
+            break;
+        }
+    }
+
+    closedir(dp);
+}
+
+static void *
+clp_walk_main(void *arg)
+{
+    struct clp_walkdq *dq = arg;
+    struct clp_walker *wkr = dq->wkr;
+    struct clp_walkbatch *batch = NULL;
+
+    while (1) {
+        struct clp_walkent *dir = clp_walk_take(dq);
+
+        if (!dir) {
+            /* Publish what we have so that the parser needn't wait on
+             * us while we wait for more work.
+             */
+            clp_walk_publish(wkr, batch);
+            batch = NULL;
+
+            pthread_mutex_lock(&wkr->mtx);
+            while (wkr->pending > 0 && !wkr->cancel) {
+                dir = clp_walk_take(dq);
+                if (dir)
+                    break;
+
+                ++wkr->idle;
+                pthread_cond_wait(&wkr->workcv, &wkr->mtx);
+                --wkr->idle;
+            }
+            pthread_mutex_unlock(&wkr->mtx);
+
+            if (!dir)
+                break;
+        }
+
+        if (!__atomic_load_n(&wkr->cancel, __ATOMIC_RELAXED))
+            clp_walk_dir(dq, dir, &batch);
+
+        clp_walk_put(dir);
+
+        pthread_mutex_lock(&wkr->mtx);
+        if (--wkr->pending == 0)
+            pthread_cond_broadcast(&wkr->workcv);
+        pthread_mutex_unlock(&wkr->mtx);
+    }
+
+    clp_walk_publish(wkr, batch);
+
+    pthread_mutex_lock(&wkr->mtx);
+    --wkr->running;
+    pthread_cond_signal(&wkr->outcv);
+    pthread_mutex_unlock(&wkr->mtx);
+
+    return NULL;
+}
+
+/* Expand the given argument of a posparam whose walk field is set into
+ * the paths it names, and stream each path that passes the walk's
+ * filters to the param's converter and action in the manner of
+ * clp_stdin_stream().  The argument is first expanded as a glob(3)
+ * pattern if CLP_WALK_GLOB is set, and then each directory among the
+ * resulting paths is walked recursively if CLP_WALK_RECURSE is set.
+ *
+ * Directories are walked by a pool of threads, each of which prefers
+ * the directories it found itself (depth first) and steals from the
+ * others when it runs out.  The threads hand their findings to the
+ * parser in batches, so the callbacks (which run only on the calling
+ * thread) overlap with the walk.  Hence the order in which paths are
+ * delivered is unspecified, other than that the paths named by the
+ * argument itself precede those found by walking them.
+ *
+ * Returns as per clp_stream_arg().
+ */
+static int
+clp_walk(struct clp *clp, struct clp_posparam *param, char **argv, int i)
+{
+    const struct clp_walk *walk = param->walk;
+    const char *arg = argv[i];
+    struct clp_walkbatch *batch;
+    struct clp_walker wkr;
+    glob_t gl = { .gl_pathc = 0 };
+    char *argvec[] = { (char *)arg, NULL };
+    char **pathv = argvec;
+    int nthreads, started = 0;
+    int rc = 0;
+
+    if ((walk->flags & CLP_WALK_GLOB) && strpbrk(arg, "*?[")) {
+        rc = glob(arg, GLOB_NOCHECK, NULL, &gl);
+        if (rc) {
+            errno = (rc == GLOB_NOSPACE) ? ENOMEM : EIO;
+            clp_eprint(clp, "unable to expand '%s'", arg);
+            return clp_fail(clp, EX_NOINPUT, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+        }
+
+        pathv = gl.gl_pathv;
+    }
+
+    nthreads = walk->nthreads;
+    if (nthreads <= 0)
+        nthreads = MIN(MAX(sysconf(_SC_NPROCESSORS_ONLN), 1), CLP_WALK_THREADS);
+
+    struct clp_walkdq dqv[nthreads];
+    pthread_t tidv[nthreads];
+
+    memset(&wkr, 0, sizeof(wkr));
+    wkr.walk = walk;
+    wkr.dqv = dqv;
+    wkr.dqc = nthreads;
+    wkr.tail = &wkr.head;
+    pthread_mutex_init(&wkr.mtx, NULL);
+    pthread_cond_init(&wkr.workcv, NULL);
+    pthread_cond_init(&wkr.outcv, NULL);
+    pthread_cond_init(&wkr.spacecv, NULL);
+
+    for (int n = 0; n < nthreads; ++n) {
+        memset(dqv + n, 0, sizeof(dqv[n]));
+        dqv[n].wkr = &wkr;
+        pthread_mutex_init(&dqv[n].mtx, NULL);
+    }
+
+    /* Deliver the paths named by the argument, and distribute those that
+     * are directories amongst the threads' deques (following symlinks
+     * given explicitly).  Paths that cannot be stat'd are delivered
+     * as-is, leaving it to the converter to complain.
+     */
+    for (int n = 0; pathv[n] && !rc; ++n) {
+        struct stat sb;
+
+        if (stat(pathv[n], &sb)) {
+            rc = clp_stream_arg(clp, param, pathv[n], NULL, 0, argv, i);
+            continue;
+        }
+
+        if (clp_walk_match(walk, &sb))
+            rc = clp_stream_arg(clp, param, pathv[n], NULL, 0, argv, i);
+
+        if (S_ISDIR(sb.st_mode) && (walk->flags & CLP_WALK_RECURSE) && !rc) {
+            struct clp_walkent *dir = clp_walk_ent(NULL, pathv[n], NULL);
+
+            if (!dir || clp_walk_push(dqv + wkr.pending % nthreads, dir)) {
+                clp_eprint(clp, "unable to walk '%s'", pathv[n]);
+                rc = clp_fail(clp, EX_OSERR, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+            }
+        }
+    }
+
+    if (!rc && wkr.pending > 0) {
+        for (int n = 0; n < nthreads; ++n) {
+            pthread_mutex_lock(&wkr.mtx);
+            ++wkr.running;
+            pthread_mutex_unlock(&wkr.mtx);
+
+            if (pthread_create(tidv + started, NULL, clp_walk_main, dqv + n)) {
+                pthread_mutex_lock(&wkr.mtx);
+                --wkr.running;
+                pthread_mutex_unlock(&wkr.mtx);
+                continue; // The others will steal its work
+            }
+
+            ++started;
+        }
+
+        if (started == 0) {
+            clp_eprint(clp, "unable to walk '%s'", arg);
+            rc = clp_fail(clp, EX_OSERR, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+        }
+    }
+
+    /* Consume the threads' findings until they have all finished, or
+     * until a callback fails (in which case the walk is canceled).
+     */
+    pthread_mutex_lock(&wkr.mtx);
+    while (!rc) {
+        while (!wkr.head && wkr.running > 0)
+            pthread_cond_wait(&wkr.outcv, &wkr.mtx);
+
+        batch = wkr.head;
+        if (!batch)
+            break;
+
+        wkr.head = batch->next;
+        if (!wkr.head)
+            wkr.tail = &wkr.head;
+        --wkr.batchc;
+        pthread_cond_signal(&wkr.spacecv);
+        pthread_mutex_unlock(&wkr.mtx);
+
+        for (char *path = batch->buf; path < batch->buf + batch->len && !rc; path += strlen(path) + 1)
+            rc = clp_stream_arg(clp, param, path, NULL, 0, argv, i);
+
+        free(batch);
+
+        pthread_mutex_lock(&wkr.mtx);
+    }
+    clp_walk_cancel(&wkr);
+    pthread_mutex_unlock(&wkr.mtx);
+
+    for (int n = 0; n < started; ++n)
+        pthread_join(tidv[n], NULL);
+
+    while (( batch = wkr.head )) {
+        wkr.head = batch->next;
+        free(batch);
+    }
+
+    for (int n = 0; n < nthreads; ++n) {
+        while (dqv[n].head < dqv[n].tail)
+            clp_walk_put(dqv[n].dirv[dqv[n].head++]);
+        free(dqv[n].dirv);
+        pthread_mutex_destroy(&dqv[n].mtx);
+    }
+
+    if (!rc && wkr.errpath) {
+        errno = wkr.xerrno;
+        clp_eprint(clp, "unable to walk '%s'", wkr.errpath);
+        rc = clp_fail(clp, EX_NOINPUT, CLP_ERR_CONVERT, argv, i, argv[i], NULL, 0);
+    }
+
+    free(wkr.errpath);
+    pthread_cond_destroy(&wkr.spacecv);
+    pthread_cond_destroy(&wkr.outcv);
+    pthread_cond_destroy(&wkr.workcv);
+    pthread_mutex_destroy(&wkr.mtx);
+    if (pathv != argvec)
+        globfree(&gl);
+
+    return rc;
+}
+
+/* State shared by the threads of a parallel posparam conversion.  Each
+ * argument is converted into its own slot, and the lowest index of all
+ * the arguments that failed to convert (if any) is retained along with
+ * the details of its failure.
+ */
+struct clp_pcvt {
+    struct clp          *clp;
+    struct clp_posparam *param;
+    unsigned char       *slotv;         // One slot of cvtdstsz bytes per argument
+    char                *okv;           // Slots that hold a converted value
+    int                  next;          // Index of the next unclaimed argument
+    int                  failidx;       // Index of first failure (argc if none)
+    int                  failrc;
+    int                  failerrno;
+    char                 failbuf[CLP_ERRBUF_MAX];
+    pthread_mutex_t      mtx;
+};
+
+#define CLP_PCVT_CHUNK      (16)    // Arguments claimed at a time by each thread
+
+static void clp_value_release(clp_cvt_cb *cvtfunc, void *val);
+
+static void *
+clp_pcvt_main(void *arg)
+{
+    struct clp_pcvt *pcvt = arg;
+    struct clp_posparam *param = pcvt->param;
+    size_t slotsz = param->cvtdstsz;
+    struct clp clp;
+    int i, end, rc;
+
+    /* Converters report the details of errors via clp->errbuf.
+     */
+    clp = *pcvt->clp;
+    clp.cvtlog = NULL;
+
+    while (1) {
+        i = __atomic_fetch_add(&pcvt->next, CLP_PCVT_CHUNK, __ATOMIC_RELAXED);
+        end = MIN(i + CLP_PCVT_CHUNK, param->argc);
+
+        if (i >= end)
+            break;
+
+        for (; i < end; ++i) {
+            if (i > __atomic_load_n(&pcvt->failidx, __ATOMIC_RELAXED))
+                return NULL;
+
+            clp.errbuf[0] = '\000';
+            errno = 0;
+
+            rc = param->cvtfunc(&clp, param->argv[i], param->cvtflags, param->cvtparms,
+                                pcvt->slotv + slotsz * i);
+            if (rc == 0) {
+                pcvt->okv[i] = 1;
+                continue;
+            }
+
+            pthread_mutex_lock(&pcvt->mtx);
+            if (i < pcvt->failidx) {
+                pcvt->failrc = rc;
+                pcvt->failerrno = errno;
+                strcpy(pcvt->failbuf, clp.errbuf);
+                __atomic_store_n(&pcvt->failidx, i, __ATOMIC_RELAXED);
+            }
+            pthread_mutex_unlock(&pcvt->mtx);
+        }
+    }
+
+    return NULL;
+}
+
+/* Return true if the given param's arguments may be converted in
+ * parallel.  Its converter must have been declared thread-safe (by
+ * setting cvtthreads), must not depend upon the previous value of
+ * cvtdst (e.g., incr), and must not modify cvtparms (e.g., vectors).
+ * Parses whose conversions are to be cached, and arguments that name
+ * response files or stdin, are always converted serially.
+ */
+static bool
+clp_pcvt_eligible(const struct clp *clp, const struct clp_posparam *param)
+{
+    if (param->cvtthreads < 2 || param->argc < 2 || clp->cvtlog)
+        return false;
+
+    if (!param->cvtfunc || param->cvtsubcmd || param->cvtparms ||
+        !param->cvtdst || param->cvtdstsz == 0)
+        return false;
+
+    if (param->cvtfunc == clp_cvt_bool || param->cvtfunc == clp_cvt_incr ||
+        param->cvtfunc == clp_cvt_list || param->cvtfunc == clp_cvt_kvmap)
+        return false;
+
+    if (param->walk)
+        return false;
+
+    for (int i = 0; i < param->argc && (param->rspfile || param->stream); ++i) {
+        const char *arg = param->argv[i];
+
+        if (param->rspfile && arg[0] == '@' && arg[1])
+            return false;
+        if (param->stream && 0 == strcmp(arg, "-"))
+            return false;
+    }
+
+    return true;
+}
+
+/* Convert all the given param's arguments concurrently on up to
+ * param->cvtthreads threads, each into its own slot, and then call the
+ * param's action() for each argument in argv order with its converted
+ * value in *cvtdst.  If any argument fails to convert, the actions of
+ * all the arguments before the first such argument are called, and
+ * then the failure of that argument is reported (exactly as had they
+ * been converted serially).  Values converted but not consumed by an
+ * action (e.g., those after a failure) are released.
+ *
+ * Sets *donep to false if the conversion could not be started (in which
+ * case the arguments should be converted serially).
+ */
+static int
+clp_pcvt(struct clp *clp, struct clp_posparam *param, bool *donep)
+{
+    size_t slotsz = param->cvtdstsz;
+    struct clp_pcvt pcvt;
+    int nthreads, n, i;
+    int rc = 0;
+
+    memset(&pcvt, 0, sizeof(pcvt));
+    pcvt.clp = clp;
+    pcvt.param = param;
+    pcvt.failidx = param->argc;
+
+    pcvt.slotv = malloc(slotsz * param->argc);
+    pcvt.okv = calloc(param->argc, 1);
+
+    *donep = (pcvt.slotv && pcvt.okv);
+    if (!*donep) {
+        free(pcvt.slotv);
+        free(pcvt.okv);
+        return 0;
+    }
+
+    /* Each slot starts out with the param's current value.
+     */
+    for (i = 0; i < param->argc; ++i)
+        memcpy(pcvt.slotv + slotsz * i, param->cvtdst, slotsz);
+
+    pthread_mutex_init(&pcvt.mtx, NULL);
+
+    nthreads = (param->argc + CLP_PCVT_CHUNK - 1) / CLP_PCVT_CHUNK;
+    nthreads = MIN(nthreads, param->cvtthreads);
+
+    pthread_t tidv[nthreads];
+
+    for (n = 0; n < nthreads - 1; ++n) {
+        if (pthread_create(tidv + n, NULL, clp_pcvt_main, &pcvt))
+            break;
+    }
+
+    clp_pcvt_main(&pcvt);
+
+    while (n-- > 0)
+        pthread_join(tidv[n], NULL);
+
+    pthread_mutex_destroy(&pcvt.mtx);
+
+    for (i = 0; i < param->argc; ++i) {
+        void *slot = pcvt.slotv + slotsz * i;
+
+        if (rc || i > pcvt.failidx) {
+            if (pcvt.okv[i])
+                clp_value_release(param->cvtfunc, slot);
+            continue;
+        }
+
+        if (i == pcvt.failidx) {
+            rc = pcvt.failrc;
+            if (rc > 0) {
+                errno = pcvt.failerrno;
+                strcpy(clp->errbuf, pcvt.failbuf);
+                rc = clp_fail(clp, rc, CLP_ERR_CONVERT, param->argv, i,
+                              param->argv[i], NULL, 0);
+            }
+            continue;
+        }
+
+        memcpy(param->cvtdst, slot, slotsz);
+
+        if (param->action) {
+            rc = param->action(param);
+            if (rc > 0)
+                rc = clp_fail(clp, rc, CLP_ERR_CALLBACK, param->argv, i,
+                              param->argv[i], NULL, 0);
+        }
+    }
+
+    free(pcvt.okv);
+    free(pcvt.slotv);
+
+    return rc;
+}
+
+/* An after() callback to be run concurrently with those of other options
+ * or posparams in the same phase (see clp_after_phase()).
+ */
+struct clp_after {
+    struct clp_option   *option;        // Either option or param is not nil
+    struct clp_posparam *param;
+    struct clp           clp;           // Private copy of the parser state
+    int                  rc;
+    int                  xerrno;
+};
+
+struct clp_afterpool {
+    struct clp_after    *afterv;
+    int                  afterc;
+    int                  next;          // Index of the next unclaimed callback
+};
+
+#define CLP_AFTER_THREADS   (8)     // Max threads per phase of after() callbacks
+
+static void *
+clp_after_main(void *arg)
+{
+    struct clp_afterpool *pool = arg;
+    struct clp_after *after;
+    int i;
+
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->afterc) {
+        after = pool->afterv + i;
+        errno = 0;
+
+        if (after->option) {
+            after->option->clp = &after->clp;
+            after->rc = after->option->after(after->option);
+        } else {
+            after->param->clp = &after->clp;
+            after->rc = after->param->after(after->param);
+        }
+
+        after->xerrno = errno;
+    }
+
+    return NULL;
+}
+
+/* Run the given after() callbacks concurrently on a small pool of threads
+ * (including the caller's) and wait for all of them to finish.  Each
+ * callback is given a private copy of the parser state, so that messages
+ * left by clp_eprint() do not collide.  Returns the index of the first
+ * callback (in the given order) that returned non-zero, with its errno
+ * and message restored into clp, or -1 if all succeeded.
+ */
+static int
+clp_after_phase(struct clp *clp, struct clp_after *afterv, int afterc)
+{
+    struct clp_afterpool pool = { afterv, afterc, 0 };
+    int nthreads = MIN(afterc, CLP_AFTER_THREADS);
+    pthread_t tidv[nthreads];
+    int n, i;
+
+    for (i = 0; i < afterc; ++i) {
+        afterv[i].clp = *clp;
+        afterv[i].clp.errbuf[0] = '\000';
+        afterv[i].clp.async = NULL;
+        afterv[i].clp.concurrent = true;
+    }
+
+    for (n = 0; n < nthreads - 1; ++n) {
+        if (pthread_create(tidv + n, NULL, clp_after_main, &pool))
+            break;
+    }
+
+    clp_after_main(&pool);
+
+    while (n-- > 0)
+        pthread_join(tidv[n], NULL);
+
+    for (i = 0; i < afterc; ++i) {
+        if (afterv[i].option)
+            afterv[i].option->clp = clp;
+        else
+            afterv[i].param->clp = clp;
+    }
+
+    for (i = 0; i < afterc; ++i) {
+        if (afterv[i].rc) {
+            strcpy(clp->errbuf, afterv[i].clp.errbuf);
+            errno = afterv[i].xerrno;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Return the least after() phase greater than the given phase of any
+ * of the given options (or posparams), or zero if there is none.
+ */
+static int
+clp_after_next(struct clp_option *o, struct clp_posparam *param, int phase)
+{
+    int next = 0;
+
+    for (; o; o = o->next) {
+        if (o->afterphase > phase && (!next || o->afterphase < next))
+            next = o->afterphase;
+    }
+
+    for (; param && param->name; ++param) {
+        if (param->after && (param->argc > 0 || param->streamc > 0) &&
+            param->afterphase > phase && (!next || param->afterphase < next))
+            next = param->afterphase;
+    }
+
+    return next;
+}
+
+/* Call the after() procedures of the given list of options whose
+ * afterphase is not zero, one phase at a time in increasing order of
+ * phase, where all those of a phase run concurrently.
+ */
+static int
+clp_after_options(struct clp *clp, struct clp_option *head, char **argv)
+{
+    int phase = 0;
+    int n = 0;
+
+    for (struct clp_option *o = head; o; o = o->next)
+        ++n;
+
+    struct clp_after afterv[n + 1];
+
+    while ((phase = clp_after_next(head, NULL, phase)) > 0) {
+        int afterc = 0;
+        int i;
+
+        for (struct clp_option *o = head; o; o = o->next) {
+            if (o->afterphase == phase) {
+                afterv[afterc].option = o;
+                afterv[afterc++].param = NULL;
+            }
+        }
+
+        i = clp_after_phase(clp, afterv, afterc);
+        if (i >= 0) {
+            if (afterv[i].rc > 0)
+                return clp_fail(clp, afterv[i].rc, CLP_ERR_CALLBACK, argv, -1,
+                                NULL, afterv[i].option, 0);
+            return afterv[i].rc;
+        }
+    }
+
+    return 0;
+}
+
+/* Like clp_after_options(), but for the filled parameters of paramv[].
+ */
+static int
+clp_after_params(struct clp *clp, struct clp_posparam *paramv)
+{
+    struct clp_posparam *param;
+    int phase = 0;
+    int n = 0;
+
+    for (param = paramv; param->name; ++param)
+        ++n;
+
+    struct clp_after afterv[n + 1];
+
+    while ((phase = clp_after_next(NULL, paramv, phase)) > 0) {
+        int afterc = 0;
+        int i;
+
+        for (param = paramv; param->name; ++param) {
+            if (param->after && (param->argc > 0 || param->streamc > 0) &&
+                param->afterphase == phase) {
+                afterv[afterc].option = NULL;
+                afterv[afterc++].param = param;
+            }
+        }
+
+        i = clp_after_phase(clp, afterv, afterc);
+        if (i >= 0) {
+            param = afterv[i].param;
+
+            if (afterv[i].rc > 0 && param->argc == 0)
+                return clp_fail(clp, afterv[i].rc, CLP_ERR_CALLBACK, clp->argv, -1,
+                                NULL, NULL, 0);
+            if (afterv[i].rc > 0)
+                return clp_fail(clp, afterv[i].rc, CLP_ERR_CALLBACK, param->argv, 0,
+                                param->argv[0], NULL, 0);
+            return afterv[i].rc;
+        }
+    }
+
+    return 0;
+}
+
+/* Parse argv[] against clp->level, descending into the level of each
+ * subcommand as it is encountered such that the entire command line
+ * is processed in a single left-to-right pass.
+ */
+static int
+clp_parsev_impl(struct clp *clp, int argc, char **argv)
+{
+    struct clp_option *options_head, **options_tail;
+    struct clp_posparam *paramv;
+    struct clp_level *lvl;
+    struct clp_option *o;
+    int posmin, posmax;
+    int rc;
+
+  enter:
+    clp_level_enter(clp, argv);
+    lvl = clp->level;
+
+    options_tail = &options_head;
+    *options_tail = NULL;
+
+    paramv = clp->paramv;
+
+    while (1) {
+        struct clp_option *x;
+        int curind = clp->optind;
+        const char *optarg;
+        int longidx;
+        int idx;
+
+        errno = 0;
+
+        idx = clp_scan(clp, argc, argv, &optarg, &longidx);
+
+        if (idx == CLP_SCAN_END) {
+            break;
+        } else if (idx < 0) {
+            rc = clp_fail(clp, EX_USAGE,
+                          (idx == CLP_SCAN_NOARG) ? CLP_ERR_NOARG : CLP_ERR_OPTION,
+                          argv, curind, argv[curind], NULL, 0);
+            clp->error->optopt = clp->optopt;
+            return rc;
+        }
+
+        o = clp->optionv + idx;
+        o->longidx = longidx;
+
+        /* See if this option is excluded by any other option given so far...
+         */
+        x = clp_excludes(clp->optionv, o, 1);
+        if (x) {
+            rc = clp_fail(clp, EX_USAGE, CLP_ERR_EXCLUDES, argv, curind,
+                          argv[curind], o, 0);
+            clp->error->xoptopt = x->optopt;
+            return rc;
+        }
+
+        /* Build a list of after procs to run after option processing
+         */
+        if (o->after && !o->given) {
+            o->next = NULL;
+            *options_tail = o;
+            options_tail = &o->next;
+        }
+
+        o->optarg = optarg;
+        ++o->given;
+
+        if (o->paramv)
+            paramv = o->paramv;
+
+        if (o->cvtfunc) {
+            if (o->given > 1 && o->cvtdst) {
+                if (o->cvtfunc == clp_cvt_string) {
+                    free(*(void **)o->cvtdst);
+                    *(void **)o->cvtdst = NULL;
+                }
+            } else if (o->cvtdst) {
+                clp_value_reset(o->cvtfunc, o->cvtdst);
+            }
+
+            rc = clp_convert(clp, o->cvtfunc, optarg, o->cvtflags, o->cvtparms,
+                             o->cvtdst, o->cvtdstsz);
+            if (rc) {
+                if (rc > 0)
+                    return clp_fail(clp, rc, CLP_ERR_CONVERT, argv, clp->optind - 1,
+                                    optarg, o, 0);
+                return 0;
+            }
+        }
+
+        if (o->action) {
+            rc = o->action(o);
+            if (rc) {
+                if (rc > 0)
+                    return clp_fail(clp, rc, CLP_ERR_CALLBACK, argv, curind,
+                                    argv[curind], o, 0);
+                return 0;
+            }
+        }
+    }
+
+    posmin = posmax = 0;
+    argc -= clp->optind;
+    argv += clp->optind;
+
+    /* Only check positional parameter counts if paramv is not NULL.
+     * This allows the caller to prevent parameter processing by clp
+     * and handle it themselves.
+     */
+    if (paramv) {
+        for (int k = 0; k < lvl->paramvc; ++k) {
+            if (lvl->paramvv[k] == paramv) {
+                posmin = lvl->posminv[k];
+                posmax = lvl->posmaxv[k];
+                break;
+            }
+        }
+
+        if (argc < posmin) {
+            return clp_fail(clp, EX_USAGE, CLP_ERR_TOOFEW, argv, argc ? 0 : -1,
+                            argc ? argv[0] : NULL, NULL, posmin - argc);
+        }
+        else if (argc > posmax) {
+            return clp_fail(clp, EX_USAGE, CLP_ERR_TOOMANY, argv, posmax,
+                            argv[posmax], NULL, argc - posmax);
+        }
+    }
+
+    /* Call each given option's after() procedure now that all options have
+     * been processed and the command line syntax has been verified.  Those
+     * declared to be independent (i.e., with a non-zero afterphase) are
+     * called concurrently once all the others have been called.
+     */
+    for (o = options_head; o; o = o->next) {
+        if (o->afterphase > 0)
+            continue;
+
+        rc = o->after(o);
+        if (rc) {
+            if (rc > 0)
+                return clp_fail(clp, rc, CLP_ERR_CALLBACK, argv, -1,
+                                NULL, o, 0);
+            return 0;
+        }
+    }
+
+    rc = clp_after_options(clp, options_head, argv);
+    if (rc)
+        return (rc > 0) ? rc : 0;
+
+    if (paramv) {
+        struct clp_posparam *param;
+        int i;
+
+        /* Distribute the remaining arguments to the positional parameters
+         * using a greedy approach.
+         */
+        for (param = paramv; param->name; ++param) {
+            param->clp = clp;
+            param->argc = 0;
+            param->argv = NULL;
+            param->streamc = 0;
+        }
+
+        for (param = paramv; param->name && argc > 0; ++param) {
+            param->argv = argv;
+            param->argc = 0;
+
+            if (param->posmin == 1) {
+                param->argc = 1;
+                if (param->posmax > 1) {
+                    param->argc += argc - posmin;
+                }
+                --posmin;
+            }
+            else if (argc > posmin) {
+                if (param->posmax > 1) {
+                    param->argc = argc - posmin;
+                } else {
+                    param->argc = 1;
+                }
+            }
+
+            clp_dprint(1, "argc=%d posmin=%d argv=%s param=%s %d,%d,%d\n",
+                       argc, posmin, *argv, param->name, param->posmin,
+                       param->posmax, param->argc);
+
+            argv += param->argc;
+            argc -= param->argc;
+
+            if (clp_subcmd(param))
+                break;
+        }
+
+        if (argc > 0) {
+            clp_dprint(1, "args left over: argc=%d posmin=%d argv=%s\n",
+                       argc, posmin, *argv);
+        }
+
+        /* Call each parameter's convert() procedure for each given argument.
+         */
+        for (param = paramv; param->name; ++param) {
+            if (param->cvtdst && param->argc > 0)
+                clp_value_reset(param->cvtfunc, param->cvtdst);
+
+            if (clp_pcvt_eligible(clp, param)) {
+                bool done;
+
+                rc = clp_pcvt(clp, param, &done);
+                if (rc)
+                    return (rc > 0) ? rc : 0;
+                if (done)
+                    continue;
+            }
+
+            for (i = 0; i < param->argc; ++i) {
+                if (param->walk && !param->cvtsubcmd) {
+                    rc = clp_walk(clp, param, param->argv, i);
+                    if (rc)
+                        return (rc > 0) ? rc : 0;
+                    continue;
+                }
+
+                if (param->rspfile && param->argv[i][0] == '@' &&
+                    param->argv[i][1] && !param->cvtsubcmd) {
+                    rc = clp_rsp_stream(clp, param, param->argv, i);
+                    if (rc)
+                        return (rc > 0) ? rc : 0;
+                    continue;
+                }
+
+                if (param->stream && 0 == strcmp(param->argv[i], "-") &&
+                    !param->cvtsubcmd) {
+                    rc = clp_stdin_stream(clp, param, param->argv, i);
+                    if (rc)
+                        return (rc > 0) ? rc : 0;
+                    continue;
+                }
+
+                if (param->cvtfunc) {
+                    rc = clp_convert(clp, param->cvtfunc, param->argv[i], param->cvtflags,
+                                     param->cvtparms, param->cvtdst,
+                                     param->cvtsubcmd ? sizeof(void *) : param->cvtdstsz);
+                    if (rc) {
+                        int kind = CLP_ERR_CONVERT;
+                        int nmatch = 0;
+
+                        if (rc < 0)
+                            return 0;
+
+                        if (param->cvtfunc == clp_cvt_subcmd) {
+                            clp_subcmd_match(clp, param->cvtparms, param->argv[i], &nmatch);
+                            kind = CLP_ERR_SUBCMD;
+                        }
+
+                        return clp_fail(clp, rc, kind, param->argv, i,
+                                        param->argv[i], NULL, nmatch);
+                    }
+                }
+
+                /* Rather than recurse into clp_parsev() via the subcommand's
+                 * action, simply continue parsing the remaining arguments
+                 * against the subcommand's level.
+                 */
+                if (param->action == clp_action_subcmd && param->cvtsubcmd) {
+                    struct clp_level *child = clp_level_child(clp, param);
+
+                    if (child) {
+                        if (!clp->table)
+                            clp_level_destroy(clp->level);
+
+                        clp->level = child;
+                        argc = param->argc;
+                        argv = param->argv;
+                        goto enter;
+                    }
+                }
+
+                if (param->action) {
+                    rc = param->action(param);
+                    if (rc) {
+                        if (rc > 0)
+                            return clp_fail(clp, rc, CLP_ERR_CALLBACK, param->argv, i,
+                                            param->argv[i], NULL, 0);
+                        return 0;
+                    }
+                }
+            }
+
+            /* A streaming parameter given no arguments reads them from stdin.
+             */
+            if (param->stream && param->argc == 0 && param->posmax > 1) {
+                rc = clp_stdin_stream(clp, param, clp->argv, -1);
+                if (rc)
+                    return (rc > 0) ? rc : 0;
+            }
+        }
+
+        /* Call each filled parameter's after() procedure, and then those
+         * declared to be independent concurrently.
+         */
+        for (param = paramv; param->name; ++param) {
+            if (param->after && (param->argc > 0 || param->streamc > 0) &&
+                param->afterphase <= 0) {
+                rc = param->after(param);
+                if (rc) {
+                    if (rc > 0 && param->argc == 0)
+                        return clp_fail(clp, rc, CLP_ERR_CALLBACK, clp->argv, -1,
+                                        NULL, NULL, 0);
+                    if (rc > 0)
+                        return clp_fail(clp, rc, CLP_ERR_CALLBACK, param->argv, 0,
+                                        param->argv[0], NULL, 0);
+                    return 0;
+                }
+            }
+        }
+
+        rc = clp_after_params(clp, paramv);
+        if (rc)
+            return (rc > 0) ? rc : 0;
+    }
+
+    return 0;
+}
+
+/* The completion handle of a pending command (see clp_async_pend()).
+ * The handle is freed by whichever of clp_async_complete() and its
+ * collector (the parse that waits for it, or clp_asyncq_reap()) is last
+ * to be done with it.
+ */
+struct clp_async {
+    pthread_mutex_t      mtx;
+    pthread_cond_t       cv;
+    struct clp_asyncq   *q;             // Queue to post to on completion
+    void                *arg;           // Caller's token for the command
+    int                  code;          // Exit code of the command
+    bool                 done;
+    int                  stdiov[3];     // The command's stdio when it pended
+    struct clp_async    *next;          // Completion queue linkage
+};
+
+/* A queue of completed commands, which is readable via a pipe so that
+ * a command loop may wait for completions in poll(2) along with its
+ * other events.
+ */
+struct clp_asyncq {
+    pthread_mutex_t      mtx;
+    struct clp_async    *head;
+    struct clp_async   **tail;
+    int                  pipev[2];
+};
+
+/* Called from an action() or after() callback to make the command being
+ * parsed complete asynchronously, returns the command's completion
+ * handle.  The callback hands the handle off to whatever will do the
+ * work (e.g., a worker thread or an event loop) and then returns
+ * CLP_PENDING, which ends the parse.  The work is finished by calling
+ * clp_async_complete() (from any thread) with the command's exit code.
+ *
+ * If the command was parsed by clp_table_parsev_async() the parse
+ * returns CLP_PENDING, and the exit code is collected later from the
+ * completion queue.  Otherwise, the parse waits for the handle to
+ * complete and returns its exit code.
+ *
+ * The handle retains duplicates of the command's stdin, stdout, and
+ * stderr as they were when it pended (see clp_async_fd()).
+ *
+ * A command cannot pend from an after() callback that runs concurrently
+ * with others (see afterphase), as its parse would otherwise have more
+ * than one handle to wait for.
+ *
+ * Returns nil (with errno set) on error.
+ */
+struct clp_async *
+clp_async_pend(struct clp *clp)
+{
+    struct clp_async *async;
+
+    if (!clp) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (clp->concurrent) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    if (clp->async)
+        return clp->async;
+
+    async = calloc(1, sizeof(*async));
+    if (!async)
+        return NULL;
+
+    pthread_mutex_init(&async->mtx, NULL);
+    pthread_cond_init(&async->cv, NULL);
+
+    for (int i = 0; i < 3; ++i)
+        async->stdiov[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
+
+    clp->async = async;
+
+    return async;
+}
+
+/* Return the file descriptor to which a pending command should direct
+ * what it would otherwise write to (or read from) the given standard
+ * descriptor (0, 1, or 2).  These remain valid until the command is
+ * completed, and are of interest chiefly to commands served by
+ * clp_serve(), whose stdio is that of the client only until the parse
+ * returns.
+ */
+int
+clp_async_fd(const struct clp_async *async, int fd)
+{
+    if (async && fd >= 0 && fd < 3 && async->stdiov[fd] != -1)
+        return async->stdiov[fd];
+
+    return fd;
+}
+
+static void
+clp_async_free(struct clp_async *async)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (async->stdiov[i] != -1)
+            close(async->stdiov[i]);
+    }
+
+    pthread_cond_destroy(&async->cv);
+    pthread_mutex_destroy(&async->mtx);
+    free(async);
+}
+
+static void
+clp_asyncq_post(struct clp_asyncq *q, struct clp_async *async)
+{
+    char c = 0;
+
+    pthread_mutex_lock(&q->mtx);
+    async->next = NULL;
+    *q->tail = async;
+    q->tail = &async->next;
+    pthread_mutex_unlock(&q->mtx);
+
+    /* If the pipe is full then it is already readable.
+     */
+    if (write(q->pipev[1], &c, 1)) {
+        // ignore
+    }
+}
+
+/* Complete a pending command with the given exit code.  The handle must
+ * not be used again by the caller.
+ */
+void
+clp_async_complete(struct clp_async *async, int code)
+{
+    struct clp_asyncq *q;
+
+    if (!async)
+        return;
+
+    pthread_mutex_lock(&async->mtx);
+    async->code = code;
+    async->done = true;
+    q = async->q;
+    if (!q)
+        pthread_cond_signal(&async->cv);
+    pthread_mutex_unlock(&async->mtx);
+
+    /* Once posted the handle belongs to the reaper.
+     */
+    if (q)
+        clp_asyncq_post(q, async);
+}
+
+/* Collect the pending command (if any) of the given parse, which ended
+ * with the given exit code.  If q is not nil and the parse succeeded then
+ * the handle is bound to q and CLP_PENDING is returned.  Otherwise we wait
+ * for it to complete and return its exit code, unless the parse itself
+ * failed (in which case the parse's exit code is returned, as the handle
+ * may still refer to argv[] and the caller must learn of the failure).
+ */
+static int
+clp_async_collect(struct clp *clp, int rc, struct clp_asyncq *q, void *arg)
+{
+    struct clp_async *async = clp->async;
+    bool done;
+    int code;
+
+    if (!async)
+        return rc;
+
+    clp->async = NULL;
+
+    pthread_mutex_lock(&async->mtx);
+    if (q && rc == 0) {
+        async->q = q;
+        async->arg = arg;
+        done = async->done;
+        pthread_mutex_unlock(&async->mtx);
+
+        /* The command completed before it could be bound to q.
+         */
+        if (done)
+            clp_asyncq_post(q, async);
+
+        return CLP_PENDING;
+    }
+
+    while (!async->done)
+        pthread_cond_wait(&async->cv, &async->mtx);
+    code = async->code;
+    pthread_mutex_unlock(&async->mtx);
+
+    clp_async_free(async);
+
+    return rc ? rc : code;
+}
+
+/* Create a completion queue for clp_table_parsev_async().
+ */
+int
+clp_asyncq_create(struct clp_asyncq **qp)
+{
+    struct clp_asyncq *q;
+
+    if (!qp) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    q = calloc(1, sizeof(*q));
+    if (!q) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    if (pipe(q->pipev)) {
+        free(q);
+        return EX_OSERR;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        fcntl(q->pipev[i], F_SETFD, FD_CLOEXEC);
+        fcntl(q->pipev[i], F_SETFL, O_NONBLOCK);
+    }
+
+    pthread_mutex_init(&q->mtx, NULL);
+    q->tail = &q->head;
+
+    *qp = q;
+
+    return 0;
+}
+
+/* Destroy a completion queue.  The caller must first reap all the
+ * commands pending on it.
+ */
+void
+clp_asyncq_destroy(struct clp_asyncq *q)
+{
+    if (!q)
+        return;
+
+    while (q->head) {
+        struct clp_async *async = q->head;
+
+        q->head = async->next;
+        clp_async_free(async);
+    }
+
+    close(q->pipev[0]);
+    close(q->pipev[1]);
+    pthread_mutex_destroy(&q->mtx);
+    free(q);
+}
+
+/* Return a file descriptor that is readable whenever there are completed
+ * commands to reap.
+ */
+int
+clp_asyncq_fd(const struct clp_asyncq *q)
+{
+    return q ? q->pipev[0] : -1;
+}
+
+/* Reap the next completed command of the queue, returning its exit code
+ * via *codep and the token given to clp_table_parsev_async() via *argp.
+ * Returns false if there are no completed commands (it does not wait).
+ */
+bool
+clp_asyncq_reap(struct clp_asyncq *q, int *codep, void **argp)
+{
+    struct clp_async *async;
+    char buf[64];
+
+    if (!q)
+        return false;
+
+    pthread_mutex_lock(&q->mtx);
+    async = q->head;
+    if (async) {
+        q->head = async->next;
+        if (!q->head)
+            q->tail = &q->head;
+    } else {
+        while (read(q->pipev[0], buf, sizeof(buf)) > 0)
+            continue;
+    }
+    pthread_mutex_unlock(&q->mtx);
+
+    if (!async)
+        return false;
+
+    if (codep)
+        *codep = async->code;
+    if (argp)
+        *argp = async->arg;
+
+    clp_async_free(async);
+
+    return true;
+}
+
+#ifdef CLP_DEBUG
+static void
+clp_debug_init(void)
+{
+    char *env = getenv("CLP_DEBUG");
+
+    if (env) {
+        clp_debug = strtol(env, NULL, 0);
+    }
+}
+#else
+#define clp_debug_init()    do { } while (0)
+#endif /* CLP_DEBUG */
+
+static int clp_breakwords(const char *src, char *dst, const char *delim, char **argv, bool seq);
+
+/* Lines shorter than CLP_PARSEL_STACKMAX bytes are broken into words
+ * on the stack by clp_parsel() and clp_table_parsel().
+ */
+#define CLP_PARSEL_STACKMAX     (512)
+
+/* Break line into words and parse them against the given table, or
+ * against the given option and posparam vectors if table is nil.
+ *
+ * Short lines (the common case) are broken into words in a single pass
+ * via clp_breakwords() into a word vector and buffer on the stack, each
+ * sized by the length of the line, thereby avoiding both the counting
+ * pass and the allocation of clp_breakargs().  The words are then still
+ * cache hot when they are scanned and handed to their converters.
+ */
+static int
+clp_parsel_impl(struct clp_table *table, const char *line, const char *delim,
+                struct clp_option *optionv, struct clp_posparam *paramv)
+{
+    char **argv;
+    size_t len;
+    int argc;
+    int rc;
+
+    len = line ? strnlen(line, CLP_PARSEL_STACKMAX) : CLP_PARSEL_STACKMAX;
+
+    if (len < CLP_PARSEL_STACKMAX) {
+        char *wordv[len + 2];
+        char buf[len + 1];
+
+        argc = clp_breakwords(line, buf, delim, wordv, false);
+        if (argc < 0) {
+            errno = EBADMSG;
+            return EX_DATAERR;
+        }
+
+        wordv[argc] = NULL;
+
+        if (table)
+            return clp_table_parsev(table, argc, wordv);
+
+        return clp_parsev(argc, wordv, optionv, paramv);
+    }
+
+    rc = clp_breakargs(line, delim, &argc, &argv);
+    if (rc)
+        return rc;
+
+    if (table)
+        rc = clp_table_parsev(table, argc, argv);
+    else
+        rc = clp_parsev(argc, argv, optionv, paramv);
+
+    free(argv);
+
+    return rc;
+}
+
+/* Like clp_parsev(), but takes a string instead of a vector, which is
+ * broken into words as per clp_breakargs() given delim.
+ */
+int
+clp_parsel(const char *line, const char *delim,
+           struct clp_option *optionv,
+           struct clp_posparam *paramv)
+{
+    return clp_parsel_impl(NULL, line, delim, optionv, paramv);
+}
+
+/* Parse a vector of strings as specified by the given option
+ * and parameter vectors (either or both of which may be nil).
+ *
+ * On error, returns a suggested exit code from sysexits.h.
+ */
+int
+clp_parsev(int argc, char **argv,
+           struct clp_option *optionv,
+           struct clp_posparam *paramv)
+{
+    struct clp_error err;
+    struct clp clp;
+    int rc;
+
+    clp_debug_init();
+
+    if (argc < 1 || !argv)
+        return 0;
+
+    memset(&clp, 0, sizeof(clp));
+    clp.argv = argv;
+    clp.error = &err;
+    err.kind = CLP_ERR_NONE;
+
+    rc = clp_level_create(optionv, paramv, &clp.level);
+    if (rc)
+        return rc;
+
+    rc = clp_parsev_impl(&clp, argc, argv);
+    rc = clp_async_collect(&clp, rc, NULL, NULL);
+
+    if (rc && err.kind != CLP_ERR_NONE) {
+        clp_error_format(&err, clp.errbuf, sizeof(clp.errbuf));
+        if (clp.errbuf[0])
+            fprintf(stderr, "%s: %s\n", err.basename, clp.errbuf);
+    }
+
+    optind = clp.optind;
+
+    clp_level_destroy(clp.level);
+
+    return rc;
+}
+
+/* Find or create the level for the given option and posparam vectors,
+ * and then recursively do the same for all of its subcommands.  Levels
+ * are shared by all subcommands with the same vectors, which bounds
+ * the recursion of self-referential subcommand trees.
+ */
+static int
+clp_table_level(struct clp_table *table,
+                struct clp_option *optionv, struct clp_posparam *paramv,
+                struct clp_level **lvlp)
+{
+    struct clp_level *lvl;
+    int rc;
+
+    for (lvl = table->levels; lvl; lvl = lvl->next) {
+        if (lvl->optionv == optionv && lvl->paramv == paramv) {
+            *lvlp = lvl;
+            return 0;
+        }
+    }
+
+    rc = clp_level_create(optionv, paramv, &lvl);
+    if (rc)
+        return rc;
+
+    lvl->next = table->levels;
+    table->levels = lvl;
+    *lvlp = lvl;
+
+    for (int i = 0; i < lvl->subidxc; ++i) {
+        struct clp_subidx *idx = lvl->subidxv + i;
+
+        for (int j = 0; j < idx->subc; ++j) {
+            struct clp_subcmd *subcmd = idx->subcmdv + j;
+
+            rc = clp_table_level(table, subcmd->optionv, subcmd->posparamv,
+                                 idx->levelv + j);
+            if (rc)
+                return rc;
+        }
+    }
+
+    return 0;
+}
+
+/* Create the initial (empty) generation of the given level's option
+ * values, recording the default value of each option whose size is
+ * known so that clp_table_reload() can restore it.
+ */
+static int
+clp_gen_create(const struct clp_level *lvl, struct clp_gen **genp)
+{
+    size_t optionc = lvl->optionc;
+    size_t sz, valsz = 0;
+    struct clp_gen *gen;
+    char *pc;
+
+    for (size_t i = 0; i < optionc; ++i)
+        valsz += roundup(lvl->optionv[i].cvtdstsz, 16);
+
+    sz = roundup(sizeof(*gen), 16);
+    sz += valsz * 2;
+    sz += (sizeof(*gen->textv) + sizeof(*gen->holdv)) * optionc;
+    sz += (sizeof(*gen->givenv) + sizeof(*gen->offv)) * optionc;
+
+    gen = calloc(1, sz);
+    if (!gen) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    pc = (char *)gen + roundup(sizeof(*gen), 16);
+    gen->valsz = valsz;
+    gen->dfltv = (void *)pc;
+    pc += valsz;
+    gen->stagev = (void *)pc;
+    pc += valsz;
+    gen->textv = (void *)pc;
+    pc += sizeof(*gen->textv) * optionc;
+    gen->holdv = (void *)pc;
+    pc += sizeof(*gen->holdv) * optionc;
+    gen->offv = (void *)pc;
+    pc += sizeof(*gen->offv) * optionc;
+    gen->givenv = (void *)pc;
+
+    for (size_t i = 0, off = 0; i < optionc; ++i) {
+        const struct clp_option *o = lvl->optionv + i;
+
+        gen->offv[i] = off;
+        if (o->cvtdst && o->cvtdstsz > 0)
+            memcpy(gen->dfltv + off, o->cvtdst, o->cvtdstsz);
+        off += roundup(o->cvtdstsz, 16);
+    }
+
+    *genp = gen;
+
+    return 0;
+}
+
+/* Compile the given option and posparam vectors, along with the vectors
+ * of all reachable subcommands, into a table that may then be given to
+ * clp_table_parsev() or clp_table_parsel() any number of times.
+ *
+ * The table refers to (and does not copy) the given vectors, so they
+ * must outlive the table.  The table must be destroyed and recreated
+ * if any of the vectors are subsequently modified.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_create(struct clp_option *optionv, struct clp_posparam *paramv,
+                 struct clp_table **tablep)
+{
+    struct clp_table *table;
+    int rc;
+
+    if (!tablep) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    *tablep = NULL;
+
+    table = calloc(1, sizeof(*table));
+    if (!table) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    table->watchfd = -1;
+
+    rc = clp_table_level(table, optionv, paramv, &table->root);
+    if (!rc)
+        rc = clp_gen_create(table->root, &table->gen);
+    if (rc) {
+        clp_table_destroy(table);
+        return rc;
+    }
+
+    *tablep = table;
+
+    return 0;
+}
+
+void
+clp_table_destroy(struct clp_table *table)
+{
+    struct clp_level *lvl;
+
+    if (!table)
+        return;
+
+    clp_snap_release(table->snap);
+
+    if (table->watchfd != -1)
+        close(table->watchfd);
+    free(table->watchname);
+
+    if (table->blob)
+        munmap(table->blob, table->blobsz);
+
+    clp_table_cache(table, 0);
+
+    /* Values still held are owned by the live options (all snapshots
+     * must have been released by now), so free only the holds.
+     */
+    if (table->gen) {
+        for (size_t i = 0; i < table->root->optionc; ++i) {
+            free(table->gen->textv[i]);
+            free(table->gen->holdv[i]);
+        }
+        free(table->gen);
+    }
+
+    while (( lvl = table->levels )) {
+        table->levels = lvl->next;
+        clp_level_destroy(lvl);
+    }
+
+    free(table);
+}
+
+static int clp_table_parse(struct clp_table *table, int argc, char **argv,
+                           struct clp_error *err, struct clp_cvtlog *log,
+                           struct clp_asyncq *q, void *arg);
+
+static int
+clp_table_parsev_log(struct clp_table *table, int argc, char **argv,
+                     struct clp_cvtlog *log)
+{
+    struct clp_error err;
+    char errbuf[CLP_ERRBUF_MAX];
+    int rc;
+
+    rc = clp_table_parse(table, argc, argv, &err, log, NULL, NULL);
+
+    if (rc && err.kind != CLP_ERR_NONE) {
+        clp_error_format(&err, errbuf, sizeof(errbuf));
+        if (errbuf[0])
+            fprintf(stderr, "%s: %s\n", err.basename, errbuf);
+    }
+
+    return rc;
+}
+
+/* Like clp_parsev(), but parses argv[] against a compiled table.
+ */
+int
+clp_table_parsev(struct clp_table *table, int argc, char **argv)
+{
+    return clp_table_parsev_log(table, argc, argv, NULL);
+}
+
+int
+clp_table_parsev_error(struct clp_table *table, int argc, char **argv,
+                       struct clp_error *err)
+{
+    return clp_table_parse(table, argc, argv, err, NULL, NULL, NULL);
+}
+
+/* Like clp_table_parsev(), but a command whose callback pends (see
+ * clp_async_pend()) does not wait to complete.  Instead, CLP_PENDING is
+ * returned and the command's exit code is later reaped from q along with
+ * the given token arg.  argv[] must remain valid until the command has
+ * completed.
+ */
+int
+clp_table_parsev_async(struct clp_table *table, int argc, char **argv,
+                       struct clp_asyncq *q, void *arg)
+{
+    struct clp_error err;
+    char errbuf[CLP_ERRBUF_MAX];
+    int rc;
+
+    if (!q) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    rc = clp_table_parse(table, argc, argv, &err, NULL, q, arg);
+
+    if (rc > 0 && err.kind != CLP_ERR_NONE) {
+        clp_error_format(&err, errbuf, sizeof(errbuf));
+        if (errbuf[0])
+            fprintf(stderr, "%s: %s\n", err.basename, errbuf);
+    }
+
+    return rc;
+}
+
+static int
+clp_table_parse(struct clp_table *table, int argc, char **argv,
+                struct clp_error *err, struct clp_cvtlog *log,
+                struct clp_asyncq *q, void *arg)
+{
+    struct clp clp;
+    int rc;
+
+    clp_debug_init();
+
+    if (!table || !err) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    err->code = 0;
+    err->kind = CLP_ERR_NONE;
+
+    if (argc < 1 || !argv)
+        return 0;
+
+    memset(&clp, 0, sizeof(clp));
+    clp.table = table;
+    clp.level = table->root;
+    clp.argv = argv;
+    clp.error = err;
+    clp.cvtlog = log;
+
+    /* Unlike clp_parsev(), the global optind is not set, as tables may
+     * be parsed concurrently (e.g., by clp_batch()).
+     */
+    rc = clp_parsev_impl(&clp, argc, argv);
+    rc = clp_async_collect(&clp, rc, q, arg);
+
+    return rc;
+}
+
+/* An entry of a table's parse cache, which holds the words of a line
+ * and the conversion log of its last successful parse.  Each entry is
+ * a single allocation, and the most recently used entry is at the head
+ * of the LRU list.
+ */
+struct clp_cacheent {
+    struct clp_cacheent *hnext;         // Hash chain linkage
+    struct clp_cacheent *prev;          // LRU list linkage
+    struct clp_cacheent *next;
+    uint64_t             hash;
+    const char          *line;
+    const char          *delim;         // Copy of delim (nil if none)
+    const char          *words;         // argc NUL terminated words
+    size_t               wordsz;
+    int                  argc;
+    size_t               logsz;
+    unsigned char       *log;
+};
+
+struct clp_cache {
+    struct clp_cacheent **bktv;
+    size_t               bktmask;
+    size_t               entc;
+    size_t               entmax;
+    struct clp_cacheent  lru;
+    unsigned long        hits;
+    unsigned long        misses;
+};
+
+static uint64_t
+clp_cache_hash(const char *line, const char *delim)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (const char *pc = line; *pc; ++pc)
+        hash = (hash ^ (unsigned char)*pc) * 1099511628211ull;
+
+    hash = (hash ^ (delim ? 0x100 : 0x200)) * 1099511628211ull;
+
+    for (const char *pc = delim; pc && *pc; ++pc)
+        hash = (hash ^ (unsigned char)*pc) * 1099511628211ull;
+
+    return hash;
+}
+
+static void
+clp_cache_unlink(struct clp_cacheent *ent)
+{
+    ent->prev->next = ent->next;
+    ent->next->prev = ent->prev;
+}
+
+static void
+clp_cache_push(struct clp_cache *cache, struct clp_cacheent *ent)
+{
+    ent->prev = &cache->lru;
+    ent->next = cache->lru.next;
+    ent->next->prev = ent;
+    cache->lru.next = ent;
+}
+
+/* Discard all the entries of the given cache (but not the cache itself).
+ */
+static void
+clp_cache_flush(struct clp_cache *cache)
+{
+    while (cache->lru.next != &cache->lru) {
+        struct clp_cacheent *ent = cache->lru.next;
+
+        clp_cache_unlink(ent);
+        free(ent);
+    }
+
+    memset(cache->bktv, 0, sizeof(*cache->bktv) * (cache->bktmask + 1));
+    cache->entc = 0;
+}
+
+static struct clp_cacheent *
+clp_cache_find(struct clp_cache *cache, uint64_t hash,
+               const char *line, const char *delim)
+{
+    struct clp_cacheent *ent;
+
+    for (ent = cache->bktv[hash & cache->bktmask]; ent; ent = ent->hnext) {
+        if (ent->hash != hash || strcmp(ent->line, line))
+            continue;
+        if ((ent->delim && delim) ? strcmp(ent->delim, delim) : (ent->delim != delim))
+            continue;
+
+        return ent;
+    }
+
+    return NULL;
+}
+
+/* Add the given line, its words, and the conversion log of its parse
+ * to the cache, evicting the least recently used entry if the cache
+ * is full.  Failure to allocate is not an error.
+ */
+static void
+clp_cache_insert(struct clp_cache *cache, uint64_t hash, const char *line,
+                 const char *delim, int argc, char **argv, const struct clp_cvtlog *log)
+{
+    struct clp_cacheent *ent, **entp;
+    size_t linesz, delimsz, wordsz;
+    char *pc;
+
+    if (cache->entc >= cache->entmax) {
+        ent = cache->lru.prev;
+
+        for (entp = &cache->bktv[ent->hash & cache->bktmask]; *entp != ent; )
+            entp = &(*entp)->hnext;
+        *entp = ent->hnext;
+
+        clp_cache_unlink(ent);
+        --cache->entc;
+        free(ent);
+    }
+
+    linesz = strlen(line) + 1;
+    delimsz = delim ? strlen(delim) + 1 : 0;
+    wordsz = 0;
+
+    for (int i = 0; i < argc; ++i)
+        wordsz += strlen(argv[i]) + 1;
+
+    ent = malloc(roundup(sizeof(*ent), 16) + log->len + linesz + delimsz + wordsz);
+    if (!ent)
+        return;
+
+    pc = (char *)ent + roundup(sizeof(*ent), 16);
+    ent->log = (void *)pc;
+    ent->logsz = log->len;
+    if (log->len > 0)
+        memcpy(pc, log->buf, log->len);
+    pc += log->len;
+
+    ent->line = memcpy(pc, line, linesz);
+    pc += linesz;
+
+    ent->delim = delim ? memcpy(pc, delim, delimsz) : NULL;
+    pc += delimsz;
+
+    ent->words = pc;
+    ent->wordsz = wordsz;
+    ent->argc = argc;
+
+    for (int i = 0; i < argc; ++i)
+        pc = stpcpy(pc, argv[i]) + 1;
+
+    ent->hash = hash;
+    ent->hnext = cache->bktv[hash & cache->bktmask];
+    cache->bktv[hash & cache->bktmask] = ent;
+
+    clp_cache_push(cache, ent);
+    ++cache->entc;
+}
+
+/* Parse line against the table via its cache.  On a hit the words of
+ * the line are copied from the cache (rather than tokenized), and the
+ * results of the recorded conversions are copied into the option and
+ * posparam variables (rather than reconverted), while the parse itself
+ * proceeds as usual (i.e., options are scanned, excludes are checked,
+ * and all callbacks are called).  On a miss the line is tokenized and
+ * parsed while recording its conversions, and the results are cached
+ * if the parse succeeds and had no side effects (see clp_convert()).
+ */
+static int
+clp_cache_parsel(struct clp_table *table, const char *line, const char *delim)
+{
+    struct clp_cache *cache = table->cache;
+    struct clp_cacheent *ent;
+    struct clp_cvtlog log;
+    uint64_t hash;
+    char **argv;
+    int argc;
+    int rc;
+
+    memset(&log, 0, sizeof(log));
+
+    hash = clp_cache_hash(line, delim);
+
+    ent = clp_cache_find(cache, hash, line, delim);
+    if (ent) {
+        const char *src = ent->words;
+        char *pc;
+
+        ++cache->hits;
+        clp_cache_unlink(ent);
+        clp_cache_push(cache, ent);
+
+        /* Callbacks may modify the words, so give them a copy.
+         */
+        argc = ent->argc;
+        argv = malloc(sizeof(*argv) * (argc + 1) + ent->wordsz);
+        if (!argv) {
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        pc = memcpy(argv + argc + 1, src, ent->wordsz);
+
+        for (int i = 0; i < argc; ++i) {
+            argv[i] = pc;
+            pc += strlen(pc) + 1;
+        }
+
+        argv[argc] = NULL;
+
+        log.buf = ent->log;
+        log.len = ent->logsz;
+        log.replay = true;
+
+        rc = clp_table_parsev_log(table, argc, argv, &log);
+
+        free(argv);
+
+        return rc;
+    }
+
+    ++cache->misses;
+
+    rc = clp_breakargs(line, delim, &argc, &argv);
+    if (rc)
+        return rc;
+
+    log.record = true;
+
+    rc = clp_table_parsev_log(table, argc, argv, &log);
+
+    if (!rc && !log.uncacheable)
+        clp_cache_insert(cache, hash, line, delim, argc, argv, &log);
+
+    free(log.buf);
+    free(argv);
+
+    return rc;
+}
+
+/* Enable a cache of the results of parsing up to nentries distinct lines
+ * via clp_table_parsel(), so that lines given repeatedly (e.g., commands
+ * sent by monitoring agents) need not be tokenized or converted anew.
+ * The cache is keyed by a hash of the line (and delim), and the least
+ * recently used entry is evicted when the cache is full.  Lines whose
+ * parse converts an argument via a converter with side effects (e.g.,
+ * open or fopen) are never cached, and the results of only clp's own
+ * pure converters are replayed (custom converters are run anew).
+ *
+ * Calling clp_table_cache() again discards all cached entries, and if
+ * nentries is zero then the cache is disabled.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_cache(struct clp_table *table, size_t nentries)
+{
+    struct clp_cache *cache;
+    size_t bktc;
+
+    if (!table) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    cache = table->cache;
+    if (cache) {
+        clp_cache_flush(cache);
+        free(cache->bktv);
+        free(cache);
+        table->cache = NULL;
+    }
+
+    if (nentries == 0)
+        return 0;
+
+    for (bktc = 16; bktc < nentries; bktc *= 2)
+        continue;
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache)
+        cache->bktv = calloc(bktc, sizeof(*cache->bktv));
+    if (!cache || !cache->bktv) {
+        free(cache);
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    cache->bktmask = bktc - 1;
+    cache->entmax = nentries;
+    cache->lru.next = cache->lru.prev = &cache->lru;
+    table->cache = cache;
+
+    return 0;
+}
+
+void
+clp_table_cache_stats(struct clp_table *table, unsigned long *hitsp, unsigned long *missesp)
+{
+    struct clp_cache *cache = table ? table->cache : NULL;
+
+    if (hitsp)
+        *hitsp = cache ? cache->hits : 0;
+    if (missesp)
+        *missesp = cache ? cache->misses : 0;
+}
+
+/* Like clp_parsel(), but parses line against a compiled table.
+ */
+int
+clp_table_parsel(struct clp_table *table, const char *line, const char *delim)
+{
+    if (table && table->cache && line)
+        return clp_cache_parsel(table, line, delim);
+
+    if (!table) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    return clp_parsel_impl(table, line, delim, NULL, NULL);
+}
+
+/* Command separators stored in argv[] by clp_breakwords() (they are
+ * recognized by address, so a quoted ";" is just another word).
+ */
+static const char clp_seq_semi[] = ";";
+static const char clp_seq_and[] = "&&";
+
+/* Execute the sequence of commands in line against the given table.
+ * Commands are separated by ';' or "&&", where a command that follows
+ * "&&" is executed only if the preceding command succeeded (as per the
+ * shell).  Separators within quotes or escaped by a backslash are just
+ * ordinary characters, and empty commands are skipped.  If progname is
+ * not nil it is given as argv[0] of each command, otherwise the first
+ * word of each command is argv[0].
+ *
+ * The line is broken into words just once, and each command is parsed
+ * from its slice of the resulting vector, whose separators are replaced
+ * in turn by the nil terminator of the preceding command and argv[0] of
+ * the following command.  Hence neither words nor vectors are copied,
+ * and there are no allocations at all for short lines.
+ *
+ * Returns the exit code of the last command executed, whose ordinal
+ * within line (counting from one) is returned via *cmdnop (if not nil).
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_parseseq(struct clp_table *table, const char *line, const char *delim,
+                   const char *progname, int *cmdnop)
+{
+    const char *sep = clp_seq_semi;
+    char **argv, **heap = NULL;
+    size_t len, argvmax;
+    int wordc, cmdno;
+    char *buf;
+    int rc = 0;
+
+    if (cmdnop)
+        *cmdnop = 0;
+
+    if (!table || !line) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    /* Every byte of line yields at most one word and one separator,
+     * and argv[0] is reserved for progname.
+     */
+    len = strlen(line);
+    argvmax = len * 2 + 4;
+
+    char *stackv[len < CLP_PARSEL_STACKMAX ? argvmax : 1];
+    char stackbuf[len < CLP_PARSEL_STACKMAX ? len + 1 : 1];
+
+    argv = stackv;
+    buf = stackbuf;
+
+    if (len >= CLP_PARSEL_STACKMAX) {
+        heap = malloc(sizeof(*argv) * argvmax + len + 1);
+        if (!heap) {
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        argv = heap;
+        buf = (char *)(argv + argvmax);
+    }
+
+    wordc = clp_breakwords(line, buf, delim, argv + 1, true);
+    if (wordc < 0) {
+        free(heap);
+        errno = EBADMSG;
+        return EX_DATAERR;
+    }
+
+    cmdno = 0;
+
+    for (int i = 1, end; i <= wordc; i = end + 1) {
+        const char *next;
+        int n;
+
+        for (end = i; end <= wordc; ++end) {
+            if (argv[end] == clp_seq_semi || argv[end] == clp_seq_and)
+                break;
+        }
+
+        next = (end <= wordc) ? argv[end] : clp_seq_semi;
+        argv[end] = NULL;
+
+        if (end > i) {
+            ++cmdno;
+
+            if (sep == clp_seq_semi || rc == 0) {
+                n = progname ? 1 : 0;
+                argv[i - 1] = (char *)progname;
+
+                rc = clp_table_parsev(table, end - i + n, argv + i - n);
+
+                if (cmdnop)
+                    *cmdnop = cmdno;
+            }
+        }
+
+        sep = next;
+    }
+
+    free(heap);
+
+    return rc;
+}
+
+/* Execute the command script at path by parsing each of its lines
+ * against the given table, stopping at the first error.  Lines are
+ * broken into words in place as per clp_breakargs() (given delim),
+ * and blank lines and comment lines (whose first non-blank character
+ * is '#') are skipped.  If progname is not nil it is given as argv[0]
+ * of each command, otherwise the first word of each line is argv[0].
+ *
+ * The script is mapped privately (or read, if it's not a regular file,
+ * e.g., a pipe) and split into lines via memchr(3),
+ * so there is no limit on line length, and the only allocations are
+ * for an argument vector that grows to fit the longest line.  Errors
+ * are reported to stderr prefixed by the script's path and the line
+ * number, which is also returned via *linenop (if not nil).  Note that
+ * optargs and the argv of posparams refer to the mapping, and hence
+ * are valid only until the command's callbacks return.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_parsefile(struct clp_table *table, const char *path, const char *delim,
+              const char *progname, int *linenop)
+{
+    char *line, *next, *end, *eol, *last = NULL;
+    char **argv = NULL;
+    size_t argvmax = 0;
+    struct clp_error err;
+    struct clp_fload fl;
+    int lineno = 0;
+    int rc = 0, fd;
+
+    if (linenop)
+        *linenop = 0;
+
+    if (!table || !path) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return EX_NOINPUT;
+
+    rc = clp_fload(fd, MADV_SEQUENTIAL, &fl);
+    close(fd);
+
+    if (rc)
+        return EX_IOERR;
+
+    end = fl.end;
+
+    for (line = fl.base; line < end; line = next) {
+        size_t need;
+        int argc, n;
+        char *pc;
+
+        ++lineno;
+
+        eol = memchr(line, '\n', end - line);
+        next = eol ? eol + 1 : end;
+
+        if (eol) {
+            *eol = '\000';
+        } else if (fl.termok) {
+            *end = '\000'; // past EOF (within the last page if mapped)
+            eol = end;
+        } else {
+            last = strndup(line, end - line);
+            if (!last) {
+                rc = EX_OSERR;
+                break;
+            }
+            eol = last + (end - line);
+            line = last;
+        }
+
+        for (pc = line; isspace(*pc); ++pc)
+            continue;
+        if (!*pc || *pc == '#')
+            continue;
+
+        /* Every word consumes at least one byte of the line.
+         */
+        need = (eol - line) + 4;
+        if (need > argvmax) {
+            char **tmp = realloc(argv, sizeof(*argv) * need);
+
+            if (!tmp) {
+                errno = ENOMEM;
+                rc = EX_OSERR;
+                break;
+            }
+
+            argv = tmp;
+            argvmax = need;
+        }
+
+        n = progname ? 1 : 0;
+        argv[0] = (char *)progname;
+
+        argc = clp_breakwords(line, line, delim, argv + n, false);
+        if (argc < 0) {
+            fprintf(stderr, "%s:%d: unterminated quote\n", path, lineno);
+            errno = EBADMSG;
+            rc = EX_DATAERR;
+            break;
+        }
+
+        argc += n;
+        if (argc == 0)
+            continue;
+
+        argv[argc] = NULL;
+
+        rc = clp_table_parsev_error(table, argc, argv, &err);
+        if (rc) {
+            int xerrno = errno;
+
+            if (err.kind != CLP_ERR_NONE) {
+                char msg[CLP_ERRBUF_MAX * 2];
+
+                clp_error_format(&err, msg, sizeof(msg));
+                if (msg[0])
+                    fprintf(stderr, "%s:%d: %s: %s\n", path, lineno, err.basename, msg);
+            }
+
+            errno = xerrno;
+            break;
+        }
+    }
+
+    if (linenop)
+        *linenop = lineno;
+
+    free(argv);
+    free(last);
+    clp_funload(&fl);
+
+    return rc;
+}
+
+/* Return true if the staged value of the given option differs from
+ * its current value.
+ */
+static bool
+clp_value_changed(const struct clp_option *o, const void *staged)
+{
+    if (o->cvtfunc == clp_cvt_string) {
+        const char *l = *(char * const *)staged;
+        const char *r = *(char * const *)o->cvtdst;
+
+        return (l && r) ? strcmp(l, r) : (l != r);
+    }
+
+    if (o->cvtfunc == clp_cvt_list) {
+        const struct clp_list *l = staged, *r = o->cvtdst;
+
+        if (l->argc != r->argc)
+            return true;
+
+        for (size_t i = 0; i < l->argc; ++i) {
+            if (strcmp(l->argv[i], r->argv[i]))
+                return true;
+        }
+
+        return false;
+    }
+
+    if (o->cvtfunc == clp_cvt_kvmap) {
+        const struct clp_kvmap *l = staged, *r = o->cvtdst;
+
+        if (l->entc != r->entc)
+            return true;
+
+        for (size_t i = 0; i < l->entc; ++i) {
+            const struct clp_kvent *le = l->entv + i, *re = r->entv + i;
+
+            if (strcmp(le->key, re->key))
+                return true;
+            if ((le->val && re->val) ? strcmp(le->val, re->val) : (le->val != re->val))
+                return true;
+        }
+
+        return false;
+    }
+
+    return memcmp(staged, o->cvtdst, o->cvtdstsz);
+}
+
+/* Release whatever resources are held by a value produced by the
+ * given converter.
+ */
+static void
+clp_value_release(clp_cvt_cb *cvtfunc, void *val)
+{
+    if (cvtfunc == clp_cvt_string) {
+        free(*(char **)val);
+    } else if (cvtfunc == clp_cvt_open || cvtfunc == clp_cvt_openx) {
+        if (*(int *)val >= 0)
+            close(*(int *)val);
+    } else if (cvtfunc == clp_cvt_fopen || cvtfunc == clp_cvt_fopenx) {
+        if (*(FILE **)val)
+            clp_fclose(*(FILE **)val);
+    } else if (cvtfunc == clp_cvt_mmap) {
+        if (((struct clp_mmap *)val)->fd >= 0)
+            clp_munmap(val);
+    } else if (cvtfunc == clp_cvt_list) {
+        clp_list_free(val);
+    } else if (cvtfunc == clp_cvt_kvmap) {
+        clp_kvmap_free(val);
+    }
+}
+
+/* Return true if values produced by the given converter own resources
+ * that clp_value_release() would release (other than strings, lists and
+ * maps, which snapshots copy), and hence must be held while snapshots
+ * share them.
+ */
+static bool
+clp_value_holdable(clp_cvt_cb *cvtfunc)
+{
+    return (cvtfunc == clp_cvt_open || cvtfunc == clp_cvt_openx ||
+            cvtfunc == clp_cvt_fopen || cvtfunc == clp_cvt_fopenx ||
+            cvtfunc == clp_cvt_mmap);
+}
+
+/* Drop a reference on a hold, releasing the held value with the last.
+ */
+static void
+clp_hold_release(struct clp_hold *hold)
+{
+    if (hold && __atomic_sub_fetch(&hold->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        clp_value_release(hold->cvtfunc, hold->val);
+        free(hold);
+    }
+}
+
+/* Release the current value of the given root option prior to replacing
+ * it.  If the value is held by published snapshots then it is instead
+ * released when the last of them is released.
+ */
+static void
+clp_table_value_release(struct clp_table *table, size_t idx)
+{
+    struct clp_option *o = table->root->optionv + idx;
+    struct clp_hold *hold = table->gen->holdv[idx];
+    bool bound = false;
+
+    table->gen->holdv[idx] = NULL;
+
+    /* The value differs from that held if the option was reassigned
+     * (e.g., by clp_table_parsev()) after it was last published.
+     * Strings bound by clp_table_restore() refer to the blob.
+     */
+    if (o->cvtfunc == clp_cvt_string && table->blob) {
+        const char *str = *(char **)o->cvtdst;
+
+        if (str >= (char *)table->blob && str < (char *)table->blob + table->blobsz)
+            bound = true;
+    }
+
+    if (!bound && (!hold || memcmp(hold->val, o->cvtdst, o->cvtdstsz)))
+        clp_value_release(o->cvtfunc, o->cvtdst);
+
+    clp_hold_release(hold);
+}
+
+/* Return true if the optargs of the occurrences of an option (starting
+ * with occ and linked by nextv[]) match those of the previous reload,
+ * which prev holds one after another.
+ */
+static bool
+clp_reload_same(const char *prev, const char * const *textv, const int *nextv,
+                int occ)
+{
+    for (; occ >= 0; occ = nextv[occ]) {
+        if (!prev || strcmp(prev, textv[occ]))
+            return false;
+        prev += strlen(prev) + 1;
+    }
+
+    return true;
+}
+
+/* Return a copy of the optargs of the occurrences of an option (starting
+ * with occ and linked by nextv[]), one after another.
+ */
+static char *
+clp_reload_join(const char * const *textv, const int *nextv, int occ)
+{
+    size_t sz = 0;
+    char *buf, *pc;
+
+    for (int i = occ; i >= 0; i = nextv[i])
+        sz += strlen(textv[i]) + 1;
+
+    buf = malloc(sz);
+    if (!buf)
+        return NULL;
+
+    for (pc = buf; occ >= 0; occ = nextv[occ])
+        pc = stpcpy(pc, textv[occ]) + 1;
+
+    return buf;
+}
+
+/* Reload the options of the table's root level from argv[] (which may
+ * contain only options), firing the action and after callbacks of only
+ * those options whose values have changed since the previous reload.
+ *
+ * Reloading proceeds in three phases:  First, argv[] is scanned and
+ * checked for errors without modifying any option.  Next, each option
+ * whose optarg text or given count differs from the previous reload is
+ * converted into staging storage and compared with its current value.
+ * Options whose text is unchanged are never converted (e.g., files are
+ * not reopened).  Finally, if all conversions succeed, changed values
+ * are committed (releasing the strings and files of the values they
+ * replace), and the callbacks of changed options are called.  Options
+ * no longer given revert to the values they had when the table was
+ * created.
+ *
+ * Options whose cvtdstsz is zero cannot be staged, and are instead
+ * converted in place during the commit phase.  Options whose converter
+ * accumulates (e.g., lists) are converted from every occurrence, and
+ * have changed if any occurrence has changed.
+ *
+ * If err is nil then errors are printed to stderr as per clp_parsev(),
+ * otherwise they are returned via *err as per clp_table_parsev_error().
+ */
+int
+clp_table_reload(struct clp_table *table, int argc, char **argv,
+                 struct clp_error *err)
+{
+    struct clp_error errlocal;
+    struct clp_level *lvl;
+    struct clp_option *o;
+    struct clp_gen *gen;
+    struct clp clp;
+    size_t optionc;
+    int rc = 0;
+
+    clp_debug_init();
+
+    if (!table || argc < 1 || !argv) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    lvl = table->root;
+    gen = table->gen;
+    optionc = lvl->optionc;
+
+    const char *textv[optionc + 1];
+    char *copyv[optionc + 1];
+    char changedv[optionc + 1];
+    bool stagedv[optionc + 1];
+    int givenv[optionc + 1];
+    int indv[optionc + 1];
+    int firstv[optionc + 1];
+    int lastv[optionc + 1];
+
+    /* The optargs of every occurrence of each accumulating option, from
+     * firstv[] to lastv[] linked by occnextv[].
+     */
+    const char *occtextv[argc + 1];
+    int occnextv[argc + 1];
+    int occc = 0;
+
+    memset(firstv, -1, sizeof(firstv));
+    memset(lastv, -1, sizeof(lastv));
+    memset(textv, 0, sizeof(textv));
+    memset(copyv, 0, sizeof(copyv));
+    memset(changedv, 0, sizeof(changedv));
+    memset(stagedv, 0, sizeof(stagedv));
+    memset(givenv, 0, sizeof(givenv));
+
+    memset(&clp, 0, sizeof(clp));
+    clp.table = table;
+    clp.level = lvl;
+    clp.argv = argv;
+    clp.error = err ? err : &errlocal;
+    clp.error->code = 0;
+    clp.error->kind = CLP_ERR_NONE;
+
+    clp.basename = strrchr(argv[0], '/');
+    clp.basename = (clp.basename ? clp.basename + 1 : argv[0]);
+    clp.optionv = lvl->optionv;
+    clp.paramv = lvl->paramv;
+    clp.optionc = lvl->optionc;
+    clp.opthelp = lvl->opthelp;
+    clp.optind = 1;
+
+    /* Scan and validate the options in argv[].
+     */
+    while (1) {
+        int curind = clp.optind;
+        const char *optarg;
+        int longidx, idx;
+
+        errno = 0;
+
+        idx = clp_scan(&clp, argc, argv, &optarg, &longidx);
+
+        if (idx == CLP_SCAN_END)
+            break;
+
+        if (idx < 0) {
+            rc = clp_fail(&clp, EX_USAGE,
+                          (idx == CLP_SCAN_NOARG) ? CLP_ERR_NOARG : CLP_ERR_OPTION,
+                          argv, curind, argv[curind], NULL, 0);
+            clp.error->optopt = clp.optopt;
+            goto errout;
+        }
+
+        o = lvl->optionv + idx;
+        o->longidx = longidx;
+
+        for (size_t j = 0; j < optionc; ++j) {
+            if (givenv[j] && clp_excludes2(lvl->optionv + j, o)) {
+                rc = clp_fail(&clp, EX_USAGE, CLP_ERR_EXCLUDES, argv, curind,
+                              argv[curind], o, 0);
+                clp.error->xoptopt = lvl->optionv[j].optopt;
+                goto errout;
+            }
+        }
+
+        ++givenv[idx];
+        textv[idx] = optarg;
+        indv[idx] = clp.optind - 1;
+
+        if (optarg && clp_cvt_accumulates(o->cvtfunc) && occc < argc) {
+            occtextv[occc] = optarg;
+            occnextv[occc] = -1;
+            if (lastv[idx] >= 0)
+                occnextv[lastv[idx]] = occc;
+            else
+                firstv[idx] = occc;
+            lastv[idx] = occc++;
+        }
+    }
+
+    if (clp.optind < argc) {
+        rc = clp_fail(&clp, EX_USAGE, CLP_ERR_TOOMANY, argv, clp.optind,
+                      argv[clp.optind], NULL, argc - clp.optind);
+        goto errout;
+    }
+
+    /* Stage the new value of each option whose text has changed.
+     */
+    for (size_t i = 0; i < optionc; ++i) {
+        unsigned char *stage = gen->stagev + gen->offv[i];
+
+        o = lvl->optionv + i;
+
+        if (!clp_optopt_valid(o->optopt) || lvl->optmap[o->optopt] != i + 1)
+            continue;
+
+        if (givenv[i] == gen->givenv[i]) {
+            if (firstv[i] >= 0) {
+                if (clp_reload_same(gen->textv[i], occtextv, occnextv, firstv[i]))
+                    continue;
+            } else {
+                if (!textv[i] && !gen->textv[i])
+                    continue;
+                if (textv[i] && gen->textv[i] && 0 == strcmp(textv[i], gen->textv[i]))
+                    continue;
+            }
+        }
+
+        changedv[i] = 1;
+
+        if (textv[i]) {
+            if (firstv[i] >= 0)
+                copyv[i] = clp_reload_join(occtextv, occnextv, firstv[i]);
+            else
+                copyv[i] = strdup(textv[i]);
+            if (!copyv[i]) {
+                clp_eprint(&clp, "unable to reload");
+                rc = clp_fail(&clp, EX_OSERR, CLP_ERR_CALLBACK, argv, -1, NULL, o, 0);
+                goto errout;
+            }
+        }
+
+        if (!o->cvtfunc || !o->cvtdst || o->cvtdstsz == 0)
+            continue;
+
+        memcpy(stage, gen->dfltv + gen->offv[i], o->cvtdstsz);
+
+        /* Options that take an argument retain only their last value
+         * (unless their converter accumulates every occurrence), whereas
+         * those that don't (e.g., incr) are applied each time.
+         */
+        int occ = firstv[i];
+        int n = (o->argname && givenv[i] > 0 && occ < 0) ? givenv[i] - 1 : 0;
+
+        for (; n < givenv[i]; ++n) {
+            const char *text = (occ >= 0) ? occtextv[occ] : textv[i];
+
+            errno = 0;
+
+            rc = o->cvtfunc(&clp, text, o->cvtflags, o->cvtparms, stage);
+            if (rc > 0) {
+                rc = clp_fail(&clp, rc, CLP_ERR_CONVERT, argv, indv[i],
+                              text, o, 0);
+                goto errout;
+            }
+
+            stagedv[i] = true;
+            if (occ >= 0)
+                occ = occnextv[occ];
+        }
+
+        if (!clp_value_changed(o, stage)) {
+            if (stagedv[i])
+                clp_value_release(o->cvtfunc, stage);
+            stagedv[i] = false;
+            changedv[i] = 2; // text changed, but value did not
+        }
+    }
+
+    /* Commit all the changes.
+     */
+    for (size_t i = 0; i < optionc; ++i) {
+        o = lvl->optionv + i;
+
+        /* given reflects only this reload (clp_config() relies upon it to
+         * tell options given on the command line from those in the file).
+         */
+        o->given = givenv[i];
+        o->clp = &clp;
+
+        if (!changedv[i])
+            continue;
+
+        if (changedv[i] == 1 && o->cvtfunc && o->cvtdst) {
+            if (o->cvtdstsz > 0) {
+                if (gen->givenv[i] > 0)
+                    clp_table_value_release(table, i);
+                memcpy(o->cvtdst, gen->stagev + gen->offv[i], o->cvtdstsz);
+                stagedv[i] = false;
+            } else if (givenv[i] > 0 && !rc) {
+                errno = 0;
+
+                rc = o->cvtfunc(&clp, textv[i], o->cvtflags, o->cvtparms, o->cvtdst);
+                if (rc > 0)
+                    rc = clp_fail(&clp, rc, CLP_ERR_CONVERT, argv, indv[i],
+                                  textv[i], o, 0);
+            }
+        }
+
+        free(gen->textv[i]);
+        gen->textv[i] = copyv[i];
+        gen->givenv[i] = givenv[i];
+        copyv[i] = NULL;
+
+        /* The optarg of an accumulating option is the last of those held
+         * by its text.
+         */
+        o->optarg = gen->textv[i];
+        for (int n = 1; o->optarg && firstv[i] >= 0 && n < givenv[i]; ++n)
+            o->optarg += strlen(o->optarg) + 1;
+    }
+
+    /* Call the action() and then the after() procedure of each option
+     * whose value has changed.
+     */
+    for (int pass = 0; pass < 2 && !rc; ++pass) {
+        for (size_t i = 0; i < optionc && !rc; ++i) {
+            clp_option_cb *cb;
+
+            o = lvl->optionv + i;
+            cb = pass ? o->after : o->action;
+
+            if (changedv[i] == 1 && givenv[i] > 0 && cb) {
+                rc = cb(o);
+                if (rc > 0)
+                    rc = clp_fail(&clp, rc, CLP_ERR_CALLBACK, argv, indv[i],
+                                  textv[i], o, 0);
+                else
+                    rc = 0;
+            }
+        }
+    }
+
+  errout:
+    rc = clp_async_collect(&clp, rc, NULL, NULL);
+
+    for (size_t i = 0; i < optionc; ++i) {
+        if (stagedv[i])
+            clp_value_release(lvl->optionv[i].cvtfunc, gen->stagev + gen->offv[i]);
+        free(copyv[i]);
+    }
+
+    if (rc && !err && errlocal.kind != CLP_ERR_NONE) {
+        clp_error_format(&errlocal, clp.errbuf, sizeof(clp.errbuf));
+        if (clp.errbuf[0])
+            fprintf(stderr, "%s: %s\n", errlocal.basename, clp.errbuf);
+    }
+
+    return rc;
+}
+
+/* Copy the strings (and, for lists and maps, the vectors) of the given
+ * option's value into snapshot storage at buf, and point the snapshot's
+ * copy of the value at val at the copies.  If buf is nil then only return
+ * the size of the storage needed (a multiple of 16).
+ */
+static size_t
+clp_snap_copy(const struct clp_option *o, void *val, char *buf)
+{
+    size_t sz = 0;
+
+    if (!o->cvtdst)
+        return 0;
+
+    if (o->cvtfunc == clp_cvt_string) {
+        char * const *strv = o->cvtdst;
+
+        for (size_t i = 0; i < o->cvtdstsz / sizeof(*strv); ++i) {
+            if (strv[i]) {
+                size_t len = strlen(strv[i]) + 1;
+
+                if (buf)
+                    ((char **)val)[i] = memcpy(buf + sz, strv[i], len);
+                sz += len;
+            }
+        }
+    } else if (o->cvtfunc == clp_cvt_list) {
+        const struct clp_list *list = o->cvtdst;
+        const char **argv = (void *)buf;
+
+        sz = roundup(sizeof(*argv) * (list->argc + 1), 16);
+
+        for (size_t i = 0; i < list->argc; ++i) {
+            size_t len = strlen(list->argv[i]) + 1;
+
+            if (buf)
+                argv[i] = memcpy(buf + sz, list->argv[i], len);
+            sz += len;
+        }
+
+        if (buf) {
+            struct clp_list *copy = val;
+
+            argv[list->argc] = NULL;
+            copy->argv = argv;
+            copy->argmax = list->argc + 1;
+            copy->buf = NULL;
+            copy->buflen = copy->bufsz = 0;
+        }
+    } else if (o->cvtfunc == clp_cvt_kvmap) {
+        const struct clp_kvmap *map = o->cvtdst;
+        struct clp_kvent *entv = (void *)buf;
+        size_t idxoff, bufoff;
+
+        idxoff = roundup(sizeof(*entv) * map->entc, 16);
+        bufoff = idxoff + roundup(sizeof(*map->idxv) * map->idxmax, 16);
+        sz = bufoff + map->buflen;
+
+        if (buf) {
+            struct clp_kvmap *copy = val;
+
+            for (size_t i = 0; i < map->entc; ++i) {
+                const struct clp_kvent *ent = map->entv + i;
+
+                entv[i].key = buf + bufoff + (ent->key - map->buf);
+                entv[i].val = ent->val ? buf + bufoff + (ent->val - map->buf) : NULL;
+                entv[i].hash = ent->hash;
+            }
+
+            if (map->idxmax > 0)
+                memcpy(buf + idxoff, map->idxv, sizeof(*map->idxv) * map->idxmax);
+            if (map->buflen > 0)
+                memcpy(buf + bufoff, map->buf, map->buflen);
+
+            copy->entv = entv;
+            copy->entmax = map->entc;
+            copy->idxv = (map->idxmax > 0) ? (void *)(buf + idxoff) : NULL;
+            copy->buf = buf + bufoff;
+            copy->bufsz = map->buflen;
+        }
+    }
+
+    return roundup(sz, 16);
+}
+
+/* Make an immutable copy of the current values of the table's root
+ * options and publish it, replacing (and releasing the table's reference
+ * to) the previously published snapshot.  Readers that acquired the old
+ * snapshot continue to use it until they release it, whereupon it is
+ * freed.  Values that own resources (e.g., files) are not copied, but
+ * are held by the snapshot, so that a reload that replaces them defers
+ * their release until the last snapshot that shares them is released.
+ *
+ * clp_table_publish(), clp_table_reload(), and clp_table_watch_reload()
+ * must be serialized by the caller (i.e., there may be only one writer),
+ * but clp_snap_acquire() may be called concurrently from any thread.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_publish(struct clp_table *table)
+{
+    const struct clp_level *lvl;
+    struct clp_snap *snap, *old;
+    size_t sz, holdsz, strsz = 0;
+    struct clp_gen *gen;
+    unsigned int epoch;
+    char *pc;
+
+    if (!table) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    lvl = table->root;
+    gen = table->gen;
+
+    for (size_t i = 0; i < lvl->optionc; ++i)
+        strsz += clp_snap_copy(lvl->optionv + i, NULL, NULL);
+
+    holdsz = roundup(sizeof(*snap->holdv) * lvl->optionc, 16);
+    sz = roundup(sizeof(*snap), 16) + holdsz + gen->valsz + strsz;
+
+    snap = malloc(sz);
+    if (!snap) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    snap->refcnt = 1;
+    snap->gen = ++table->snapgen;
+    snap->lvl = lvl;
+    snap->offv = gen->offv;
+    snap->holdv = (void *)((char *)snap + roundup(sizeof(*snap), 16));
+    snap->valv = (unsigned char *)snap->holdv + holdsz;
+    pc = (char *)snap->valv + gen->valsz;
+
+    memset(snap->holdv, 0, holdsz);
+
+    for (size_t i = 0; i < lvl->optionc; ++i) {
+        const struct clp_option *o = lvl->optionv + i;
+        unsigned char *val = snap->valv + snap->offv[i];
+        struct clp_hold *hold;
+
+        if (!o->cvtdst || o->cvtdstsz == 0)
+            continue;
+
+        memcpy(val, o->cvtdst, o->cvtdstsz);
+
+        /* Hold values that own resources, other than the option's
+         * default (which was not produced by a conversion).
+         */
+        if (clp_value_holdable(o->cvtfunc) &&
+            memcmp(o->cvtdst, gen->dfltv + gen->offv[i], o->cvtdstsz)) {
+            hold = gen->holdv[i];
+
+            if (hold && memcmp(hold->val, o->cvtdst, o->cvtdstsz)) {
+                clp_hold_release(hold);
+                hold = NULL;
+            }
+
+            if (!hold) {
+                hold = malloc(sizeof(*hold) + o->cvtdstsz);
+                if (!hold) {
+                    gen->holdv[i] = NULL;
+                    clp_snap_release(snap);
+                    errno = ENOMEM;
+                    return EX_OSERR;
+                }
+
+                hold->refcnt = 1;
+                hold->cvtfunc = o->cvtfunc;
+                memcpy(hold->val, o->cvtdst, o->cvtdstsz);
+                gen->holdv[i] = hold;
+            }
+
+            __atomic_add_fetch(&hold->refcnt, 1, __ATOMIC_RELAXED);
+            snap->holdv[i] = hold;
+        }
+
+        pc += clp_snap_copy(o, val, pc);
+    }
+
+    old = __atomic_exchange_n(&table->snap, snap, __ATOMIC_SEQ_CST);
+
+    /* Readers that might have loaded the old snapshot pointer are those
+     * counted in the current epoch's reader count.  Flip the epoch so
+     * that new readers are counted separately, then wait for the count
+     * of the old epoch to drain before dropping our reference.  Readers
+     * that loaded the old epoch but were counted only after the flip
+     * notice the flip and retry (see clp_snap_acquire()).
+     */
+    epoch = __atomic_fetch_add(&table->snapepoch, 1, __ATOMIC_SEQ_CST) & 1;
+
+    while (__atomic_load_n(&table->snapreaders[epoch], __ATOMIC_SEQ_CST) > 0)
+        sched_yield();
+
+    clp_snap_release(old);
+
+    return 0;
+}
+
+/* Acquire a reference on the table's published snapshot, which must be
+ * released via clp_snap_release().  This is lock-free, and may be called
+ * concurrently with clp_table_publish().  Returns NULL if no snapshot
+ * has been published.
+ */
+const struct clp_snap *
+clp_snap_acquire(struct clp_table *table)
+{
+    struct clp_snap *snap;
+    unsigned int epoch;
+
+    if (!table)
+        return NULL;
+
+    /* A publisher waits only for the readers counted in the epoch that
+     * it flips, so a reader that is counted after the epoch it loaded
+     * has been flipped must not load the snapshot pointer (which that
+     * publisher's successor may free).  Hence the epoch is checked
+     * again once counted, and the reader retries if it has changed.
+     */
+    while (1) {
+        epoch = __atomic_load_n(&table->snapepoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&table->snapreaders[epoch & 1], 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&table->snapepoch, __ATOMIC_SEQ_CST) == epoch)
+            break;
+
+        __atomic_fetch_sub(&table->snapreaders[epoch & 1], 1, __ATOMIC_RELEASE);
+    }
+
+    snap = __atomic_load_n(&table->snap, __ATOMIC_SEQ_CST);
+    if (snap)
+        __atomic_fetch_add(&snap->refcnt, 1, __ATOMIC_RELAXED);
+
+    __atomic_fetch_sub(&table->snapreaders[epoch & 1], 1, __ATOMIC_RELEASE);
+
+    return snap;
+}
+
+void
+clp_snap_release(const struct clp_snap *snap)
+{
+    struct clp_snap *s = (struct clp_snap *)snap;
+
+    if (s && __atomic_sub_fetch(&s->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        for (size_t i = 0; i < s->lvl->optionc; ++i)
+            clp_hold_release(s->holdv[i]);
+        free(s);
+    }
+}
+
+/* Return a pointer to the snapshot's copy of the value of the option
+ * identified by optopt.  On error, sets errno and returns NULL.
+ */
+const void *
+clp_snap_value(const struct clp_snap *snap, int optopt)
+{
+    const struct clp_option *o;
+    int idx;
+
+    if (!snap || !clp_optopt_valid(optopt)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    idx = snap->lvl->optmap[optopt] - 1;
+    if (idx < 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    o = snap->lvl->optionv + idx;
+    if (!o->cvtdst || o->cvtdstsz == 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    return snap->valv + snap->offv[idx];
+}
+
+unsigned long
+clp_snap_gen(const struct clp_snap *snap)
+{
+    return snap ? snap->gen : 0;
+}
+
+/* Watch the given (config) file for changes.  The returned file
+ * descriptor becomes readable when the file is written or replaced,
+ * whereupon the caller should call clp_table_watch_reload().  The
+ * file's directory is watched rather than the file itself so that
+ * files replaced by rename (as many editors do) are noticed.
+ *
+ * On error, sets errno and returns -1.
+ */
+int
+clp_table_watch(struct clp_table *table, const char *path)
+{
+#ifdef __linux__
+    char dir[PATH_MAX];
+    const char *slash;
+    int fd;
+
+    if (!table || !path || table->watchfd != -1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    slash = strrchr(path, '/');
+    if (slash && slash[1] == '\000') {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (slash)
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path + 1), path);
+    else
+        strcpy(dir, ".");
+
+    table->watchname = strdup(slash ? slash + 1 : path);
+    if (!table->watchname)
+        return -1;
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+        goto errout;
+
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1) {
+        int xerrno = errno;
+
+        close(fd);
+        errno = xerrno;
+        goto errout;
+    }
+
+    table->watchfd = fd;
+
+    return fd;
+
+  errout:
+    free(table->watchname);
+    table->watchname = NULL;
+
+    return -1;
+#else
+    (void)table;
+    (void)path;
+
+    errno = ENOTSUP;
+
+    return -1;
+#endif
+}
+
+/* Drain the events pending on the table's watch descriptor and, if the
+ * watched file changed, reload the table from argv[] (as per
+ * clp_table_reload()) and publish a new snapshot.  Options that load
+ * config files (i.e., those whose after() procedure is clp_config())
+ * are deemed to have changed so that the file is reread, and options
+ * not given on the command line are first reverted to their defaults
+ * so that the file's entries replace (rather than accumulate upon)
+ * those of the previous load.  Note that this revert is not undone
+ * should the reload fail.
+ *
+ * Returns zero if the file did not change or was reloaded successfully.
+ */
+int
+clp_table_watch_reload(struct clp_table *table, int argc, char **argv,
+                       struct clp_error *err)
+{
+#ifdef __linux__
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t cc;
+    int rc;
+
+    if (!table || table->watchfd == -1) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    while ((cc = read(table->watchfd, buf, sizeof(buf))) > 0) {
+        for (char *pc = buf; pc < buf + cc; ) {
+            const struct inotify_event *ev = (void *)pc;
+
+            if (ev->len > 0 && 0 == strcmp(ev->name, table->watchname))
+                changed = true;
+
+            pc += sizeof(*ev) + ev->len;
+        }
+    }
+
+    if (!changed)
+        return 0;
+
+    for (size_t i = 0; i < table->root->optionc; ++i) {
+        struct clp_option *o = table->root->optionv + i;
+        struct clp_gen *gen = table->gen;
+        void *dflt = gen->dfltv + gen->offv[i];
+
+        if (o->after == clp_config) {
+            free(gen->textv[i]);
+            gen->textv[i] = NULL;
+            gen->givenv[i] = 0;
+        } else if (gen->givenv[i] == 0 && o->cvtdst && o->cvtdstsz > 0) {
+            if (memcmp(o->cvtdst, dflt, o->cvtdstsz)) {
+                clp_table_value_release(table, i);
+                memcpy(o->cvtdst, dflt, o->cvtdstsz);
+            }
+        }
+    }
+
+    rc = clp_table_reload(table, argc, argv, err);
+    if (rc)
+        return rc;
+
+    return clp_table_publish(table);
+#else
+    (void)table;
+    (void)argc;
+    (void)argv;
+    (void)err;
+
+    errno = ENOTSUP;
+
+    return EX_UNAVAILABLE;
+#endif
+}
+
+/* A saved parse (see clp_table_save()) is a header followed by one entry
+ * for each option and then each posparam of the root level, followed by
+ * the data to which the entries refer.  Pointers within the blob are
+ * stored as offsets from its start, and are fixed up in place when the
+ * blob is bound to a table (the mapping is private).
+ */
+#define CLP_BLOB_MAGIC      (0x53504c43u)   // "CLPS"
+#define CLP_BLOB_VERSION    (2)
+
+struct clp_blob_ent {
+    int32_t              given;         // Given count (argc of posparams)
+    uint32_t             valsz;         // Size of the value (if any)
+    uint64_t             valoff;        // Offset of the value
+    uint64_t             stroff;        // Offset of optarg (argv of posparams)
+    uint64_t             argvoff;       // Offset of the args of an accumulated value
+};
+
+struct clp_blob {
+    uint32_t             magic;
+    uint32_t             version;
+    uint32_t             fingerprint;   // See clp_blob_fingerprint()
+    uint32_t             optionc;
+    uint32_t             paramc;
+    uint32_t             rsvd;
+    uint64_t             size;          // Size of the entire blob
+    struct clp_blob_ent  entv[];
+};
+
+/* Hash the layout of the root level so that a blob saved from one table
+ * will not be bound to an incompatible table (or build).
+ */
+static uint32_t
+clp_blob_fingerprint(const struct clp_level *lvl)
+{
+    uint32_t hash = 2166136261u;
+    const struct clp_posparam *param;
+
+#define CLP_FNV(_x)     (hash = (hash ^ (uint32_t)(_x)) * 16777619u)
+
+    CLP_FNV(sizeof(void *));
+    CLP_FNV(lvl->optionc);
+
+    for (size_t i = 0; i < lvl->optionc; ++i) {
+        CLP_FNV(lvl->optionv[i].optopt);
+        CLP_FNV(lvl->optionv[i].cvtdstsz);
+    }
+
+    for (param = lvl->paramv; param && param->name; ++param) {
+        for (const char *pc = param->name; *pc; ++pc)
+            CLP_FNV(*pc);
+        CLP_FNV(param->cvtdstsz);
+    }
+
+#undef CLP_FNV
+
+    return hash;
+}
+
+/* Return true if values produced by the given converter cannot be
+ * copied (e.g., file descriptors) and must instead be converted anew
+ * from their text.
+ */
+static bool
+clp_blob_reconvert(clp_cvt_cb *cvtfunc, void *cvtdst, size_t cvtdstsz)
+{
+    return cvtfunc && cvtdst &&
+        (cvtdstsz == 0 || clp_cvt_opaque(cvtfunc));
+}
+
+/* Append len bytes of src to the blob at *offp (aligned to align) and
+ * return its offset.  If blob is nil then only *offp is advanced (for
+ * sizing the blob).
+ */
+static uint64_t
+clp_blob_put(char *blob, size_t *offp, const void *src, size_t len, size_t align)
+{
+    size_t off = roundup(*offp, align);
+
+    if (blob)
+        memcpy(blob + off, src, len);
+    *offp = off + len;
+
+    return off;
+}
+
+/* Append a copy of the given value (with each of its string pointers
+ * replaced by the offset of a copy of the string).
+ */
+static uint64_t
+clp_blob_putval(char *blob, size_t *offp, clp_cvt_cb *cvtfunc,
+                const void *val, size_t valsz)
+{
+    uint64_t valoff = clp_blob_put(blob, offp, val, valsz, 16);
+
+    if (cvtfunc == clp_cvt_string) {
+        char * const *strv = val;
+
+        for (size_t i = 0; i < valsz / sizeof(*strv); ++i) {
+            uintptr_t stroff = 0;
+
+            if (strv[i])
+                stroff = clp_blob_put(blob, offp, strv[i], strlen(strv[i]) + 1, 1);
+            if (blob)
+                ((uintptr_t *)(blob + valoff))[i] = stroff;
+        }
+    }
+
+    return valoff;
+}
+
+/* Append the nil terminated vector of the offsets of the arguments from
+ * which an accumulated value (e.g., a list) can be converted anew, and
+ * return its offset.  Each entry of a map is saved as "key[=value]".
+ */
+static uint64_t
+clp_blob_putargs(char *blob, size_t *offp, clp_cvt_cb *cvtfunc, const void *val)
+{
+    const struct clp_kvmap *map = val;
+    const struct clp_list *list = val;
+    size_t argc = 0;
+
+    if (cvtfunc == clp_cvt_list)
+        argc = list->argc;
+    else if (cvtfunc == clp_cvt_kvmap)
+        argc = map->entc;
+
+    uintptr_t argv[argc + 1];
+
+    for (size_t i = 0; i < argc; ++i) {
+        const struct clp_kvent *ent = map->entv + i;
+        const char *arg;
+
+        if (cvtfunc == clp_cvt_list) {
+            arg = list->argv[i];
+            argv[i] = clp_blob_put(blob, offp, arg, strlen(arg) + 1, 1);
+            continue;
+        }
+
+        argv[i] = clp_blob_put(blob, offp, ent->key, strlen(ent->key), 1);
+        if (ent->val) {
+            clp_blob_put(blob, offp, "=", 1, 1);
+            clp_blob_put(blob, offp, ent->val, strlen(ent->val), 1);
+        }
+        clp_blob_put(blob, offp, "", 1, 1);
+    }
+    argv[argc] = 0;
+
+    return clp_blob_put(blob, offp, argv, sizeof(argv), sizeof(argv[0]));
+}
+
+/* Lay out (or, if blob is nil, size) the blob of the root level.
+ */
+static size_t
+clp_blob_build(const struct clp_level *lvl, size_t paramc, char *blob)
+{
+    const struct clp_posparam *param;
+    struct clp_blob *hdr = (void *)blob;
+    size_t off;
+
+    off = sizeof(*hdr) + sizeof(hdr->entv[0]) * (lvl->optionc + paramc);
+
+    for (size_t i = 0; i < lvl->optionc; ++i) {
+        const struct clp_option *o = lvl->optionv + i;
+        struct clp_blob_ent ent = { .given = o->given };
+
+        if (o->optarg)
+            ent.stroff = clp_blob_put(blob, &off, o->optarg, strlen(o->optarg) + 1, 1);
+
+        if (o->cvtdst && clp_cvt_accumulates(o->cvtfunc))
+            ent.argvoff = clp_blob_putargs(blob, &off, o->cvtfunc, o->cvtdst);
+
+        if (o->cvtdst && !clp_blob_reconvert(o->cvtfunc, o->cvtdst, o->cvtdstsz)) {
+            ent.valsz = o->cvtdstsz;
+            ent.valoff = clp_blob_putval(blob, &off, o->cvtfunc, o->cvtdst, o->cvtdstsz);
+        }
+
+        if (blob)
+            hdr->entv[i] = ent;
+    }
+
+    param = lvl->paramv;
+
+    for (size_t i = 0; i < paramc; ++i, ++param) {
+        struct clp_blob_ent ent = { .given = param->argc };
+        uintptr_t argv[param->argc + 1];
+
+        for (int j = 0; j < param->argc; ++j) {
+            const char *arg = param->argv[j];
+
+            argv[j] = clp_blob_put(blob, &off, arg, strlen(arg) + 1, 1);
+        }
+        argv[param->argc] = 0;
+
+        ent.stroff = clp_blob_put(blob, &off, argv, sizeof(argv), sizeof(argv[0]));
+
+        if (param->cvtdst &&
+            !clp_blob_reconvert(param->cvtfunc, param->cvtdst, param->cvtdstsz)) {
+            ent.valsz = param->cvtdstsz;
+            ent.valoff = clp_blob_putval(blob, &off, param->cvtfunc,
+                                         param->cvtdst, param->cvtdstsz);
+        }
+
+        if (blob)
+            hdr->entv[lvl->optionc + i] = ent;
+    }
+
+    off = roundup(off, 16);
+
+    if (hdr) {
+        hdr->magic = CLP_BLOB_MAGIC;
+        hdr->version = CLP_BLOB_VERSION;
+        hdr->fingerprint = clp_blob_fingerprint(lvl);
+        hdr->optionc = lvl->optionc;
+        hdr->paramc = paramc;
+        hdr->size = off;
+    }
+
+    return off;
+}
+
+/* Save the results of the most recent parse of the given table (i.e.,
+ * the converted values and given counts of the root level's options,
+ * and the arguments and values of its posparams) to fd in a compact,
+ * position independent form that clp_table_restore() can map and bind
+ * to the same table in another process without reparsing.
+ *
+ * Strings are saved by value, whereas the values of options converted
+ * by converters that open files (e.g., clp_cvt_open()) or whose size is
+ * unknown are not saved, but are instead converted anew by
+ * clp_table_restore().  Accumulated values (i.e., lists and maps) are
+ * saved as the arguments from which they are converted anew.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_save(struct clp_table *table, int fd)
+{
+    const struct clp_posparam *param;
+    const struct clp_level *lvl;
+    size_t paramc = 0, size;
+    char *blob, *pc;
+    int rc = 0;
+
+    if (!table || fd < 0) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    lvl = table->root;
+
+    for (param = lvl->paramv; param && param->name; ++param) {
+        if (param->cvtsubcmd) {
+            errno = ENOTSUP;
+            return EX_UNAVAILABLE;
+        }
+        ++paramc;
+    }
+
+    size = clp_blob_build(lvl, paramc, NULL);
+
+    blob = calloc(1, size);
+    if (!blob) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    clp_blob_build(lvl, paramc, blob);
+
+    for (pc = blob; pc < blob + size; ) {
+        ssize_t cc = write(fd, pc, blob + size - pc);
+
+        if (cc == -1) {
+            if (errno == EINTR)
+                continue;
+            rc = EX_IOERR;
+            break;
+        }
+
+        pc += cc;
+    }
+
+    free(blob);
+
+    return rc;
+}
+
+/* Return true if off refers to a NUL terminated string within the blob.
+ */
+static bool
+clp_blob_strok(const char *blob, size_t blobsz, uint64_t off)
+{
+    return off > 0 && off < blobsz && memchr(blob + off, '\000', blobsz - off);
+}
+
+/* Return true if off refers to a nil terminated vector of the offsets of
+ * strings within the blob, of exactly argc strings unless argc is -1.
+ */
+static bool
+clp_blob_argvok(const char *blob, size_t blobsz, uint64_t off, int argc)
+{
+    const uintptr_t *argv = (const void *)(blob + off);
+
+    if (off == 0 || off % sizeof(*argv) || off >= blobsz)
+        return false;
+
+    for (size_t i = 0; off + (i + 1) * sizeof(*argv) <= blobsz; ++i) {
+        if (!argv[i])
+            return argc == -1 || i == (size_t)argc;
+
+        if (i == (size_t)argc || !clp_blob_strok(blob, blobsz, argv[i]))
+            return false;
+    }
+
+    return false;
+}
+
+/* Return true if the value to which the given entry refers (if any) lies
+ * within the blob, is of the size of dst, and (if it is a string) refers
+ * only to strings within the blob.
+ */
+static bool
+clp_blob_valok(const char *blob, size_t blobsz, const struct clp_blob_ent *ent,
+               clp_cvt_cb *cvtfunc, void *cvtdst, size_t cvtdstsz)
+{
+    if (ent->valsz == 0)
+        return true;
+
+    if (!cvtdst || ent->valsz != cvtdstsz || clp_blob_reconvert(cvtfunc, cvtdst, cvtdstsz))
+        return false;
+
+    if (ent->valoff % sizeof(uintptr_t) || ent->valoff > blobsz ||
+        ent->valsz > blobsz - ent->valoff)
+        return false;
+
+    if (cvtfunc == clp_cvt_string) {
+        const uintptr_t *offv = (const void *)(blob + ent->valoff);
+
+        for (size_t i = 0; i < ent->valsz / sizeof(*offv); ++i) {
+            if (offv[i] && !clp_blob_strok(blob, blobsz, offv[i]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* Return true if every entry of the blob (whose header has already been
+ * checked) refers only to data within the blob that is consistent with
+ * the given level.
+ */
+static bool
+clp_blob_ok(const char *blob, size_t blobsz, const struct clp_level *lvl)
+{
+    const struct clp_blob *hdr = (const void *)blob;
+    const struct clp_posparam *param;
+    size_t entc = hdr->optionc + hdr->paramc;
+
+    if (entc > (blobsz - sizeof(*hdr)) / sizeof(hdr->entv[0]))
+        return false;
+
+    for (size_t i = 0; i < lvl->optionc; ++i) {
+        const struct clp_blob_ent *ent = hdr->entv + i;
+        const struct clp_option *o = lvl->optionv + i;
+
+        if (ent->given < 0)
+            return false;
+        if (ent->stroff && !clp_blob_strok(blob, blobsz, ent->stroff))
+            return false;
+        if (ent->argvoff && (!clp_cvt_accumulates(o->cvtfunc) ||
+                             !clp_blob_argvok(blob, blobsz, ent->argvoff, -1)))
+            return false;
+        if (!clp_blob_valok(blob, blobsz, ent, o->cvtfunc, o->cvtdst, o->cvtdstsz))
+            return false;
+    }
+
+    param = lvl->paramv;
+
+    for (size_t i = 0; i < hdr->paramc; ++i, ++param) {
+        const struct clp_blob_ent *ent = hdr->entv + lvl->optionc + i;
+
+        if (ent->given < 0 || ent->argvoff)
+            return false;
+        if (!clp_blob_argvok(blob, blobsz, ent->stroff, ent->given))
+            return false;
+        if (!clp_blob_valok(blob, blobsz, ent, param->cvtfunc, param->cvtdst,
+                            param->cvtdstsz))
+            return false;
+    }
+
+    return true;
+}
+
+/* Copy the value at valoff (if any) to dst, converting string offsets
+ * into pointers into the blob.
+ */
+static void
+clp_blob_bindval(char *blob, const struct clp_blob_ent *ent, clp_cvt_cb *cvtfunc,
+                 void *dst)
+{
+    if (ent->valsz == 0)
+        return;
+
+    if (cvtfunc == clp_cvt_string) {
+        uintptr_t *offv = (void *)(blob + ent->valoff);
+
+        for (size_t i = 0; i < ent->valsz / sizeof(*offv); ++i)
+            offv[i] = offv[i] ? (uintptr_t)(blob + offv[i]) : 0;
+    }
+
+    memcpy(dst, blob + ent->valoff, ent->valsz);
+}
+
+/* Convert anew from the blob the value of an option or posparam whose
+ * value was not saved, from the saved args of an accumulated value, or
+ * else from argc strings of argv.
+ */
+static int
+clp_blob_reconvert_val(struct clp *clp, char *blob, const struct clp_blob_ent *ent,
+                       clp_cvt_cb *cvtfunc, int cvtflags, void *cvtparms,
+                       int argc, char * const *argv, void *dst)
+{
+    const uintptr_t *args = ent->argvoff ? (void *)(blob + ent->argvoff) : NULL;
+
+    for (int j = 0; args ? args[j] != 0 : j < argc; ++j) {
+        int rc;
+
+        errno = 0;
+
+        rc = cvtfunc(clp, args ? blob + args[j] : argv[j], cvtflags, cvtparms, dst);
+        if (rc > 0)
+            return rc;
+    }
+
+    return 0;
+}
+
+/* Return a copy of the text of an option restored from the blob, in the
+ * form that clp_table_reload() retains (i.e., the optargs of each
+ * occurrence of an accumulated value one after another).
+ */
+static char *
+clp_blob_text(const char *blob, const struct clp_blob_ent *ent)
+{
+    const uintptr_t *args = ent->argvoff ? (void *)(blob + ent->argvoff) : NULL;
+    size_t sz = 0;
+    char *buf, *pc;
+
+    if (!args)
+        return ent->stroff ? strdup(blob + ent->stroff) : NULL;
+
+    for (int j = 0; args[j] != 0; ++j)
+        sz += strlen(blob + args[j]) + 1;
+
+    buf = malloc(sz + 1);
+    if (!buf)
+        return NULL;
+
+    for (pc = buf; *args != 0; ++args)
+        pc = stpcpy(pc, blob + *args) + 1;
+
+    return buf;
+}
+
+/* Map the blob written by clp_table_save() from fd, and bind it to the
+ * given table (which must have been created from the same option and
+ * posparam vectors as the saved table).  This sets the given count,
+ * optarg, and value of each root level option, and the argc, argv,
+ * and value of each root level posparam, without calling any action()
+ * or after() procedures.  Converters are called only for values that
+ * were not saved (see clp_table_save()).
+ *
+ * The blob is validated in its entirety, and values that must be
+ * converted anew are converted into staging storage, before the table
+ * is changed at all, so that a corrupt blob or a failed conversion
+ * leaves the table as it was.  Values whose cvtdstsz is zero cannot be
+ * staged, and are instead converted in place once all else is bound.
+ *
+ * Restored strings and arguments refer to the mapping, which remains
+ * until the table is destroyed or restored again, and must not be freed.
+ * Lines cached by clp_table_parsel() are discarded (but the cache remains
+ * enabled), and a subsequent clp_table_reload() compares its arguments
+ * against those restored.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
+ */
+int
+clp_table_restore(struct clp_table *table, int fd)
+{
+    const struct clp_blob *hdr;
+    struct clp_posparam *param;
+    unsigned char *pstagev;
+    struct clp_level *lvl;
+    struct clp_gen *gen;
+    struct clp clp;
+    struct stat sb;
+    size_t n, psz;
+    char *blob;
+    int rc = 0;
+
+    if (!table || fd < 0) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    lvl = table->root;
+    gen = table->gen;
+
+    if (fstat(fd, &sb))
+        return EX_NOINPUT;
+
+    if ((size_t)sb.st_size < sizeof(*hdr)) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    blob = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (blob == MAP_FAILED)
+        return EX_OSERR;
+
+    hdr = (void *)blob;
+    n = psz = 0;
+    for (param = lvl->paramv; param && param->name; ++param) {
+        psz += roundup(param->cvtdstsz, 16);
+        ++n;
+    }
+
+    if (hdr->magic != CLP_BLOB_MAGIC || hdr->version != CLP_BLOB_VERSION ||
+        hdr->size != (uint64_t)sb.st_size || hdr->optionc != lvl->optionc ||
+        hdr->paramc != n || hdr->fingerprint != clp_blob_fingerprint(lvl) ||
+        !clp_blob_ok(blob, sb.st_size, lvl)) {
+        munmap(blob, sb.st_size);
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    pstagev = calloc(1, psz + 1);
+    if (!pstagev) {
+        munmap(blob, sb.st_size);
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    bool optstagedv[lvl->optionc + 1];
+    bool pstagedv[n + 1];
+
+    memset(optstagedv, 0, sizeof(optstagedv));
+    memset(pstagedv, 0, sizeof(pstagedv));
+
+    memset(&clp, 0, sizeof(clp));
+    clp.table = table;
+    clp.level = lvl;
+    clp.optionv = lvl->optionv;
+    clp.paramv = lvl->paramv;
+    clp.optionc = lvl->optionc;
+    clp.opthelp = lvl->opthelp;
+    clp.basename = "";
+
+    /* Fix up the argv of each posparam in place (the blob is private and
+     * not yet bound), and then stage the value of each option and of
+     * each posparam.
+     */
+    param = lvl->paramv;
+
+    for (size_t i = 0; i < n; ++i, ++param) {
+        const struct clp_blob_ent *ent = hdr->entv + lvl->optionc + i;
+        uintptr_t *argv = (void *)(blob + ent->stroff);
+
+        for (int j = 0; j < ent->given; ++j)
+            argv[j] = (uintptr_t)(blob + argv[j]);
+    }
+
+    for (size_t i = 0; i < lvl->optionc && !rc; ++i) {
+        const struct clp_blob_ent *ent = hdr->entv + i;
+        struct clp_option *o = lvl->optionv + i;
+        unsigned char *stage = gen->stagev + gen->offv[i];
+        char *optarg = ent->stroff ? blob + ent->stroff : NULL;
+
+        if (!o->cvtdst || o->cvtdstsz == 0)
+            continue;
+
+        if (ent->valsz > 0) {
+            clp_blob_bindval(blob, ent, o->cvtfunc, stage);
+            optstagedv[i] = true;
+        } else if (ent->argvoff || (ent->given && optarg &&
+                                    clp_blob_reconvert(o->cvtfunc, o->cvtdst, o->cvtdstsz))) {
+            memset(stage, 0, o->cvtdstsz);
+            optstagedv[i] = true;
+
+            rc = clp_blob_reconvert_val(&clp, blob, ent, o->cvtfunc, o->cvtflags,
+                                        o->cvtparms, 1, &optarg, stage);
+        }
+    }
+
+    param = lvl->paramv;
+
+    for (size_t i = 0, off = 0; i < n && !rc; ++i, ++param) {
+        const struct clp_blob_ent *ent = hdr->entv + lvl->optionc + i;
+        unsigned char *stage = pstagev + off;
+
+        off += roundup(param->cvtdstsz, 16);
+
+        if (!param->cvtdst || param->cvtdstsz == 0)
+            continue;
+
+        if (ent->valsz > 0) {
+            clp_blob_bindval(blob, ent, param->cvtfunc, stage);
+            pstagedv[i] = true;
+        } else if (clp_blob_reconvert(param->cvtfunc, param->cvtdst, param->cvtdstsz)) {
+            memset(stage, 0, param->cvtdstsz);
+            pstagedv[i] = true;
+
+            rc = clp_blob_reconvert_val(&clp, blob, ent, param->cvtfunc, param->cvtflags,
+                                        param->cvtparms, ent->given,
+                                        (void *)(blob + ent->stroff), stage);
+        }
+    }
+
+    /* The restored options supersede those of the last reload, so retain
+     * their text for clp_table_reload() to compare against.
+     */
+    char *textv[lvl->optionc + 1];
+
+    memset(textv, 0, sizeof(textv));
+
+    for (size_t i = 0; i < lvl->optionc && !rc; ++i) {
+        const struct clp_blob_ent *ent = hdr->entv + i;
+
+        textv[i] = clp_blob_text(blob, ent);
+        if (!textv[i] && (ent->argvoff || ent->stroff)) {
+            errno = ENOMEM;
+            rc = EX_OSERR;
+        }
+    }
+
+    if (rc) {
+        for (size_t i = 0; i < lvl->optionc; ++i) {
+            struct clp_option *o = lvl->optionv + i;
+
+            free(textv[i]);
+
+            if (optstagedv[i] && clp_blob_reconvert(o->cvtfunc, o->cvtdst, o->cvtdstsz))
+                clp_value_release(o->cvtfunc, gen->stagev + gen->offv[i]);
+        }
+
+        param = lvl->paramv;
+
+        for (size_t i = 0, off = 0; i < n; ++i, ++param) {
+            if (pstagedv[i] && clp_blob_reconvert(param->cvtfunc, param->cvtdst,
+                                                  param->cvtdstsz))
+                clp_value_release(param->cvtfunc, pstagev + off);
+            off += roundup(param->cvtdstsz, 16);
+        }
+
+        free(pstagev);
+        munmap(blob, sb.st_size);
+
+        return rc;
+    }
+
+    /* Commit.  Lists and maps previously converted are replaced, so free
+     * their storage.
+     */
+    if (table->blob)
+        munmap(table->blob, table->blobsz);
+
+    if (table->cache)
+        clp_cache_flush(table->cache);
+    table->blob = blob;
+    table->blobsz = sb.st_size;
+
+    for (size_t i = 0; i < lvl->optionc; ++i) {
+        const struct clp_blob_ent *ent = hdr->entv + i;
+        struct clp_option *o = lvl->optionv + i;
+
+        o->given = ent->given;
+        o->optarg = ent->stroff ? blob + ent->stroff : NULL;
+        o->clp = NULL;
+
+        free(gen->textv[i]);
+        gen->textv[i] = textv[i];
+        gen->givenv[i] = ent->given;
+
+        if (optstagedv[i]) {
+            if (clp_cvt_accumulates(o->cvtfunc))
+                clp_value_release(o->cvtfunc, o->cvtdst);
+            memcpy(o->cvtdst, gen->stagev + gen->offv[i], o->cvtdstsz);
+        } else if (o->cvtdst && o->cvtdstsz == 0 && !rc &&
+                   (ent->argvoff || (o->given && o->optarg && o->cvtfunc))) {
+            char *optarg = (char *)o->optarg;
+
+            clp_value_reset(o->cvtfunc, o->cvtdst);
+
+            rc = clp_blob_reconvert_val(&clp, blob, ent, o->cvtfunc, o->cvtflags,
+                                        o->cvtparms, 1, &optarg, o->cvtdst);
+        }
+    }
+
+    param = lvl->paramv;
+
+    for (size_t i = 0, off = 0; i < n; ++i, ++param) {
+        const struct clp_blob_ent *ent = hdr->entv + lvl->optionc + i;
+
+        param->argc = ent->given;
+        param->argv = (char **)(blob + ent->stroff);
+        param->clp = NULL;
+
+        if (pstagedv[i]) {
+            if (clp_cvt_accumulates(param->cvtfunc))
+                clp_value_release(param->cvtfunc, param->cvtdst);
+            memcpy(param->cvtdst, pstagev + off, param->cvtdstsz);
+        } else if (param->cvtdst && param->cvtdstsz == 0 && param->cvtfunc && !rc) {
+            rc = clp_blob_reconvert_val(&clp, blob, ent, param->cvtfunc, param->cvtflags,
+                                        param->cvtparms, param->argc, param->argv,
+                                        param->cvtdst);
+        }
+
+        off += roundup(param->cvtdstsz, 16);
+    }
+
+    free(pstagev);
+
+    return rc;
+}
+
+/* Find the level of the command named by cmd, whose first word is
+ * the program name and whose remaining words (if any) name a path
+ * of (possibly abbreviated) subcommands.  The last word of cmd is
+ * copied to basebuf[] for use as the basename.
+ *
+ * On error, sets errno and returns NULL.
+ */
+static struct clp_level *
+clp_table_lookup(struct clp_table *table, const char *cmd,
+                 char *basebuf, size_t basebufsz)
+{
+    struct clp_level *lvl;
+    const char *word, *end;
+
+    if (!table || !cmd || !basebuf) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    lvl = table->root;
+
+    for (word = cmd; isspace(*word); ++word)
+        continue;
+
+    for (end = word; *end && !isspace(*end); ++end) {
+        if (*end == '/')
+            word = end + 1;
+    }
+
+    if (end == word) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    while (1) {
+        const struct clp_subidx *idx = NULL;
+        const struct clp_subent *ent;
+        struct clp_posparam *param;
+        size_t len = end - word;
+        int nmatch;
+
+        if (len >= basebufsz) {
+            errno = ENAMETOOLONG;
+            return NULL;
+        }
+
+        memcpy(basebuf, word, len);
+        basebuf[len] = '\000';
+
+        for (word = end; isspace(*word); ++word)
+            continue;
+
+        if (!*word)
+            break;
+
+        for (end = word; *end && !isspace(*end); ++end)
+            continue;
+
+        for (param = lvl->paramv; param && param->name; ++param) {
+            idx = clp_level_subidx(lvl, clp_subcmd(param));
+            if (idx)
+                break;
+        }
+
+        ent = idx ? clp_subidx_search(idx, word, end - word, &nmatch) : NULL;
+        if (!ent || nmatch > 1) {
+            errno = ENOENT;
+            return NULL;
+        }
+
+        lvl = idx->levelv[ent->subcmd - idx->subcmdv];
+    }
+
+    return lvl;
+}
+
+/* Render the help message (or just the usage lines if CLP_HELP_USAGE
+ * is given) of the command named by cmd (e.g., "prog cluster node")
+ * into buf[] in the manner of snprintf(3).  The help text of each
+ * level of the table is rendered once and cached for the life of
+ * the table, hence repeated calls are cheap and never touch stdout.
+ *
+ * Returns the length of the help message (which may be larger
+ * than bufsz), or sets errno and returns -1 on error.
+ */
+ssize_t
+clp_table_help(struct clp_table *table, const char *cmd, int flags,
+               char *buf, size_t bufsz)
+{
+    const struct clp_strbuf *help;
+    char basename[CLP_ERRBUF_MAX];
+    struct clp_level *lvl;
+    size_t len = 0;
+
+    lvl = clp_table_lookup(table, cmd, basename, sizeof(basename));
+    if (!lvl)
+        return -1;
+
+    help = clp_level_help(lvl, flags);
+    if (!help)
+        return -1;
+
+    struct iovec iov[help->basec * 2 + 1];
+    int iovc;
+
+    iovc = clp_help_iov(help, basename, iov);
+
+    for (int i = 0; i < iovc; ++i) {
+        if (len + 1 < bufsz) {
+            memcpy(buf + len, iov[i].iov_base,
+                   MIN(iov[i].iov_len, bufsz - len - 1));
+        }
+
+        len += iov[i].iov_len;
+    }
+
+    if (bufsz > 0)
+        buf[MIN(len, bufsz - 1)] = '\000';
+
+    return len;
+}
+
+#ifndef IOV_MAX
+#define IOV_MAX     (16)    // The minimum required by POSIX
+#endif
+
+/* Like clp_table_help(), but writes the help message to the given
+ * file descriptor (typically in a single call to writev(2)).
+ */
+ssize_t
+clp_table_help_fd(struct clp_table *table, const char *cmd, int flags, int fd)
+{
+    const struct clp_strbuf *help;
+    char basename[CLP_ERRBUF_MAX];
+    struct clp_level *lvl;
+    ssize_t len = 0;
+
+    lvl = clp_table_lookup(table, cmd, basename, sizeof(basename));
+    if (!lvl)
+        return -1;
+
+    help = clp_level_help(lvl, flags);
+    if (!help)
+        return -1;
+
+    struct iovec iov[help->basec * 2 + 1];
+    struct iovec *cur = iov;
+    int iovc;
+
+    iovc = clp_help_iov(help, basename, iov);
+
+    while (iovc > 0) {
+        ssize_t cc = writev(fd, cur, MIN(iovc, IOV_MAX));
+
+        if (cc == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        len += cc;
+
+        while (iovc > 0 && (size_t)cc >= cur->iov_len) {
+            cc -= cur->iov_len;
+            ++cur;
+            --iovc;
+        }
+
+        if (iovc > 0) {
+            cur->iov_base = (char *)cur->iov_base + cc;
+            cur->iov_len -= cc;
+        }
+    }
+
+    return len;
+}
+
+/* State of a config file load (see clp_config()).
+ */
+struct clp_conf {
+    struct clp          *clp;
+    struct clp_option   *self;          // The option tied to clp_config()
+    bool                *cmdline;       // Options given on the command line
+    int                  depth;         // Include nesting depth
+};
+
+#define CLP_CONF_DEPTH_MAX  (8)
+
+/* Return the option of the current level whose long option name is
+ * exactly the first len bytes of name (if any).
+ */
+static struct clp_option *
+clp_longopt_find(const struct clp_level *lvl, const char *name, size_t len)
+{
+    int lb = 0, ub = lvl->longoptc;
+
+    while (lb < ub) {
+        int mid = (lb + ub) / 2;
+        const struct clp_longopt *longopt = lvl->longoptv + mid;
+        int rc = strncmp(longopt->name, name, len);
+
+        if (rc == 0 && longopt->len > len)
+            rc = 1;
+
+        if (rc == 0)
+            return lvl->optionv + longopt->optidx;
+
+        if (rc < 0)
+            lb = mid + 1;
+        else
+            ub = mid;
+    }
+
+    return NULL;
+}
+
+static int clp_conf_load(struct clp_conf *conf, int fd, const char *path);
+
+/* Apply the value of one config file entry to the given option in the
+ * same manner as had it been given on the command line, unless it was
+ * in fact given on the command line (which takes precedence).
+ */
+static int
+clp_conf_apply(struct clp_conf *conf, struct clp_option *o, char *value,
+               const char *path, int lineno, const char *key)
+{
+    struct clp *clp = conf->clp;
+    struct clp_option *x;
+    int rc;
+
+    if (o == conf->self || o->paramv) {
+        clp_eprint(clp, "%s:%d: option '%s' not allowed in config file", path, lineno, key);
+        return EX_CONFIG;
+    }
+
+    if (conf->cmdline[o - clp->optionv])
+        return 0;
+
+    if (o->argname && !value) {
+        clp_eprint(clp, "%s:%d: option '%s' requires a parameter", path, lineno, key);
+        return EX_CONFIG;
+    } else if (!o->argname && value) {
+        clp_eprint(clp, "%s:%d: option '%s' does not take a parameter", path, lineno, key);
+        return EX_CONFIG;
+    }
+
+    /* Options given on the command line silently override those
+     * from the config file which they exclude.
+     */
+    x = clp_excludes(clp->optionv, o, 1);
+    if (x && conf->cmdline[x - clp->optionv])
+        return 0;
+
+    if (x) {
+        clp_eprint(clp, "%s:%d: option -%c excludes -%c", path, lineno, x->optopt, o->optopt);
+        return EX_CONFIG;
+    }
+
+    o->longidx = -1;
+    o->optarg = value;
+    ++o->given;
+
+    if (o->cvtfunc) {
+        if (o->given > 1 && o->cvtdst) {
+            if (o->cvtfunc == clp_cvt_string) {
+                free(*(void **)o->cvtdst);
+                *(void **)o->cvtdst = NULL;
+            }
+        } else if (o->cvtdst) {
+            clp_value_reset(o->cvtfunc, o->cvtdst);
+        }
+
+        errno = 0;
+
+        rc = o->cvtfunc(clp, value, o->cvtflags, o->cvtparms, o->cvtdst);
+        if (rc > 0) {
+            clp_eprint(clp, "%s:%d: unable to convert '%s %s'", path, lineno, key, value);
+            return rc;
+        }
+    }
+
+    if (o->action) {
+        rc = o->action(o);
+        if (rc > 0)
+            return rc;
+    }
+
+    /* value refers to the mapped file, which is soon to be unmapped.
+     */
+    o->optarg = NULL;
+
+    return 0;
+}
+
+/* Parse one logical line of a config file, which is one of:
+ *
+ *   # comment
+ *   include path
+ *   longopt [[=] value]
+ *   --longopt[=value]
+ *   -x [value]
+ *
+ * Leading and trailing white space is elided from value, as are the
+ * quotes of a value enclosed in double quotes.  line must be NUL
+ * terminated and writable.
+ */
+static int
+clp_conf_line(struct clp_conf *conf, char *line, const char *path, int lineno)
+{
+    const struct clp_level *lvl = conf->clp->level;
+    struct clp_option *o = NULL;
+    char *key, *end, *value;
+    size_t keylen;
+
+    while (isspace(*line))
+        ++line;
+
+    if (!*line || *line == '#')
+        return 0;
+
+    key = line;
+
+    if (key[0] == '-' && key[1] != '-') {
+        o = clp_level_find(lvl, (unsigned char)key[1]);
+        end = key + (key[1] ? 2 : 1);
+        if (*end && !isspace(*end))
+            o = NULL;
+    } else {
+        if (key[0] == '-')
+            key += 2;
+        end = key + strcspn(key, "= \t\v\f\r");
+        if (end > key)
+            o = clp_longopt_find(lvl, key, end - key);
+    }
+
+    keylen = end - line;
+    value = end;
+
+    while (isspace(*value))
+        ++value;
+    if (*value == '=') {
+        ++value;
+        while (isspace(*value))
+            ++value;
+    }
+
+    end = value + strlen(value);
+    while (end > value && isspace(end[-1]))
+        --end;
+    if (end - value > 1 && value[0] == '"' && end[-1] == '"') {
+        ++value;
+        --end;
+    }
+    *end = '\000';
+
+    line[keylen] = '\000';
+
+    if (!o && 0 == strcmp(line, "include") && *value) {
+        char pathbuf[PATH_MAX];
+        const char *slash;
+        int fd, rc;
+
+        /* A relative include path is relative to the including file.
+         */
+        slash = strrchr(path, '/');
+        if (value[0] != '/' && slash) {
+            snprintf(pathbuf, sizeof(pathbuf), "%.*s/%s",
+                     (int)(slash - path), path, value);
+            value = pathbuf;
+        }
+
+        if (conf->depth >= CLP_CONF_DEPTH_MAX) {
+            clp_eprint(conf->clp, "%s:%d: includes nested too deeply", path, lineno);
+            return EX_CONFIG;
+        }
+
+        fd = open(value, O_RDONLY);
+        if (fd == -1) {
+            clp_eprint(conf->clp, "%s:%d: unable to open '%s'", path, lineno, value);
+            return EX_NOINPUT;
+        }
+
+        ++conf->depth;
+        rc = clp_conf_load(conf, fd, value);
+        --conf->depth;
+
+        close(fd);
+
+        return rc;
+    }
+
+    if (!o) {
+        clp_eprint(conf->clp, "%s:%d: invalid option '%s'", path, lineno, line);
+        return EX_CONFIG;
+    }
+
+    return clp_conf_apply(conf, o, *value ? value : NULL, path, lineno, line);
+}
+
+/* Load the config file open on fd.  The file is mapped privately (or
+ * read, if it's not a regular file) so that lines may be terminated and
+ * continuations joined in place.
+ */
+static int
+clp_conf_load(struct clp_conf *conf, int fd, const char *path)
+{
+    char *line, *next, *end, *last = NULL;
+    struct clp_fload fl;
+    int lineno, rc;
+
+    if (clp_fload(fd, MADV_SEQUENTIAL, &fl)) {
+        clp_eprint(conf->clp, "%s: unable to load", path);
+        return EX_IOERR;
+    }
+
+    end = fl.end;
+    lineno = 0;
+    rc = 0;
+
+    for (line = fl.base; line < end && !rc; line = next) {
+        int nlines = 1;
+        char *eol, *dst;
+
+        /* Join lines that end in a backslash by sliding each continued
+         * line over the backslash-newline that precedes it.
+         */
+        eol = memchr(line, '\n', end - line);
+        dst = eol ? eol : end;
+
+        while (eol && dst > line && dst[-1] == '\\') {
+            char *src = eol + 1;
+            size_t len;
+
+            eol = memchr(src, '\n', end - src);
+            len = (eol ? eol : end) - src;
+
+            memmove(--dst, src, len);
+            dst += len;
+            ++nlines;
+        }
+
+        next = eol ? eol + 1 : end;
+
+        if (dst < end || fl.termok) {
+            *dst = '\000'; // past EOF (within the last page if mapped)
+        } else {
+            last = strndup(line, dst - line);
+            if (!last) {
+                clp_eprint(conf->clp, "%s: unable to load", path);
+                rc = EX_OSERR;
+                break;
+            }
+            line = last;
+        }
+
+        rc = clp_conf_line(conf, line, path, lineno + 1);
+        lineno += nlines;
+    }
+
+    free(last);
+    clp_funload(&fl);
+
+    return rc;
+}
+
+/* clp_config() is the after() callback of CLP_OPTION_CONFIG(), and
+ * loads the config file opened by the option's converter.  Each entry
+ * of the file is applied via the same converters, actions, and rules
+ * of exclusion as the command line, except that options given on the
+ * command line take precedence over those given in the config file.
+ */
+int
+clp_config(struct clp_option *option)
+{
+    struct clp_conf conf;
+    FILE *fp;
+    int rc;
+
+    if (!option || !option->cvtdst)
+        return 0;
+
+    fp = *(FILE **)option->cvtdst;
+    if (!fp)
+        return 0;
+
+    struct clp *clp = option->clp;
+    bool cmdline[clp->optionc + 1];
+    struct clp_option *o;
+
+    for (size_t i = 0; i < clp->optionc; ++i)
+        cmdline[i] = (clp->optionv[i].given > 0);
+
+    conf.clp = clp;
+    conf.self = option;
+    conf.cmdline = cmdline;
+    conf.depth = 0;
+
+    rc = clp_conf_load(&conf, fileno(fp), option->optarg);
+    if (rc)
+        return rc;
+
+    /* Call the after() procedure of each option given only in the
+     * config file (those given on the command line will be called
+     * by clp_parsev() in due course).
+     */
+    for (o = clp->optionv; o->optopt > 0; ++o) {
+        if (o->given && o->after && !cmdline[o - clp->optionv]) {
+            rc = o->after(o);
+            if (rc)
+                return rc;
+        }
+    }
+
+    return 0;
+}
+
+/* Break src[] into words as per clp_breakargs(), copying the words to
+ * dst[] and storing a pointer to each in argv[] (which must have room
+ * for every word).  dst may be src, in which case the words are broken
+ * in place (each byte of src[] yields at most one byte of dst[]).
+ *
+ * If seq is true then each unquoted and unescaped ';' or "&&" ends the
+ * current word and is stored in argv[] as clp_seq_semi or clp_seq_and
+ * (see clp_table_parseseq()), so that argv[] may need room for two
+ * entries per byte of src[].
+ *
+ * Returns the number of words, or -1 if a quote is unterminated.
+ */
+static int
+clp_breakwords(const char *src, char *dst, const char *delim, char **argv, bool seq)
+{
+    bool backslash, dquote, squote;
+    const char *pc;
+    char *prev;
+    int argc;
+
+    backslash = dquote = squote = false;
+    prev = dst;
+    argc = 0;
+
+    while (1) {
+        char c = *src; // *src may be overwritten if dst is src
+
+        if (backslash) {
+            backslash = false;
+
+            /* TODO: Should we convert printf escapes or leave
+             * unconverted in dst?
+             */
+            switch (c) {
+            case 'a': *dst++ = '\a'; break;
+            case 'b': *dst++ = '\b'; break;
+            case 'f': *dst++ = '\f'; break;
+            case 'n': *dst++ = '\n'; break;
+            case 'r': *dst++ = '\r'; break;
+            case 't': *dst++ = '\t'; break;
+            case 'v': *dst++ = '\v'; break;
+
+            default:
+                if (isdigit(c)) {
+                    char *end;
+
+                    *dst++ = strtoul(src, &end, 8); // TODO: Test me...
+                    src = end;
+                    continue;
+                }
+
+                *dst++ = c;
+                break;
+            }
+        }
+        else if (c == '\\') {
+            backslash = true;
+        }
+        else if (c == '"') {
+            if (squote) {
+                *dst++ = c;
+            } else {
+                dquote = !dquote;
+            }
+        }
+        else if (c == '\'') {
+            if (dquote) {
+                *dst++ = c;
+            } else {
+                squote = !squote;
+            }
+        }
+        else if (dquote || squote) {
+            *dst++ = c;
+        }
+        else if (seq && (c == ';' || (c == '&' && src[1] == '&'))) {
+            if (dst > prev) {
+                argv[argc++] = prev;
+                *dst++ = '\000';
+                prev = dst;
+            }
+            argv[argc++] = (char *)(c == ';' ? clp_seq_semi : clp_seq_and);
+            src += (c == '&');
+        }
+        else if (!delim && (!c || isspace(c))) {
+            if (dst > prev) {
+                argv[argc++] = prev;
+                *dst++ = '\000';
+                prev = dst;
+            }
+            // else elides leading whitespace and NUL characters...
+        } else if (delim && (pc = strchr(delim, c))) {
+            if (dst > prev || !isspace(*pc)) {
+                argv[argc++] = prev;
+                *dst++ = '\000';
+                prev = dst;
+            }
+        } else {
+            *dst++ = c;
+        }
+
+        if (!c)
+            break;
+        ++src;
+    }
+
+    if (dquote || squote)
+        return -1;
+
+    if (dst > prev) {
+        argv[argc++] = prev;
+        *dst++ = '\000';
+    }
+
+    return argc;
+}
+
+/* Create a vector of strings from words in src.
+ *
+ * Words are delimited by any character from delim (or isspace() if delim
+ * is nil) and delimiters are elided.  Delimiters that are escaped by a
+ * backslash and/or occur within quoted strings lose their significance
+ * as delimiters and hence are retained with the word in which they appear.
+ *
+ * If delim is nil, then all whitespace between words is elided, which is
+ * to say that zero-length strings between delimiters are always elided.
+ * If delim is not nil, then zero-length strings between non-whitespace
+ * delimiters are always preserved.
+ *
+ * For example:
+ *
+ *    src = :one\, two,, , "four,five" :
+ *    delim = ,:
+ *
+ *    argc = 6;
+ *    argv[0] = ""
+ *    argv[1] = "one, two"
+ *    argv[2] = ""
+ *    argv[3] = " "
+ *    argv[4] = " four,five "
+ *    argv[5] = ""
+ *    argv[6] = NULL
+ *
+ * On success, argc and argv are returned via *argcp and *argvp respectively
+ * (if not nil), and argv[argc] is always set to NULL.  If argvp is not nil
+ * then *argvp must always be freed by the caller, even if *argcp is zero.
+ *
+ * On failure, errno is set and an exit code from sysexits.h is returned.
+ */
+int
+clp_breakargs(const char *src, const char *delim, int *argcp, char ***argvp)
+{
+    char **argv;
+    int argcmax, argc;
+    const char *pc;
+    size_t argvsz;
+
+    if (argcp)
+        *argcp = 0;
+    if (argvp)
+        *argvp = NULL;
+
+    if (!src) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    /* Allocate enough space to hold a pointer for every non-alpha
+     * character in src[] plus a copy of the entire source string.
+     * This will generally waste a bit of space, but it greatly
+     * simplifies cleanup.
+     */
+    argcmax = 4;
+    for (pc = src; *pc; ++pc)
+        argcmax += !isalpha(*pc);
+    argvsz = sizeof(*argv) * argcmax + (pc - src + 1);
+
+    argv = malloc(argvsz);
+    if (!argv) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    argc = clp_breakwords(src, (char *)(argv + argcmax), delim, argv, false);
+    if (argc < 0) {
+        free(argv);
+        errno = EBADMSG;
+        return EX_DATAERR;
+    }
+
+    assert(argc < argcmax);
+    argv[argc] = NULL;
+
+    if (argcp) {
+        *argcp = argc;
+    }
+    if (argvp) {
+        *argvp = argv;
+    } else {
+        free(argv);
+    }
+
+    return 0;
+}
+
+/* An incremental tokenizer (see clp_tokenizer_feed()).  Words of the
+ * current command are accumulated in buf[], each terminated by a NUL,
+ * and wordv[] records the offset of each word in buf[].
+ */
+struct clp_tokenizer {
+    char                *delim;
+    char                *buf;
+    size_t               buflen;
+    size_t               bufsz;
+    size_t               prev;          // Offset of the current word
+    size_t              *wordv;
+    int                  wordc;
+    int                  wordmax;
+    char               **argv;          // Vector given to the callback
+    bool                 backslash;
+    bool                 dquote;
+    bool                 squote;
+    bool                 empty;         // No bytes seen in this command
+    int                  octc;          // Octal digits seen in an escape
+    int                  octval;
+};
+
+/* Create a tokenizer that breaks a stream of bytes into commands as
+ * clp_breakargs() breaks a string into words, where each command is
+ * terminated by an unquoted newline.
+ *
+ * On error, sets errno and returns an exit code from sysexits.h.
+ */
+int
+clp_tokenizer_create(const char *delim, struct clp_tokenizer **tokp)
+{
+    struct clp_tokenizer *tok;
+
+    if (!tokp) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    tok = calloc(1, sizeof(*tok));
+    if (!tok) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    if (delim) {
+        tok->delim = strdup(delim);
+        if (!tok->delim) {
+            free(tok);
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+    }
+
+    tok->empty = true;
+    *tokp = tok;
+
+    return 0;
+}
+
+void
+clp_tokenizer_destroy(struct clp_tokenizer *tok)
+{
+    if (!tok)
+        return;
+
+    free(tok->delim);
+    free(tok->buf);
+    free(tok->wordv);
+    free(tok->argv);
+    free(tok);
+}
+
+static int
+clp_tokenizer_putc(struct clp_tokenizer *tok, int c)
+{
+    if (tok->buflen >= tok->bufsz) {
+        size_t bufsz = tok->bufsz ? tok->bufsz * 2 : 128;
+        char *buf;
+
+        buf = realloc(tok->buf, bufsz);
+        if (!buf) {
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        tok->buf = buf;
+        tok->bufsz = bufsz;
+    }
+
+    tok->buf[tok->buflen++] = c;
+
+    return 0;
+}
+
+/* Terminate the current word and start the next.
+ */
+static int
+clp_tokenizer_word(struct clp_tokenizer *tok)
+{
+    if (tok->wordc >= tok->wordmax) {
+        int wordmax = tok->wordmax ? tok->wordmax * 2 : 16;
+        size_t *wordv;
+
+        wordv = realloc(tok->wordv, sizeof(*wordv) * wordmax);
+        if (!wordv) {
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        tok->wordv = wordv;
+        tok->wordmax = wordmax;
+    }
+
+    tok->wordv[tok->wordc++] = tok->prev;
+    tok->prev = tok->buflen + 1;
+
+    return clp_tokenizer_putc(tok, '\000');
+}
+
+/* Finish the current command (if any) and call cb() with its words.
+ */
+static int
+clp_tokenizer_emit(struct clp_tokenizer *tok, clp_tokenizer_cb *cb, void *arg)
+{
+    char **argv;
+    int rc = 0;
+
+    if (tok->octc > 0) {
+        tok->octc = 0;
+        rc = clp_tokenizer_putc(tok, tok->octval);
+    }
+
+    /* As per clp_breakargs(), the last word is elided if it is empty,
+     * unless words are separated by a delimiter string.
+     */
+    if (!rc && !tok->empty && (tok->delim || tok->buflen > tok->prev))
+        rc = clp_tokenizer_word(tok);
+
+    if (!rc && tok->wordc > 0) {
+        argv = realloc(tok->argv, sizeof(*argv) * (tok->wordmax + 1));
+        if (!argv) {
+            errno = ENOMEM;
+            rc = EX_OSERR;
+        } else {
+            tok->argv = argv;
+
+            for (int i = 0; i < tok->wordc; ++i)
+                argv[i] = tok->buf + tok->wordv[i];
+            argv[tok->wordc] = NULL;
+
+            rc = cb(tok->wordc, argv, arg);
+        }
+    }
+
+    tok->buflen = tok->prev = 0;
+    tok->wordc = 0;
+    tok->empty = true;
+
+    return rc;
+}
+
+/* Feed len bytes of buf[] to the tokenizer, calling cb() with the argc
+ * and argv of each command as soon as it is terminated by an unquoted
+ * newline.  Quotes, backslash escapes, and partial words may span any
+ * number of calls, each byte is examined exactly once, and a backslash
+ * followed by a newline continues the command on the next line.  Words
+ * are broken as per clp_breakargs(), except that commands consisting
+ * of nothing (e.g., empty lines) are ignored, and octal escapes are
+ * limited to three digits.
+ *
+ * argv and the words to which it refers are valid only until cb()
+ * returns.  If cb() returns non-zero then the remaining bytes of buf[]
+ * are discarded and its return value is returned.
+ *
+ * On error, sets errno and returns an exit code from sysexits.h.
+ */
+int
+clp_tokenizer_feed(struct clp_tokenizer *tok, const void *buf, size_t len,
+                   clp_tokenizer_cb *cb, void *arg)
+{
+    const char *src = buf;
+    const char *pc;
+    int rc = 0;
+
+    if (!tok || (!buf && len > 0) || !cb) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    for (; len > 0 && !rc; ++src, --len) {
+        int c = (unsigned char)*src;
+
+        if (tok->octc > 0) {
+            if (tok->octc < 3 && c >= '0' && c <= '7') {
+                tok->octval = tok->octval * 8 + (c - '0');
+                ++tok->octc;
+                continue;
+            }
+
+            tok->octc = 0;
+            rc = clp_tokenizer_putc(tok, tok->octval);
+            if (rc)
+                break;
+        }
+
+        if (tok->backslash) {
+            tok->backslash = false;
+
+            switch (c) {
+            case 'a': c = '\a'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'v': c = '\v'; break;
+
+            case '\n':
+                continue; // line continuation
+
+            default:
+                if (c >= '0' && c <= '7') {
+                    tok->octval = c - '0';
+                    tok->octc = 1;
+                    continue;
+                }
+                break;
+            }
+
+            rc = clp_tokenizer_putc(tok, c);
+            continue;
+        }
+
+        if (c == '\n' && !tok->dquote && !tok->squote) {
+            rc = clp_tokenizer_emit(tok, cb, arg);
+            continue;
+        }
+
+        tok->empty = false;
+
+        if (c == '\\') {
+            tok->backslash = true;
+        }
+        else if (c == '"' && !tok->squote) {
+            tok->dquote = !tok->dquote;
+        }
+        else if (c == '\'' && !tok->dquote) {
+            tok->squote = !tok->squote;
+        }
+        else if (tok->dquote || tok->squote) {
+            rc = clp_tokenizer_putc(tok, c);
+        }
+        else if (!tok->delim && (!c || isspace(c))) {
+            if (tok->buflen > tok->prev)
+                rc = clp_tokenizer_word(tok);
+        }
+        else if (tok->delim && c && (pc = strchr(tok->delim, c))) {
+            if (tok->buflen > tok->prev || !isspace(*pc))
+                rc = clp_tokenizer_word(tok);
+        }
+        else {
+            rc = clp_tokenizer_putc(tok, c);
+        }
+    }
+
+    return rc;
+}
+
+/* Signal the end of input, calling cb() for the final command if it
+ * was not terminated by a newline.
+ *
+ * On error (e.g., an unterminated quote), sets errno and returns an
+ * exit code from sysexits.h.
+ */
+int
+clp_tokenizer_finish(struct clp_tokenizer *tok, clp_tokenizer_cb *cb, void *arg)
+{
+    if (!tok || !cb) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    if (tok->dquote || tok->squote) {
+        tok->dquote = tok->squote = tok->backslash = false;
+        tok->buflen = tok->prev = 0;
+        tok->wordc = tok->octc = 0;
+        tok->empty = true;
+        errno = EBADMSG;
+        return EX_DATAERR;
+    }
+
+    tok->backslash = false;
+
+    return clp_tokenizer_emit(tok, cb, arg);
+}
+
+/* A batch worker's private copy of the option, posparam, and subcommand
+ * vectors of a table (see clp_batch()).  The value of each option and
+ * posparam that has a converter is redirected to storage private to the
+ * copy, so that workers parsing against their copies share no state.
+ */
+struct clp_cloneval {
+    clp_cvt_cb          *cvtfunc;
+    void                *dst;           // Private value
+    void                *dflt;          // Value when the copy was made
+    size_t               sz;
+    bool                 alloced;       // dst is not the copy's cvtdstbuf[]
+};
+
+struct clp_clone {
+    struct clp_table    *table;         // Compiled from the copied vectors
+    void               **memov;         // Pairs of original and copied vectors
+    int                  memoc;
+    int                  memomax;
+    struct clp_cloneval *valv;
+    int                  valc;
+    int                  valmax;
+};
+
+/* Return the copy of the given vector, making it if necessary (in which
+ * case *isnewp is set to true).  Vectors shared by several subcommands
+ * (or that refer to themselves) are copied only once.
+ */
+static void *
+clp_clone_vec(struct clp_clone *cl, const void *orig, size_t sz, bool *isnewp)
+{
+    void *copy;
+
+    *isnewp = false;
+
+    for (int i = 0; i < cl->memoc; i += 2) {
+        if (cl->memov[i] == orig)
+            return cl->memov[i + 1];
+    }
+
+    if (cl->memoc + 2 > cl->memomax) {
+        int memomax = cl->memomax ? cl->memomax * 2 : 16;
+        void **tmp = realloc(cl->memov, sizeof(*tmp) * memomax);
+
+        if (!tmp) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        cl->memov = tmp;
+        cl->memomax = memomax;
+    }
+
+    copy = malloc(sz);
+    if (!copy) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memcpy(copy, orig, sz);
+    cl->memov[cl->memoc++] = (void *)orig;
+    cl->memov[cl->memoc++] = copy;
+    *isnewp = true;
+
+    return copy;
+}
+
+/* Redirect the value (*cvtdstp) of a copied option or posparam to
+ * private storage, i.e., to its own cvtdstbuf[] if the value fits,
+ * and remember the value's default so that it can be restored after
+ * each command (see clp_clone_reset()).
+ */
+static int
+clp_clone_value(struct clp_clone *cl, clp_cvt_cb *cvtfunc, void **cvtdstp, size_t sz,
+                unsigned char *buf, const unsigned char *origbuf, size_t bufsz)
+{
+    struct clp_cloneval *val;
+
+    if (!cvtfunc || !*cvtdstp)
+        return 0;
+
+    if (*cvtdstp == origbuf) {
+        *cvtdstp = buf;
+        sz = bufsz;
+    }
+
+    if (sz == 0) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
+
+    if (cl->valc >= cl->valmax) {
+        int valmax = cl->valmax ? cl->valmax * 2 : 16;
+        struct clp_cloneval *tmp = realloc(cl->valv, sizeof(*tmp) * valmax);
+
+        if (!tmp) {
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        cl->valv = tmp;
+        cl->valmax = valmax;
+    }
+
+    val = cl->valv + cl->valc;
+    memset(val, 0, sizeof(*val));
+
+    val->dflt = malloc(sz);
+    if (!val->dflt) {
+        errno = ENOMEM;
+        return EX_OSERR;
+    }
+
+    memcpy(val->dflt, *cvtdstp, sz);
+
+    val->dst = buf;
+    if (sz > bufsz) {
+        val->dst = malloc(sz);
+        if (!val->dst) {
+            free(val->dflt);
+            errno = ENOMEM;
+            return EX_OSERR;
+        }
+
+        val->alloced = true;
+    }
+
+    memcpy(val->dst, val->dflt, sz);
+    val->cvtfunc = cvtfunc;
+    val->sz = sz;
+    ++cl->valc;
+
+    *cvtdstp = val->dst;
+
+    return 0;
+}
+
+static int clp_clone_subcmdv(struct clp_clone *cl, struct clp_subcmd *subcmdv,
+                             struct clp_subcmd **copyp);
+
+static int
+clp_clone_paramv(struct clp_clone *cl, struct clp_posparam *paramv,
+                 struct clp_posparam **copyp)
+{
+    struct clp_posparam *copy, *param;
+    size_t paramc = 0;
+    bool isnew;
+    int rc;
+
+    *copyp = NULL;
+
+    if (!paramv)
+        return 0;
+
+    while (paramv[paramc].name)
+        ++paramc;
+
+    copy = clp_clone_vec(cl, paramv, sizeof(*paramv) * (paramc + 1), &isnew);
+    if (!copy)
+        return EX_OSERR;
+
+    *copyp = copy;
+
+    if (!isnew)
+        return 0;
+
+    for (param = copy; param->name; ++param) {
+        const struct clp_posparam *orig = paramv + (param - copy);
+        size_t sz = param->cvtsubcmd ? sizeof(struct clp_subcmd *) : param->cvtdstsz;
+
+        rc = clp_clone_value(cl, param->cvtfunc, &param->cvtdst, sz, param->cvtdstbuf,
+                             orig->cvtdstbuf, sizeof(param->cvtdstbuf));
+        if (rc)
+            return rc;
+
+        if (param->cvtsubcmd && param->cvtparms) {
+            struct clp_subcmd *subcmdv;
+
+            rc = clp_clone_subcmdv(cl, param->cvtparms, &subcmdv);
+            if (rc)
+                return rc;
+
+            param->cvtparms = subcmdv;
+        }
+    }
+
+    return 0;
+}
+
+static int
+clp_clone_optionv(struct clp_clone *cl, struct clp_option *optionv,
+                  struct clp_option **copyp)
+{
+    struct clp_option *copy, *o;
+    size_t optionc = 0;
+    bool isnew;
+    int rc;
+
+    *copyp = NULL;
+
+    if (!optionv)
+        return 0;
+
+    while (optionv[optionc].optopt > 0)
+        ++optionc;
+
+    copy = clp_clone_vec(cl, optionv, sizeof(*optionv) * (optionc + 1), &isnew);
+    if (!copy)
+        return EX_OSERR;
+
+    *copyp = copy;
+
+    if (!isnew)
+        return 0;
+
+    for (o = copy; o->optopt > 0; ++o) {
+        const struct clp_option *orig = optionv + (o - copy);
+
+        rc = clp_clone_value(cl, o->cvtfunc, &o->cvtdst, o->cvtdstsz, o->cvtdstbuf,
+                             orig->cvtdstbuf, sizeof(o->cvtdstbuf));
+        if (rc)
+            return rc;
+
+        rc = clp_clone_paramv(cl, o->paramv, &o->paramv);
+        if (rc)
+            return rc;
+    }
+
+    return 0;
+}
+
+static int
+clp_clone_subcmdv(struct clp_clone *cl, struct clp_subcmd *subcmdv,
+                  struct clp_subcmd **copyp)
+{
+    struct clp_subcmd *copy, *subcmd;
+    size_t subc = 0;
+    bool isnew;
+    int rc;
+
+    while (subcmdv[subc].name)
+        ++subc;
+
+    copy = clp_clone_vec(cl, subcmdv, sizeof(*subcmdv) * (subc + 1), &isnew);
+    if (!copy)
+        return EX_OSERR;
+
+    *copyp = copy;
+
+    if (!isnew)
+        return 0;
+
+    for (subcmd = copy; subcmd->name; ++subcmd) {
+        rc = clp_clone_optionv(cl, subcmd->optionv, &subcmd->optionv);
+        if (rc)
+            return rc;
+
+        rc = clp_clone_paramv(cl, subcmd->posparamv, &subcmd->posparamv);
+        if (rc)
+            return rc;
+    }
+
+    return 0;
+}
+
+static void
+clp_clone_destroy(struct clp_clone *cl)
+{
+    clp_table_destroy(cl->table);
+
+    for (int i = 0; i < cl->valc; ++i) {
+        if (cl->valv[i].alloced)
+            free(cl->valv[i].dst);
+        free(cl->valv[i].dflt);
+    }
+
+    for (int i = 1; i < cl->memoc; i += 2)
+        free(cl->memov[i]);
+
+    free(cl->valv);
+    free(cl->memov);
+    memset(cl, 0, sizeof(*cl));
+}
+
+/* Copy the vectors of the given table and compile the copies.
+ */
+static int
+clp_clone_create(struct clp_table *table, struct clp_clone *cl)
+{
+    struct clp_posparam *paramv;
+    struct clp_option *optionv;
+    int rc;
+
+    memset(cl, 0, sizeof(*cl));
+
+    rc = clp_clone_optionv(cl, table->root->optionv, &optionv);
+    if (!rc)
+        rc = clp_clone_paramv(cl, table->root->paramv, &paramv);
+    if (!rc)
+        rc = clp_table_create(optionv, paramv, &cl->table);
+    if (rc)
+        clp_clone_destroy(cl);
+
+    return rc;
+}
+
+/* Restore each private value changed by the last command to its default,
+ * releasing the strings and files of the values replaced.
+ */
+static void
+clp_clone_reset(struct clp_clone *cl)
+{
+    for (int i = 0; i < cl->valc; ++i) {
+        struct clp_cloneval *val = cl->valv + i;
+
+        if (0 == memcmp(val->dst, val->dflt, val->sz))
+            continue;
+
+        clp_value_release(val->cvtfunc, val->dst);
+        memcpy(val->dst, val->dflt, val->sz);
+    }
+}
+
+#define CLP_BATCH_LINES     (256)   // Lines per chunk of a batch
+
+struct clp_batch_res {
+    long                 lineno;
+    int                  rc;
+    char                *msg;           // Error message (if any)
+};
+
+/* A batch is split into chunks of CLP_BATCH_LINES lines, and a chunk is
+ * the unit of work taken (or stolen) by a worker.  The results of each
+ * command of a chunk are kept with the chunk until delivered.
+ */
+struct clp_batch_chunk {
+    const char          *line;          // First line of the chunk
+    const char          *end;
+    long                 lineno;        // Line number of the first line
+    struct clp_batch_res *resv;
+    int                  resc;
+    bool                 done;
+};
+
+struct clp_batch;
+
+/* Each worker owns every workerc'th chunk (starting with chunk idx),
+ * which it takes from the head of its deque in order, whereas idle
+ * workers steal from the tail.  The head and tail are packed into one
+ * word so that both may be updated by a single compare-and-swap.
+ */
+struct clp_batch_worker {
+    uint64_t             range;         // Head (low) and tail (high) of deque
+    struct clp_batch    *batch;
+    struct clp_clone     clone;
+    int                  idx;
+    bool                 started;
+    pthread_t            tid;
+    char                *buf;           // Copy of the current line
+    char               **argv;
+    size_t               argvmax;
+} __attribute__((__aligned__(64)));
+
+struct clp_batch {
+    const char          *base;
+    const char          *end;
+    const char          *path;          // For error messages (may be nil)
+    const char          *delim;
+    const char          *progname;
+    int                  flags;
+    clp_batch_cb        *cb;
+    void                *arg;
+    struct clp_batch_chunk *chunkv;
+    long                 chunkc;
+    struct clp_batch_worker *workerv;
+    int                  workerc;
+    bool                 cancel;
+
+    pthread_mutex_t      mtx;           // Serializes delivery of results
+    long                 next;          // Next chunk to deliver (if ordered)
+    long                 errline;       // Lowest numbered line in error
+    int                  errcode;       // Result of errline
+    int                  cbrc;          // First non-zero result of cb()
+    int                  oserr;         // Set if a worker ran out of memory
+};
+
+/* Split the batch into chunks, numbering their lines.
+ */
+static int
+clp_batch_split(struct clp_batch *batch)
+{
+    const char *line = batch->base;
+    long chunkmax = 0, lineno = 1;
+
+    while (line < batch->end) {
+        struct clp_batch_chunk *chunk;
+
+        if (batch->chunkc >= chunkmax) {
+            long n = chunkmax ? chunkmax * 2 : 1024;
+            struct clp_batch_chunk *tmp = realloc(batch->chunkv, sizeof(*tmp) * n);
+
+            if (!tmp) {
+                errno = ENOMEM;
+                return EX_OSERR;
+            }
+
+            batch->chunkv = tmp;
+            chunkmax = n;
+        }
+
+        chunk = batch->chunkv + batch->chunkc++;
+        memset(chunk, 0, sizeof(*chunk));
+        chunk->line = line;
+        chunk->lineno = lineno;
+
+        for (int i = 0; i < CLP_BATCH_LINES && line < batch->end; ++i, ++lineno) {
+            const char *eol = memchr(line, '\n', batch->end - line);
+
+            line = eol ? eol + 1 : batch->end;
+        }
+
+        chunk->end = line;
+    }
+
+    return 0;
+}
+
+/* Parse one command against the worker's private table, returning the
+ * formatted error message (if any) via *msgp.
+ */
+static int
+clp_batch_parse(struct clp_batch_worker *wkr, int argc, char **argv, char **msgp)
+{
+    struct clp_error err;
+    struct clp clp;
+    int rc;
+
+    memset(&clp, 0, sizeof(clp));
+    clp.table = wkr->clone.table;
+    clp.level = clp.table->root;
+    clp.argv = argv;
+    clp.error = &err;
+    err.code = 0;
+    err.kind = CLP_ERR_NONE;
+
+    rc = clp_parsev_impl(&clp, argc, argv);
+    rc = clp_async_collect(&clp, rc, NULL, NULL);
+
+    if (rc && err.kind != CLP_ERR_NONE) {
+        char msg[CLP_ERRBUF_MAX * 2];
+
+        clp_error_format(&err, msg, sizeof(msg));
+        if (msg[0]) {
+            size_t sz = strlen(err.basename) + strlen(msg) + 3;
+
+            *msgp = malloc(sz);
+            if (*msgp)
+                snprintf(*msgp, sz, "%s: %s", err.basename, msg);
+        }
+    }
+
+    return rc;
+}
+
+/* Parse each command line of the given chunk, recording the results
+ * in the chunk.
+ */
+static int
+clp_batch_run(struct clp_batch_worker *wkr, struct clp_batch_chunk *chunk)
+{
+    struct clp_batch *batch = wkr->batch;
+    int n = batch->progname ? 1 : 0;
+    const char *line, *next;
+    long lineno;
+
+    chunk->resv = malloc(sizeof(*chunk->resv) * CLP_BATCH_LINES);
+    if (!chunk->resv)
+        return EX_OSERR;
+
+    lineno = chunk->lineno;
+
+    for (line = chunk->line; line < chunk->end; line = next, ++lineno) {
+        const char *eol = memchr(line, '\n', chunk->end - line);
+        size_t len = (eol ? eol : chunk->end) - line;
+        struct clp_batch_res *res;
+        const char *pc;
+        int argc;
+
+        next = eol ? eol + 1 : chunk->end;
+
+        for (pc = line; pc < line + len && isspace((unsigned char)*pc); ++pc)
+            continue;
+        if (pc == line + len || *pc == '#')
+            continue;
+
+        /* Every word consumes at least one byte of the line.
+         */
+        if (len + 4 > wkr->argvmax) {
+            char **argv = realloc(wkr->argv, sizeof(*argv) * (len + 4));
+            char *buf;
+
+            if (!argv)
+                return EX_OSERR;
+            wkr->argv = argv;
+
+            buf = realloc(wkr->buf, len + 4);
+            if (!buf)
+                return EX_OSERR;
+            wkr->buf = buf;
+
+            wkr->argvmax = len + 4;
+        }
+
+        memcpy(wkr->buf, line, len);
+        wkr->buf[len] = '\000';
+        wkr->argv[0] = (char *)batch->progname;
+
+        argc = clp_breakwords(wkr->buf, wkr->buf, batch->delim, wkr->argv + n, false);
+        if (argc == 0 && n == 0)
+            continue;
+
+        res = chunk->resv + chunk->resc++;
+        res->lineno = lineno;
+        res->msg = NULL;
+
+        if (argc < 0) {
+            res->rc = EX_DATAERR;
+            res->msg = strdup("unterminated quote");
+            continue;
+        }
+
+        argc += n;
+        wkr->argv[argc] = NULL;
+
+        res->rc = clp_batch_parse(wkr, argc, wkr->argv, &res->msg);
+
+        clp_clone_reset(&wkr->clone);
+    }
+
+    return 0;
+}
+
+/* Deliver the results of the given chunk to the batch's callback (or
+ * print the errors to stderr if there is no callback).  Called with
+ * the batch mutex held.
+ */
+static void
+clp_batch_deliver(struct clp_batch *batch, struct clp_batch_chunk *chunk)
+{
+    for (int i = 0; i < chunk->resc; ++i) {
+        struct clp_batch_res *res = chunk->resv + i;
 
-                for (subcmd = param->cvtparms; subcmd->name; ++subcmd) {
-                    subcmd->help = clp_trim(subcmd->help);
-                    if (subcmd->help) {
-                        fprintf(fp, "%s%s", comma, subcmd->name);
-                        comma = ", ";
-                    }
-                }
-                fprintf(fp, "}\n");
-            }
+        if (res->rc && (!batch->errline || res->lineno < batch->errline)) {
+            batch->errline = res->lineno;
+            batch->errcode = res->rc;
+        }
 
-            for (subcmd = param->cvtparms; subcmd->name; ++subcmd) {
-                if (subcmd->help)
-                    fprintf(fp, "  %-*s  %s\n", subcmd_width, subcmd->name, subcmd->help);
-            }
+        if (batch->cbrc) {
+            ;
+        } else if (batch->cb) {
+            batch->cbrc = batch->cb(res->lineno, res->rc, res->msg, batch->arg);
+            if (batch->cbrc)
+                __atomic_store_n(&batch->cancel, true, __ATOMIC_RELAXED);
+        } else if (res->msg) {
+            if (batch->path)
+                fprintf(stderr, "%s:%ld: %s\n", batch->path, res->lineno, res->msg);
+            else
+                fprintf(stderr, "line %ld: %s\n", res->lineno, res->msg);
         }
+
+        free(res->msg);
     }
 
-    return 0;
+    free(chunk->resv);
+    chunk->resv = NULL;
+    chunk->resc = 0;
 }
 
-/* Determine the minimum and maximum number of arguments that the
- * given posparam vector could consume.
- */
 static void
-clp_posparam_minmax(struct clp_posparam *paramv, int *posminp, int *posmaxp)
+clp_batch_complete(struct clp_batch *batch, struct clp_batch_chunk *chunk, int rc)
 {
-    struct clp_posparam *param;
+    pthread_mutex_lock(&batch->mtx);
 
-    if (!paramv || !posminp || !posmaxp) {
-        abort();
+    if (rc) {
+        batch->oserr = rc;
+        __atomic_store_n(&batch->cancel, true, __ATOMIC_RELAXED);
     }
 
-    *posminp = 0;
-    *posmaxp = 0;
+    if (batch->flags & CLP_BATCH_ORDERED) {
+        chunk->done = true;
 
-    for (param = paramv; param->name; ++param) {
-        struct clp_subcmd *subcmd = clp_subcmd(param);
-        char namebuf[128];
-        int isoptional;
-        int len;
+        while (batch->next < batch->chunkc && batch->chunkv[batch->next].done)
+            clp_batch_deliver(batch, batch->chunkv + batch->next++);
+    } else {
+        clp_batch_deliver(batch, chunk);
+    }
 
-        isoptional = clp_unbracket(param->name, namebuf, sizeof(namebuf));
+    pthread_mutex_unlock(&batch->mtx);
+}
+
+/* Take a chunk from the head of the victim's deque (if the victim is
+ * the caller) or steal one from its tail.  Returns the index of the
+ * chunk, or -1 if the victim's deque is empty.
+ */
+static long
+clp_batch_take(struct clp_batch *batch, struct clp_batch_worker *victim, bool steal)
+{
+    uint64_t old, new;
+    uint32_t head, tail;
 
-        param->posmin = isoptional ? 0 : 1;
+    old = __atomic_load_n(&victim->range, __ATOMIC_RELAXED);
 
-        len = strlen(namebuf);
-        if (len >= 3 && 0 == strncmp(namebuf + len - 3, "...", 3)) {
-            param->posmax = CLP_POSPARAM_MAX;
-        } else {
-            param->posmax = subcmd ? CLP_POSPARAM_MAX : 1;
-        }
+    do {
+        head = old;
+        tail = old >> 32;
 
-        *posminp += param->posmin;
-        *posmaxp += param->posmax;
+        if (head >= tail)
+            return -1;
 
-        if (subcmd)
+        if (steal)
+            new = head | ((uint64_t)--tail << 32);
+        else
+            new = ++head | ((uint64_t)tail << 32);
+    } while (!__atomic_compare_exchange_n(&victim->range, &old, new, false,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    return (long)(steal ? tail : head - 1) * batch->workerc + victim->idx;
+}
+
+static void *
+clp_batch_main(void *arg)
+{
+    struct clp_batch_worker *wkr = arg;
+    struct clp_batch *batch = wkr->batch;
+
+    while (!__atomic_load_n(&batch->cancel, __ATOMIC_RELAXED)) {
+        long idx = clp_batch_take(batch, wkr, false);
+        int rc;
+
+        for (int i = 1; idx < 0 && i < batch->workerc; ++i)
+            idx = clp_batch_take(batch, batch->workerv + (wkr->idx + i) % batch->workerc, true);
+
+        if (idx < 0)
             break;
+
+        rc = clp_batch_run(wkr, batch->chunkv + idx);
+
+        clp_batch_complete(batch, batch->chunkv + idx, rc);
     }
+
+    return NULL;
 }
 
 static int
-clp_parsev_impl(struct clp *clp, int argc, char **argv)
+clp_batch_impl(struct clp_table *table, const char *buf, size_t len, const char *path,
+               const char *delim, const char *progname, int nthreads, int flags,
+               clp_batch_cb *cb, void *arg)
 {
-    struct clp_option *options_head, **options_tail;
-    struct clp_posparam **params_tail;
-    struct clp_posparam *paramv;
-    struct clp_option *o;
-    int posmin, posmax;
-    char *pc;
+    struct clp_batch batch;
+    long nprocs;
     int rc;
 
-    params_tail = &clp->params;
-    if (*params_tail) {
-        params_tail = &(*params_tail)->next;
+    clp_debug_init();
+
+    memset(&batch, 0, sizeof(batch));
+    batch.base = buf;
+    batch.end = buf + len;
+    batch.path = path;
+    batch.delim = delim;
+    batch.progname = progname;
+    batch.flags = flags;
+    batch.cb = cb;
+    batch.arg = arg;
+
+    rc = clp_batch_split(&batch);
+    if (rc || batch.chunkc == 0)
+        goto errout;
+
+    if (nthreads < 1) {
+        nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (nprocs > 0) ? nprocs : 1;
     }
 
-    options_tail = &options_head;
-    *options_tail = NULL;
+    batch.workerc = MIN(nthreads, batch.chunkc);
 
-    pc = clp->optstring;
-    *pc++ = '+';    // Enable POSIXLY_CORRECT semantics
-    *pc++ = ':';    // Disable getopt error reporting
-    *pc = '\000';
+    batch.workerv = aligned_alloc(__alignof__(*batch.workerv),
+                                  sizeof(*batch.workerv) * batch.workerc);
+    if (!batch.workerv) {
+        errno = ENOMEM;
+        rc = EX_OSERR;
+        goto errout;
+    }
 
-    /* Generate the optstring and the long options table
-     * from the given vector of options.
-     */
-    if (clp->optionv) {
-        struct option *longopt = clp->longopts;
+    memset(batch.workerv, 0, sizeof(*batch.workerv) * batch.workerc);
 
-        for (o = clp->optionv; o->optopt > 0; ++o) {
-            if (!clp_optopt_valid(o->optopt)) {
-                clp_dprint(1, "invalid option %d (index %ld) ignored\n",
-                           o->optopt, o - clp->optionv);
-                continue;
-            }
+    for (int i = 0; i < batch.workerc; ++i) {
+        struct clp_batch_worker *wkr = batch.workerv + i;
+        uint64_t tail = (batch.chunkc - i + batch.workerc - 1) / batch.workerc;
 
-            if (strchr(clp->optstring + 2, o->optopt)) {
-                clp_dprint(1, "duplicate option %d (index %ld) ignored\n",
-                           o->optopt, o - clp->optionv);
-                continue;
-            }
+        wkr->batch = &batch;
+        wkr->idx = i;
+        wkr->range = tail << 32;
+    }
 
-            *pc++ = o->optopt;
-            if (o->argname)
-                *pc++ = ':';
-            *pc = '\000';
+    for (int i = 0; i < batch.workerc && !rc; ++i)
+        rc = clp_clone_create(table, &batch.workerv[i].clone);
+    if (rc)
+        goto errout;
 
-            if (o->longopt) {
-                longopt->name = o->longopt;
-                longopt->val = o->optopt;
-                longopt->has_arg = o->argname ? required_argument : no_argument;
+    pthread_mutex_init(&batch.mtx, NULL);
 
-                ++longopt;
-            }
+    /* The caller is worker zero.  The chunks of any worker that
+     * fails to start are simply stolen by the others.
+     */
+    for (int i = 1; i < batch.workerc; ++i) {
+        struct clp_batch_worker *wkr = batch.workerv + i;
 
-            if (o->paramv) {
-                *params_tail = o->paramv;
-                params_tail = &o->paramv->next;
-                *params_tail = NULL;
-            }
-        }
+        wkr->started = !pthread_create(&wkr->tid, NULL, clp_batch_main, wkr);
+    }
 
-        if (longopt > clp->longopts) {
-            memset(longopt, 0, sizeof(*longopt));
-            *pc++ = 'W';
-            *pc++ = ';';
-            *pc = '\000';
-        }
+    clp_batch_main(batch.workerv);
+
+    for (int i = 1; i < batch.workerc; ++i) {
+        if (batch.workerv[i].started)
+            pthread_join(batch.workerv[i].tid, NULL);
     }
 
-    char usehelp[] = ", use -h for help";
-    if (clp->opthelp > 0) {
-        usehelp[7] = clp->opthelp;
+    pthread_mutex_destroy(&batch.mtx);
+
+    if (batch.oserr) {
+        errno = ENOMEM;
+        rc = batch.oserr;
     } else {
-        usehelp[0] = '\000';
+        rc = batch.cbrc ? batch.cbrc : batch.errcode;
     }
 
-    options_tail = &options_head;
-    *options_tail = NULL;
+  errout:
+    for (int i = 0; batch.workerv && i < batch.workerc; ++i) {
+        struct clp_batch_worker *wkr = batch.workerv + i;
 
-    paramv = clp->paramv;
+        if (wkr->clone.table || wkr->clone.memov)
+            clp_clone_destroy(&wkr->clone);
+        free(wkr->argv);
+        free(wkr->buf);
+    }
 
-    /* Reset getopt_long()...
-     */
-#ifdef _OPTRESET_DECLARED
-    optreset = 1;
-#endif
+    for (long i = 0; i < batch.chunkc; ++i) {
+        struct clp_batch_chunk *chunk = batch.chunkv + i;
 
-    optind = 1;
+        for (int j = 0; j < chunk->resc; ++j)
+            free(chunk->resv[j].msg);
+        free(chunk->resv);
+    }
 
-    while (1) {
-        struct clp_option *x;
-        int curind = optind;
-        int longidx = -1;
-        int c;
+    free(batch.workerv);
+    free(batch.chunkv);
 
-        errno = 0;
+    return rc;
+}
 
-        c = getopt_long(argc, argv, clp->optstring, clp->longopts, &longidx);
+/* Parse each command line in buf[] (of length len) against the given
+ * table, in parallel on nthreads threads (or on one thread per online
+ * CPU if nthreads is less than one).  Lines are broken into words and
+ * blank and comment lines are skipped as per clp_parsefile().
+ *
+ * Each worker parses against its own copy of the table's vectors, in
+ * which the value of every option and posparam that has a converter is
+ * private to the worker and is reset to its default after each command.
+ * Hence callbacks must access values only via their option or param
+ * argument (e.g., via option->cvtdst, param->cvtdst, or clp_value() and
+ * clp_given() given param->clp), never via the variables named by the
+ * vectors (which are neither set nor read by the workers), and callbacks
+ * run concurrently so must be thread safe.  The global optind is not set
+ * by clp_batch() nor by any other parse of a table.  Strings and
+ * files left in a private value by a command are released when its
+ * callbacks return, unless a callback restores the default value (e.g.,
+ * sets it to nil).  Every option and posparam that has a converter
+ * must have a known cvtdstsz (e.g., as set by CLP_OPTION()), and note
+ * that the len of a vector given as cvtparms is shared by all workers.
+ *
+ * cb() is called with the result of each command (one call at a time),
+ * in the order of the lines if flags includes CLP_BATCH_ORDERED, or as
+ * chunks of lines complete otherwise.  If cb() returns non-zero then no
+ * further commands are started and clp_batch() returns that value.  If
+ * cb is nil then errors are printed to stderr.
+ *
+ * Returns zero if every command succeeded, otherwise the result of the
+ * lowest numbered line in error.  On error, sets errno and returns a
+ * suggested exit code from sysexits.h.
+ */
+int
+clp_batch(struct clp_table *table, const char *buf, size_t len,
+          const char *delim, const char *progname, int nthreads, int flags,
+          clp_batch_cb *cb, void *arg)
+{
+    if (!table || (!buf && len > 0)) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-        if (-1 == c) {
-            break;
-        } else if ('?' == c) {
-            clp_eprint(clp, "invalid option %s%s", argv[curind], usehelp);
-            return EX_USAGE;
-        } else if (':' == c) {
-            clp_eprint(clp, "option %s requires a parameter%s", argv[curind], usehelp);
-            return EX_USAGE;
-        }
+    return clp_batch_impl(table, buf, len, NULL, delim, progname, nthreads, flags, cb, arg);
+}
 
-        /* Look up the option.  This should not fail unless someone perturbs
-         * the option vector that was passed in to us.
-         */
-        o = clp_find(c, clp->optionv);
-        if (!o) {
-            clp_eprint(clp, "+%d %s: program error: unexpected option %s",
-                       __LINE__, __FILE__, argv[curind]);
-            return EX_SOFTWARE;
-        }
+/* Like clp_batch(), but parses the lines of the file at path (which is
+ * read into a buffer if it can't be mapped, e.g., a pipe).
+ */
+int
+clp_batchfile(struct clp_table *table, const char *path,
+              const char *delim, const char *progname, int nthreads, int flags,
+              clp_batch_cb *cb, void *arg)
+{
+    struct clp_fload fl;
+    int rc, fd;
 
-        /* See if this option is excluded by any other option given so far...
-         */
-        x = clp_excludes(clp->optionv, o, 1);
-        if (x) {
-            clp_eprint(clp, "option -%c excludes -%c%s", x->optopt, c, usehelp);
-            return EX_USAGE;
-        }
+    if (!table || !path) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-        /* Build a list of after procs to run after option processing
-         */
-        if (o->after && !o->given) {
-            o->next = NULL;
-            *options_tail = o;
-            options_tail = &o->next;
-        }
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return EX_NOINPUT;
 
-        o->longidx = longidx;
-        o->optarg = optarg;
-        ++o->given;
+    rc = clp_fload(fd, MADV_WILLNEED, &fl);
+    close(fd);
 
-        if (o->paramv)
-            paramv = o->paramv;
+    if (rc)
+        return EX_IOERR;
 
-        if (o->cvtfunc) {
-            if (o->given > 1 && o->cvtdst) {
-                if (o->cvtfunc == clp_cvt_string) {
-                    free(*(void **)o->cvtdst);
-                    *(void **)o->cvtdst = NULL;
-                }
-            }
+    rc = clp_batch_impl(table, fl.base, fl.end - fl.base, path, delim, progname,
+                        nthreads, flags, cb, arg);
 
-            rc = o->cvtfunc(clp, optarg, o->cvtflags, o->cvtparms, o->cvtdst);
-            if (rc) {
-                if (rc > 0) {
-                    char optstr[] = { o->optopt, '\000' };
+    clp_funload(&fl);
 
-                    clp_eprint(clp, "unable to convert '%s%s %s'",
-                               (longidx >= 0) ? "--" : "-",
-                               (longidx >= 0) ? o->longopt : optstr,
-                               optarg);
-                }
+    return rc;
+}
 
-                return (rc > 0) ? rc : 0;
-            }
-        }
+/* A command frame sent by clp_client() to clp_serve() consists of a
+ * header followed by argc length-prefixed arguments, each of which
+ * includes its NUL terminator (so that the server need copy nothing).
+ * The client's stdin, stdout, and stderr are passed along with the
+ * first bytes of the frame, and the server replies with the command's
+ * exit code once the command completes.
+ */
+struct clp_frame {
+    uint32_t             magic;
+    uint32_t             argc;
+    uint32_t             size;          // Bytes of arguments after the header
+};
 
-        if (o->action) {
-            rc = o->action(o);
-            if (rc)
-                return (rc > 0) ? rc : 0;
-        }
+#define CLP_FRAME_MAGIC     (0x434c5046u)   // "CLPF"
+#define CLP_FRAME_MAX       (1u << 20)      // Max size of a frame's arguments
+
+/* A connection to clp_serve() from clp_client().
+ */
+struct clp_conn {
+    int                  fd;
+    int                  stdiov[3];     // Client's stdin, stdout, and stderr
+    unsigned long        id;            // Token of the connection's pending command
+    bool                 pending;       // A command is awaiting completion
+    struct clp_frame     hdr;
+    size_t               len;           // Bytes of the frame received so far
+    char                *buf;           // Arguments of the frame
+    char               **argv;          // Words of the frame (until the reply)
+};
+
+static void
+clp_conn_stdio_close(struct clp_conn *conn)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (conn->stdiov[i] != -1)
+            close(conn->stdiov[i]);
+        conn->stdiov[i] = -1;
     }
+}
 
-    posmin = posmax = 0;
-    argc -= optind;
-    argv += optind;
+static void
+clp_conn_close(struct clp_conn *conn)
+{
+    clp_conn_stdio_close(conn);
+    close(conn->fd);
+    free(conn->argv);
+    free(conn->buf);
+    conn->fd = -1;
+    conn->argv = NULL;
+    conn->buf = NULL;
+}
 
-    /* Only check positional parameter counts if paramv is not NULL.
-     * This allows the caller to prevent parameter processing by clp
-     * and handle it themselves.
+/* Send the exit code of the connection's command to the client.
+ */
+static int
+clp_conn_reply(struct clp_conn *conn, int rc)
+{
+    uint32_t code = rc;
+
+    clp_conn_stdio_close(conn);
+    free(conn->argv);
+    conn->argv = NULL;
+    conn->pending = false;
+
+    if (send(conn->fd, &code, sizeof(code), MSG_NOSIGNAL) != sizeof(code))
+        return EX_IOERR;
+
+    return 0;
+}
+
+/* Run the command of the given complete frame with the client's stdio
+ * in place of the server's own, and send the exit code to the client
+ * (unless the command is pending, in which case the reply is sent when
+ * it completes).
+ */
+static int
+clp_conn_dispatch(struct clp_table *table, struct clp_conn *conn, const int *savev,
+                  struct clp_asyncq *q)
+{
+    int argc = conn->hdr.argc;
+    uint32_t len;
+    size_t off = 0;
+    char **argv;
+    int rc = 0;
+
+    /* argv[] must remain valid until a pending command completes.
      */
-    if (paramv) {
-        clp_posparam_minmax(paramv, &posmin, &posmax);
+    argv = malloc(sizeof(*argv) * (argc + 1));
+    if (!argv)
+        return EX_OSERR;
 
-        if (argc < posmin) {
-            const char *more = argc ? " more" : "";
+    free(conn->argv);
+    conn->argv = argv;
 
-            clp_eprint(clp, "%d%s positional argument%s required%s",
-                       posmin - argc,
-                       (posmin - argc) > 0 ? more : "",
-                       (posmin - argc) > 1 ? "s" : "",
-                       usehelp);
-            return EX_USAGE;
-        }
-        else if (argc > posmax) {
-            clp_eprint(clp, "%d extraneous positional argument%s detected%s",
-                       argc - posmax,
-                       argc - posmax > 1 ? "s" : "",
-                       usehelp);
-            return EX_USAGE;
-        }
+    for (int i = 0; i < argc; ++i) {
+        if (off + sizeof(len) > conn->hdr.size)
+            return EX_PROTOCOL;
+
+        memcpy(&len, conn->buf + off, sizeof(len));
+        off += sizeof(len);
+
+        if (len == 0 || len > conn->hdr.size - off || conn->buf[off + len - 1])
+            return EX_PROTOCOL;
+
+        argv[i] = conn->buf + off;
+        off += len;
     }
 
-    /* Call each given option's after() procedure now that all options have
-     * been processed and the command line syntax has been verified.
-     */
-    while (options_head) {
-        rc = options_head->after(options_head);
-        if (rc)
-            return (rc > 0) ? rc : 0;
+    argv[argc] = NULL;
+
+    fflush(stdout);
+    fflush(stderr);
 
-        options_head = options_head->next;
+    for (int i = 0; i < 3; ++i) {
+        if (conn->stdiov[i] != -1)
+            dup2(conn->stdiov[i], i);
     }
 
-    if (paramv) {
-        struct clp_posparam *param;
-        int i;
+    clearerr(stdin);
 
-        /* Distribute the remaining arguments to the positional parameters
-         * using a greedy approach.
-         */
-        for (param = paramv; param->name && argc > 0; ++param) {
-            param->argv = argv;
-            param->argc = 0;
+    if (argc > 0)
+        rc = clp_table_parsev_async(table, argc, argv, q, (void *)(uintptr_t)conn->id);
 
-            if (param->posmin == 1) {
-                param->argc = 1;
-                if (param->posmax > 1) {
-                    param->argc += argc - posmin;
-                }
-                --posmin;
-            }
-            else if (argc > posmin) {
-                if (param->posmax > 1) {
-                    param->argc = argc - posmin;
-                } else {
-                    param->argc = 1;
-                }
-            }
+    fflush(stdout);
+    fflush(stderr);
+    fflush(stdin);
 
-            clp_dprint(1, "argc=%d posmin=%d argv=%s param=%s %d,%d,%d\n",
-                       argc, posmin, *argv, param->name, param->posmin,
-                       param->posmax, param->argc);
+    for (int i = 0; i < 3; ++i) {
+        if (savev[i] != -1)
+            dup2(savev[i], i);
+        else if (conn->stdiov[i] != -1)
+            close(i);
+    }
 
-            argv += param->argc;
-            argc -= param->argc;
+    clearerr(stdin);
+    clearerr(stdout);
+    clearerr(stderr);
 
-            if (clp_subcmd(param))
-                break;
-        }
+    /* The frame, argv[], and the client's stdio are retained until the
+     * pending command completes.
+     */
+    if (rc == CLP_PENDING) {
+        conn->pending = true;
+        return 0;
+    }
 
-        if (argc > 0) {
-            clp_dprint(1, "args left over: argc=%d posmin=%d argv=%s\n",
-                       argc, posmin, *argv);
-        }
+    return clp_conn_reply(conn, rc);
+}
 
-        /* Call each parameter's convert() procedure for each given argument.
-         */
-        for (param = paramv; param->name; ++param) {
-            for (i = 0; i < param->argc; ++i) {
-                if (param->cvtfunc) {
-                    rc = param->cvtfunc(clp, param->argv[i], param->cvtflags,
-                                        param->cvtparms, param->cvtdst);
-                    if (rc) {
-                        if (rc > 0)
-                            clp_eprint(clp, "unable to convert '%s'", param->argv[i]);
-                        return (rc > 0) ? rc : 0;
-                    }
-                }
+/* Receive what is available of the connection's current frame (and any
+ * file descriptors passed with it), dispatching the frame once it has
+ * been received in full.  Returns zero if the connection should remain
+ * open.
+ */
+static int
+clp_conn_recv(struct clp_table *table, struct clp_conn *conn, const int *savev,
+              struct clp_asyncq *q)
+{
+    union {
+        struct cmsghdr   hdr;
+        char             buf[CMSG_SPACE(sizeof(int) * 3)];
+    } cmsg;
+    struct cmsghdr *cmp;
+    struct msghdr msg;
+    struct iovec iov;
+    size_t hdrsz = sizeof(conn->hdr);
+    ssize_t cc;
+    int rc;
 
-                if (param->action) {
-                    rc = param->action(param);
-                    if (rc)
-                        return (rc > 0) ? rc : 0;
-                }
-            }
-        }
+    if (conn->len < hdrsz) {
+        iov.iov_base = (char *)&conn->hdr + conn->len;
+        iov.iov_len = hdrsz - conn->len;
+    } else {
+        iov.iov_base = conn->buf + (conn->len - hdrsz);
+        iov.iov_len = conn->hdr.size - (conn->len - hdrsz);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+
+    cc = recvmsg(conn->fd, &msg, MSG_DONTWAIT);
+    if (cc == -1)
+        return (errno == EAGAIN || errno == EINTR) ? 0 : EX_IOERR;
+
+    for (cmp = CMSG_FIRSTHDR(&msg); cmp; cmp = CMSG_NXTHDR(&msg, cmp)) {
+        int n = (cmp->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int fdv[n + 1];
 
-        /* Call each filled parameter's after() procedure.
-         */
-        for (param = paramv; param->name; ++param) {
-            if (param->after && param->argc > 0) {
-                rc = param->after(param);
-                if (rc)
-                    return (rc > 0) ? rc : 0;
-            }
+        if (cmp->cmsg_level != SOL_SOCKET || cmp->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        memcpy(fdv, CMSG_DATA(cmp), sizeof(int) * n);
+
+        for (int i = 0; i < n; ++i) {
+            fcntl(fdv[i], F_SETFD, FD_CLOEXEC);
+
+            if (i < 3 && conn->stdiov[i] == -1)
+                conn->stdiov[i] = fdv[i];
+            else
+                close(fdv[i]);
         }
     }
 
-    return 0;
+    if (cc == 0)
+        return EX_IOERR; // Client hung up
+
+    conn->len += cc;
+
+    if (conn->len == hdrsz) {
+        if (conn->hdr.magic != CLP_FRAME_MAGIC || conn->hdr.size > CLP_FRAME_MAX ||
+            conn->hdr.argc > conn->hdr.size / (sizeof(uint32_t) + 1))
+            return EX_PROTOCOL;
+
+        free(conn->buf);
+        conn->buf = malloc(conn->hdr.size + 1);
+        if (!conn->buf)
+            return EX_OSERR;
+    }
+
+    if (conn->len < hdrsz || conn->len < hdrsz + conn->hdr.size)
+        return 0;
+
+    rc = clp_conn_dispatch(table, conn, savev, q);
+
+    conn->len = 0;
+
+    return rc;
 }
 
-/* Like clp_parsev(), but takes a string instead of a vector.
- * Uses strsep() to break the line up by the given delimiters.
+/* Return true if the peer of the given connection runs as our own
+ * effective user.
  */
-int
-clp_parsel(const char *line, const char *delim,
-           struct clp_option *optionv,
-           struct clp_posparam *paramv)
+static bool
+clp_conn_trusted(int fd)
 {
-    char **argv;
-    int argc;
-    int rc;
+#ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
 
-    rc = clp_breakargs(line, delim, &argc, &argv);
-    if (rc)
-        return rc;
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len))
+        return false;
 
-    rc = clp_parsev(argc, argv, optionv, paramv);
+    return cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
 
-    free(argv);
+    if (getpeereid(fd, &uid, &gid))
+        return false;
 
-    return rc;
+    return uid == geteuid();
+#endif
 }
 
-/* Parse a vector of strings as specified by the given option
- * and parameter vectors (either or both of which may be nil).
+/* Reply to the client of each command that has completed on q, and
+ * return the number of commands still pending.
+ */
+static int
+clp_serve_reap(struct clp_asyncq *q, struct clp_conn *connv, int connc)
+{
+    void *arg;
+    int code, n;
+
+    while (clp_asyncq_reap(q, &code, &arg)) {
+        for (int i = 0; i < connc; ++i) {
+            if (connv[i].pending && connv[i].id == (uintptr_t)arg) {
+                if (clp_conn_reply(connv + i, code))
+                    clp_conn_close(connv + i);
+                break;
+            }
+        }
+    }
+
+    for (n = 0; connc-- > 0; ++connv)
+        n += connv->pending;
+
+    return n;
+}
+
+/* Serve commands sent by clp_client() over the Unix domain socket at
+ * path, so that a program that is run many times by scripts (each time
+ * paying for exec, dynamic linking, and table setup) can instead remain
+ * resident.  Each command's argv is received as a frame of
+ * length-prefixed words (i.e., it is not tokenized again) and parsed
+ * against the given table, with the client's stdin, stdout, and stderr
+ * (passed over the socket) in place of the server's own for the duration
+ * of the command, so that output streams directly to the client.  The
+ * exit code is then sent to the client, which may send further commands
+ * over the same connection.
  *
- * On error, returns a suggested exit code from sysexits.h.
+ * Clients are served concurrently from a poll(2) loop, i.e., partial
+ * frames from any number of clients are received as they arrive, but
+ * commands run one at a time in the server's thread.  A long running
+ * command may instead pend (see clp_async_pend()), in which case the
+ * server goes on to serve other clients, and replies to the command's
+ * client once the command completes.  A pending command should direct
+ * its output to clp_async_fd(), as the server's stdio is restored once
+ * the parse returns.  Commands run in the server's working directory
+ * and environment, and they must not call exit().  SIGPIPE is ignored
+ * while serving.
+ *
+ * The socket is accessible only by the server's user (mode 0600), and
+ * connections from processes of any other user are refused.  If path
+ * exists and is not a socket then it is not replaced, and EX_CANTCREAT
+ * is returned with errno set to EEXIST.
+ *
+ * Serving continues until *stopp (if not nil) becomes true, e.g., as set
+ * by a command's callback or by a signal handler, and then waits for
+ * all pending commands to complete.
+ *
+ * On error, sets errno and returns a suggested exit code from sysexits.h.
  */
 int
-clp_parsev(int argc, char **argv,
-           struct clp_option *optionv,
-           struct clp_posparam *paramv)
+clp_serve(struct clp_table *table, const char *path, const volatile sig_atomic_t *stopp)
 {
-    struct clp clp;
-    size_t sz;
-    int rc;
+    struct clp_conn *connv = NULL;
+    struct sigaction sa, osa;
+    struct sockaddr_un sun;
+    struct pollfd *pollv;
+    struct clp_asyncq *q;
+    struct stat sb;
+    int connc = 0, connmax = 0;
+    unsigned long id = 0;
+    int savev[3];
+    int lfd, rc, n;
+
+    if (!table || !path) {
+        errno = EINVAL;
+        return EX_DATAERR;
+    }
 
-#ifdef CLP_DEBUG
-    char *env = getenv("CLP_DEBUG");
+    /* Bind and listen on a temporary name, and then rename it to path,
+     * so that clients never find a socket that is not yet listening.
+     */
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
 
-    if (env) {
-        clp_debug = strtol(env, NULL, 0);
+    n = snprintf(sun.sun_path, sizeof(sun.sun_path), "%s.%d", path, (int)getpid());
+    if (n < 0 || (size_t)n >= sizeof(sun.sun_path)) {
+        errno = ENAMETOOLONG;
+        return EX_DATAERR;
     }
-#endif
 
-    if (argc < 1 || !argv)
-        return 0;
+    if (lstat(path, &sb) == 0 && !S_ISSOCK(sb.st_mode)) {
+        errno = EEXIST;
+        return EX_CANTCREAT;
+    }
 
-    memset(&clp, 0, sizeof(clp));
+    rc = clp_asyncq_create(&q);
+    if (rc)
+        return rc;
 
-    clp.basename = __func__;
-    if (argc > 0) {
-        clp.basename = strrchr(argv[0], '/');
-        clp.basename = (clp.basename ? clp.basename + 1 : argv[0]);
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd == -1) {
+        clp_asyncq_destroy(q);
+        return EX_OSERR;
     }
 
-    /* Validate options and initialize/reset from previous run.
+    fcntl(lfd, F_SETFD, FD_CLOEXEC);
+    fcntl(lfd, F_SETFL, O_NONBLOCK);
+
+    unlink(sun.sun_path);
+
+    /* Restrict access to the socket before it starts listening.
      */
-    if (optionv) {
-        struct clp_option *o;
+    if (bind(lfd, (struct sockaddr *)&sun, sizeof(sun)) ||
+        chmod(sun.sun_path, 0600) || listen(lfd, 128) ||
+        rename(sun.sun_path, path)) {
+        unlink(sun.sun_path);
+        close(lfd);
+        clp_asyncq_destroy(q);
+        return EX_CANTCREAT;
+    }
 
-        clp.optionv = optionv;
+    for (int i = 0; i < 3; ++i)
+        savev[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
 
-        for (o = optionv; o->optopt > 0; ++o) {
-            o->clp = &clp;
-            o->given = 0;
-            o->optarg = NULL;
-            o->next = NULL;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &osa);
 
-            /* Trim leading whitespace and set to NULL if empty.
-             */
-            o->help = clp_trim(o->help);
-            o->argname = clp_trim(o->argname);
-            o->excludes = clp_trim(o->excludes);
+    rc = 0;
 
-            if (o->cvtfunc && !o->cvtdst) {
-                o->cvtdst = memset(o->cvtdstbuf, 0, sizeof(o->cvtdstbuf));
-            }
+    while (!rc && !(stopp && *stopp)) {
+        pollv = malloc(sizeof(*pollv) * (connc + 2));
+        if (!pollv) {
+            errno = ENOMEM;
+            rc = EX_OSERR;
+            break;
+        }
 
-            if (o->cvtfunc == clp_cvt_bool || o->cvtfunc == clp_cvt_incr) {
-                o->argname = NULL;
-            } else if (!o->longopt && o->argname && strlen(o->argname) > 1) {
-                o->longopt = o->argname;
-            }
+        pollv[0].fd = lfd;
+        pollv[0].events = POLLIN;
+        pollv[1].fd = clp_asyncq_fd(q);
+        pollv[1].events = POLLIN;
 
-            if (o->after == clp_help) {
-                clp.opthelp = o->optopt;
-            }
+        /* Connections with a pending command are not polled, as they
+         * may not send another command until it completes.
+         */
+        for (int i = 0; i < connc; ++i) {
+            pollv[i + 2].fd = connv[i].pending ? -1 : connv[i].fd;
+            pollv[i + 2].events = POLLIN;
+        }
 
-            ++clp.optionc;
+        n = poll(pollv, connc + 2, -1);
+        if (n == -1) {
+            if (errno != EINTR)
+                rc = EX_OSERR;
+            free(pollv);
+            continue;
         }
 
-        if (clp.optionc > CLP_OPTION_MAX) {
-            fprintf(stderr, "%s: invalid optionc %zu\n", clp.basename, clp.optionc);
-            abort();
+        if (pollv[1].revents & POLLIN)
+            clp_serve_reap(q, connv, connc);
+
+        for (int i = 0; i < connc && !(stopp && *stopp); ++i) {
+            if (pollv[i + 2].revents && clp_conn_recv(table, connv + i, savev, q))
+                clp_conn_close(connv + i);
         }
-    }
 
-    /* Validate positional parameters and initialize/reset from previous run.
-     */
-    if (paramv) {
-        struct clp_posparam *param;
+        if (pollv[0].revents & POLLIN) {
+            int fd = accept(lfd, NULL, NULL);
 
-        clp.paramv = paramv;
-        clp.params = paramv;
+            if (fd != -1 && !clp_conn_trusted(fd)) {
+                close(fd);
+                fd = -1;
+            }
 
-        for (param = paramv; param->name; ++param) {
-            param->clp = &clp;
-            param->posmin = 0;
-            param->posmax = 0;
-            param->argc = 0;
-            param->argv = NULL;
-            param->next = NULL;
+            if (fd != -1)
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+            if (fd != -1 && connc >= connmax) {
+                int nmax = connmax ? connmax * 2 : 16;
+                struct clp_conn *tmp = realloc(connv, sizeof(*tmp) * nmax);
+
+                if (tmp) {
+                    connv = tmp;
+                    connmax = nmax;
+                }
+            }
 
-            if (param->cvtfunc && !param->cvtdst) {
-                param->cvtdst = memset(param->cvtdstbuf, 0, sizeof(param->cvtdstbuf));
+            if (fd != -1 && connc < connmax) {
+                struct clp_conn *conn = connv + connc++;
+
+                memset(conn, 0, sizeof(*conn));
+                conn->fd = fd;
+                conn->id = ++id;
+                conn->stdiov[0] = conn->stdiov[1] = conn->stdiov[2] = -1;
+            } else if (fd != -1) {
+                close(fd);
             }
         }
+
+        /* Compact the vector of connections.
+         */
+        for (int i = 0; i < connc; ) {
+            if (connv[i].fd == -1)
+                connv[i] = connv[--connc];
+            else
+                ++i;
+        }
+
+        free(pollv);
     }
 
-    /* Allocate a single chunk of memory to hold all the long options
-     * and the getopt option string.
-     */
-    sz = (clp.optionc + 1) * sizeof(*clp.longopts);
-    sz += clp.optionc * 2 + 8;
+    while (clp_serve_reap(q, connv, connc) > 0) {
+        struct pollfd pfd = { .fd = clp_asyncq_fd(q), .events = POLLIN };
 
-    clp.longopts = calloc(sz, 1);
-    if (!clp.longopts) {
-        clp_eprint(&clp, "+%d %s: malloc(%zu) longopts failed",
-                   __LINE__, __FILE__, sz);
-        return EX_OSERR;
+        poll(&pfd, 1, -1);
     }
 
-    clp.optstring = (char *)(clp.longopts + clp.optionc + 1);
-    clp.optstring[0] = '\000';
+    for (int i = 0; i < connc; ++i)
+        clp_conn_close(connv + i);
+    free(connv);
+    clp_asyncq_destroy(q);
 
-    rc = clp_parsev_impl(&clp, argc, argv);
+    sigaction(SIGPIPE, &osa, NULL);
 
-    if (rc && clp.errbuf[0])
-        fprintf(stderr, "%s: %s\n", clp.basename, clp.errbuf);
+    for (int i = 0; i < 3; ++i) {
+        if (savev[i] != -1)
+            close(savev[i]);
+    }
 
-    free(clp.longopts);
-    clp.optstring = NULL;
-    clp.longopts = NULL;
+    close(lfd);
+    unlink(path);
 
     return rc;
 }
 
-/* Create a vector of strings from words in src.
- *
- * Words are delimited by any character from delim (or isspace() if delim
- * is nil) and delimiters are elided.  Delimiters that are escaped by a
- * backslash and/or occur within quoted strings lose their significance
- * as delimiters and hence are retained with the word in which they appear.
- *
- * If delim is nil, then all whitespace between words is elided, which is
- * to say that zero-length strings between delimiters are always elided.
- * If delim is not nil, then zero-length strings between non-whitespace
- * delimiters are always preserved.
- *
- * For example:
+/* Send the given command to the server at path (see clp_serve()) along
+ * with the caller's stdin, stdout, and stderr, and wait for it to run.
+ * Returns the exit code of the command.
  *
- *    src = :one\, two,, , "four,five" :
- *    delim = ,:
- *
- *    argc = 6;
- *    argv[0] = ""
- *    argv[1] = "one, two"
- *    argv[2] = ""
- *    argv[3] = " "
- *    argv[4] = " four,five "
- *    argv[5] = ""
- *    argv[6] = NULL
- *
- * On success, argc and argv are returned via *argcp and *argvp respectively
- * (if not nil), and argv[argc] is always set to NULL.  If argvp is not nil
- * then *argvp must always be freed by the caller, even if *argcp is zero.
- *
- * On failure, errno is set and an exit code from sysexits.h is returned.
+ * On error, sets errno and returns a suggested exit code from sysexits.h
+ * (e.g., EX_UNAVAILABLE if there is no server).
  */
 int
-clp_breakargs(const char *src, const char *delim, int *argcp, char ***argvp)
+clp_client(const char *path, int argc, char **argv)
 {
-    bool backslash, dquote, squote;
-    char **argv, *prev, *dst;
-    int argcmax, argc;
-    const char *pc;
-    size_t argvsz;
-
-    if (argcp)
-        *argcp = 0;
-    if (argvp)
-        *argvp = NULL;
-
-    if (!src) {
+    union {
+        struct cmsghdr   hdr;
+        char             buf[CMSG_SPACE(sizeof(int) * 3)];
+    } cmsg;
+    int stdiov[3] = { 0, 1, 2 };
+    struct sockaddr_un sun;
+    struct clp_frame hdr;
+    struct msghdr msg;
+    struct iovec iov;
+    size_t size = 0;
+    uint32_t code;
+    char *buf, *pc;
+    ssize_t cc;
+    int fd;
+
+    if (!path || strlen(path) >= sizeof(sun.sun_path) || argc < 1 || !argv) {
         errno = EINVAL;
         return EX_DATAERR;
     }
 
-    /* Allocate enough space to hold a pointer for every non-alpha
-     * character in src[] plus a copy of the entire source string.
-     * This will generally waste a bit of space, but it greatly
-     * simplifies cleanup.
-     */
-    argcmax = 4;
-    for (pc = src; *pc; ++pc)
-        argcmax += !isalpha(*pc);
-    argvsz = sizeof(*argv) * argcmax + (pc - src + 1);
+    for (int i = 0; i < argc; ++i)
+        size += sizeof(uint32_t) + strlen(argv[i]) + 1;
 
-    argv = malloc(argvsz);
-    if (!argv) {
+    if (size > CLP_FRAME_MAX) {
+        errno = E2BIG;
+        return EX_DATAERR;
+    }
+
+    buf = malloc(size);
+    if (!buf) {
         errno = ENOMEM;
         return EX_OSERR;
     }
 
-    backslash = dquote = squote = false;
-    dst = (char *)(argv + argcmax);
-    prev = dst;
-    argc = 0;
-
-    while (1) {
-        if (backslash) {
-            backslash = false;
+    pc = buf;
+    for (int i = 0; i < argc; ++i) {
+        uint32_t len = strlen(argv[i]) + 1;
 
-            /* TODO: Should we convert printf escapes or leave
-             * unconverted in dst?
-             */
-            switch (*src) {
-            case 'a': *dst++ = '\a'; break;
-            case 'b': *dst++ = '\b'; break;
-            case 'f': *dst++ = '\f'; break;
-            case 'n': *dst++ = '\n'; break;
-            case 'r': *dst++ = '\r'; break;
-            case 't': *dst++ = '\t'; break;
-            case 'v': *dst++ = '\v'; break;
+        memcpy(pc, &len, sizeof(len));
+        memcpy(pc + sizeof(len), argv[i], len);
+        pc += sizeof(len) + len;
+    }
 
-            default:
-                if (isdigit(*src)) {
-                    char *end;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
 
-                    *dst++ = strtoul(src, &end, 8); // TODO: Test me...
-                    src = end;
-                    continue;
-                }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        free(buf);
+        return EX_OSERR;
+    }
 
-                *dst++ = *src;
-                break;
-            }
-        }
-        else if (*src == '\\') {
-            backslash = true;
-        }
-        else if (*src == '"') {
-            if (squote) {
-                *dst++ = *src;
-            } else {
-                dquote = !dquote;
-            }
-        }
-        else if (*src == '\'') {
-            if (dquote) {
-                *dst++ = *src;
-            } else {
-                squote = !squote;
-            }
-        }
-        else if (dquote || squote) {
-            *dst++ = *src;
-        }
-        else if (!delim && (!*src || isspace(*src))) {
-            if (dst > prev) {
-                argv[argc++] = prev;
-                *dst++ = '\000';
-                prev = dst;
-            }
-            // else elides leading whitespace and NUL characters...
-        } else if (delim && (pc = strchr(delim, *src))) {
-            if (dst > prev || !isspace(*pc)) {
-                argv[argc++] = prev;
-                *dst++ = '\000';
-                prev = dst;
-            }
-        } else {
-            *dst++ = *src;
-        }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
 
-        if (!*src++)
-            break;
+    if (connect(fd, (struct sockaddr *)&sun, sizeof(sun))) {
+        close(fd);
+        free(buf);
+        return EX_UNAVAILABLE;
     }
 
-    if (dquote || squote) {
-        free(argv);
-        errno = EBADMSG;
-        return EX_DATAERR;
-    }
+    hdr.magic = CLP_FRAME_MAGIC;
+    hdr.argc = argc;
+    hdr.size = size;
 
-    if (dst > prev) {
-        argv[argc++] = prev;
-        *dst++ = '\000';
-    }
+    /* Send the header along with the file descriptors, and then the
+     * arguments (which the server receives separately).
+     */
+    iov.iov_base = &hdr;
+    iov.iov_len = sizeof(hdr);
 
-    assert(argc < argcmax);
-    argv[argc] = NULL;
+    memset(&cmsg, 0, sizeof(cmsg));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
 
-    if (argcp) {
-        *argcp = argc;
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(stdiov));
+    memcpy(CMSG_DATA(&cmsg.hdr), stdiov, sizeof(stdiov));
+
+    cc = sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+    for (pc = buf; cc > 0 && pc < buf + size; pc += cc)
+        cc = send(fd, pc, buf + size - pc, MSG_NOSIGNAL);
+
+    free(buf);
+
+    if (cc == -1) {
+        close(fd);
+        return EX_IOERR;
     }
-    if (argvp) {
-        *argvp = argv;
-    } else {
-        free(argv);
+
+    for (pc = (char *)&code; pc < (char *)(&code + 1); pc += cc) {
+        cc = recv(fd, pc, (char *)(&code + 1) - pc, 0);
+        if (cc < 1) {
+            close(fd);
+            errno = cc ? errno : ECONNRESET;
+            return EX_IOERR;
+        }
     }
 
-    return 0;
+    close(fd);
+    errno = 0;
+
+    return code;
 }
@@ -29,14 +29,18 @@
 
 #define CLP_ERRBUF_MAX      (256)
 #define CLP_OPTION_MAX      (256)
-#define CLP_POSPARAM_MAX    (4096)
+#define CLP_POSPARAM_MAX    (INT_MAX)
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <math.h>
 #include <sysexits.h>
+#include <signal.h>
 #include <sys/types.h>
 
 #ifndef __printflike
@@ -77,8 +81,108 @@
  * string       char *
  * fp           FILE **         -               fopen() mode arg
  * fd           int *           open() flags    -
+ * mmap         struct clp_mmap *  MAP_POPULATE  madvise() advice (int *)
+ *                                 MAP_NORESERVE
+ * openx        int *           open() flags    struct clp_fileparms *
+ * fopenx       FILE **         -               struct clp_fileparms *
+ * list         struct clp_list *  CLP_LIST_REF  -
+ * kvmap        struct clp_kvmap * CLP_KVMAP_*  delimiters (char *)
+ * enum         int *           -               struct clp_enumtab *
+ * flags        unsigned int *  -               struct clp_enumtab *
  */
 
+/* Parameters of the openx and fopenx converters, which open files tuned
+ * for the I/O that will be done on them.  Fields that are zero are
+ * ignored.  O_DIRECT and O_NOATIME are dropped if the file system (or
+ * the file's owner) does not permit them, and preallocation is skipped
+ * by file systems that don't support it.
+ */
+struct clp_fileparms {
+    const char          *mode;          // fopen() mode (fopenx only, default "r")
+    int                  flags;         // Additional open() flags
+    mode_t               perm;          // Mode of created files (default 0644)
+    bool                 cloexec;       // Open with O_CLOEXEC
+    bool                 direct;        // Open with O_DIRECT
+    bool                 noatime;       // Open with O_NOATIME
+    int                  advice;        // posix_fadvise() advice (e.g., POSIX_FADV_SEQUENTIAL)
+    off_t                prealloc;      // Bytes to preallocate in files opened for writing
+    size_t               bufsz;         // Size of the stdio buffer (fopenx only)
+};
+
+/* The result of the mmap converter, which maps the named file read-only
+ * in its entirety (ptr is nil if the file is empty) and retains its open
+ * file descriptor.  Call clp_munmap() to unmap and close it.
+ */
+struct clp_mmap {
+    void                *ptr;
+    size_t               len;
+    int                  fd;
+};
+
+/* The result of the list converter, which accumulates every occurrence
+ * of a repeated option (e.g., "-I dir1 -I dir2") into argv[] (which is
+ * kept NULL terminated).  The arguments are copied into buf[] unless
+ * cvtflags includes CLP_LIST_REF, in which case argv[] refers directly
+ * to the parsed arguments (which must then outlive the list).  A list
+ * must be zero initialized, and is emptied by the first occurrence of
+ * its option in each parse.  Call clp_list_free() to free it.
+ */
+struct clp_list {
+    const char         **argv;
+    size_t               argc;
+    size_t               argmax;        // Allocated length of argv[]
+    char                *buf;           // Copies of the arguments
+    size_t               buflen;
+    size_t               bufsz;         // Allocated length of buf[]
+};
+
+#define CLP_LIST_REF        (0x01)  // Refer to the arguments rather than copy them
+
+/* The result of the kvmap converter, which adds each "key[=value]" pair
+ * of its arguments to a hash map.  entv[] holds the entries in the order
+ * their keys were first given, and is indexed by an open addressing hash
+ * table for lookup by clp_kvmap_find() or clp_kvmap_get().  By default
+ * the last value given for a key wins.  A map must be zero initialized,
+ * and is emptied by the first occurrence of its option in each parse.
+ * Call clp_kvmap_free() to free it.
+ */
+struct clp_kvent {
+    const char          *key;
+    const char          *val;           // nil if given without a value
+    uint32_t             hash;
+};
+
+struct clp_kvmap {
+    struct clp_kvent    *entv;
+    size_t               entc;
+    size_t               entmax;        // Allocated length of entv[]
+    uint32_t            *idxv;          // Hash table of entv[] indices (+1)
+    size_t               idxmax;        // Length of idxv[] (a power of two)
+    char                *buf;           // Copies of the keys and values
+    size_t               buflen;
+    size_t               bufsz;         // Allocated length of buf[]
+};
+
+#define CLP_KVMAP_FIRST     (0x01)  // The first value given for a key wins
+#define CLP_KVMAP_UNIQUE    (0x02)  // Reject keys given more than once
+
+/* The cvtparms of the enum and flags converters, which convert a name
+ * (or a comma separated list of names) to its value (or the bitwise OR
+ * of their values).  A name may be abbreviated to any prefix that it
+ * doesn't share with a name of a different value.  The table is compiled
+ * into a perfect hash when the option vector is compiled (or else upon
+ * first use), which may be freed by clp_enumtab_free().
+ */
+struct clp_enum {
+    const char          *name;
+    int                  value;
+};
+
+struct clp_enumtab {
+    const struct clp_enum *enumv;       // Terminated by an entry with a nil name
+    struct clp_enumhash *hash;          // Compiled from enumv[] (private)
+};
+
 /* _xoptopt    option letter for getopt (e.g., 'x')
  * _xtype      option type (e.g., int, long, ...)
  * _xvarname   name of variable in which to store converted optarg (e.g., xarg)
@@ -97,6 +201,7 @@
         .getfunc = clp_get_ ## _xtype,                                  \
         .cvtfunc = clp_cvt_ ## _xtype,                                  \
         .cvtdst = &(_xvarname),                                         \
+        .cvtdstsz = sizeof(_xvarname),                                  \
     }
 
 #define CLP_XOPTION(_xoptopt, _xtype, _xvarname, _xexcludes, _xhelp,    \
@@ -110,6 +215,7 @@
         .getfunc = clp_get_ ## _xtype,                                  \
         .cvtfunc = clp_cvt_ ## _xtype,                                  \
         .cvtdst = &(_xvarname),                                         \
+        .cvtdstsz = sizeof(_xvarname),                                  \
         .action = (_xaction),                                           \
         .after = (_xafter),                                             \
         .paramv = (_xparamv),                                           \
@@ -163,6 +269,33 @@
 #define CLP_OPTION_CONF(_xconf)                                         \
     CLP_OPTION('C', fopen, _xconf, NULL, "specify a config file")
 
+/* Like CLP_OPTION_CONF(), but also loads the config file via clp_config().
+ */
+#define CLP_OPTION_CONFIG(_xconf)                                       \
+    {                                                                   \
+        .optopt = 'C', .argname = "conf",                               \
+        .getfunc = clp_get_fopen, .cvtfunc = clp_cvt_fopen,             \
+        .cvtdst = &(_xconf), .cvtdstsz = sizeof(_xconf),                \
+        .after = clp_config,                                            \
+        .help = "specify a config file",                                \
+    }
+
+/* CLP_OPTION_ENUM() is used to define options of type enum or flags,
+ * where _xenumtab is the struct clp_enumtab of their names.
+ */
+#define CLP_OPTION_ENUM(_xoptopt, _xtype, _xvarname, _xenumtab, _xexcludes, _xhelp) \
+    {                                                                   \
+        .optopt = (_xoptopt),                                           \
+        .argname = #_xvarname,                                          \
+        .excludes = (_xexcludes),                                       \
+        .help = (_xhelp),                                               \
+        .getfunc = clp_get_ ## _xtype,                                  \
+        .cvtfunc = clp_cvt_ ## _xtype,                                  \
+        .cvtparms = &(_xenumtab),                                       \
+        .cvtdst = &(_xvarname),                                         \
+        .cvtdstsz = sizeof(_xvarname),                                  \
+    }
+
 /* Use CLP_OPTION_TMPL() to generate options with custom optarg converters
  * and/or to specify callbacks to be called after option processing.
  */
@@ -192,6 +325,7 @@
         .help = (_xhelp),                                               \
         .cvtfunc = clp_cvt_ ## _xtype,                                  \
         .cvtdst = &(_xvarname),                                         \
+        .cvtdstsz = sizeof(_xvarname),                                  \
         .action = (_xaction),                                           \
         .after = (_xafter),                                             \
     }
@@ -216,6 +350,11 @@
 
 
 struct clp;
+struct clp_async;
+struct clp_cvtlog;
+struct clp_level;
+struct clp_table;
+struct clp_error;
 struct clp_option;
 struct clp_posparam;
 
@@ -234,6 +373,42 @@ typedef void clp_get_cb(struct clp_option *option, void *dst);
 typedef int clp_option_cb(struct clp_option *option);
 typedef int clp_posparam_cb(struct clp_posparam *param);
 
+/* Returned by an action() or after() callback that has called
+ * clp_async_pend() to indicate that its command will complete later.
+ */
+#define CLP_PENDING         (-2)
+
+/* Values for clp_posparam.stream, which if not zero causes a variadic
+ * posparam to read its arguments from stdin when given "-" or when
+ * given no arguments.
+ */
+#define CLP_STREAM_NL       (1)     // Arguments are newline terminated
+#define CLP_STREAM_NUL      (2)     // Arguments are NUL terminated
+
+/* If clp_posparam.walk is set then each argument given to the posparam
+ * is expanded into the paths it names (as a glob(3) pattern and/or by
+ * walking the directories it names on a pool of threads), and each path
+ * that passes the filters below is passed to the param's converter and
+ * action in turn (in no particular order).  Symbolic links found while
+ * walking are never followed.
+ */
+#define CLP_WALK_GLOB       (0x01)  // Expand arguments as glob patterns
+#define CLP_WALK_RECURSE    (0x02)  // Walk the directories named by arguments
+#define CLP_WALK_HIDDEN     (0x04)  // Include names that start with a '.'
+
+#define CLP_WALK_REG        (0x01)  // Regular files
+#define CLP_WALK_DIR        (0x02)  // Directories
+#define CLP_WALK_LNK        (0x04)  // Symbolic links
+#define CLP_WALK_OTHER      (0x08)  // Everything else
+
+struct clp_walk {
+    int                  flags;         // CLP_WALK_GLOB, CLP_WALK_RECURSE, ...
+    int                  types;         // Types of paths to deliver (zero for all)
+    off_t                minsize;       // Min size of regular files
+    off_t                maxsize;       // Max size of regular files (zero for unlimited)
+    int                  nthreads;      // Walker threads (zero for one per CPU)
+};
+
 struct clp_posparam {
     const char          *name;          // Name shown by help for the parameter
     const char          *help;          // One line that descibes this parameter
@@ -242,9 +417,15 @@ struct clp_posparam {
     bool                 cvtsubcmd;     // if true cvtparms is a struct clp_subcmd *
     void                *cvtparms;      // Arg 3 to cvtfunc()
     void                *cvtdst;        // Where cvtfunc() stores its output
+    size_t               cvtdstsz;      // Size of *cvtdst (zero if unknown)
     clp_posparam_cb     *action;        // Called for each given positional argument
     clp_posparam_cb     *after;         // Called after all posparam processing
     void                *priv;          // Free for use by caller of clp_parse()
+    bool                 rspfile;       // Stream the words of @file arguments
+    int                  stream;        // Stream args from stdin (CLP_STREAM_*)
+    int                  cvtthreads;    // Threads to convert args (cvtfunc must be thread-safe)
+    int                  afterphase;    // Call after() concurrently in this phase (if > 0)
+    const struct clp_walk *walk;        // Expand args into paths (see CLP_WALK_*)
 
     /* The following fields are used by the option parser, whereas the above
      * fields are supplied by the user.
@@ -255,7 +436,8 @@ struct clp_posparam {
     int                  posmax;        // Max number of positional parameters
     int                  argc;          // Number of arguments assigned to this parameter
     char               **argv;          // Ptr to arguments assigned to this parameter
-    unsigned char        cvtdstbuf[16] __attribute__((__aligned__(16)));
+    long                 streamc;       // Number of arguments streamed
+    unsigned char        cvtdstbuf[32] __attribute__((__aligned__(16)));
 };
 
 struct clp_option {
@@ -269,10 +451,12 @@ struct clp_option {
     int                  cvtflags;      // Arg 2 to cvtfunc()
     void                *cvtparms;      // Arg 3 to cvtfunc()
     void                *cvtdst;        // Where cvtfunc() stores its result
+    size_t               cvtdstsz;      // Size of *cvtdst (zero if unknown)
     clp_option_cb       *action;        // Called each time an option is given
     clp_option_cb       *after;         // Called after all option processing
     struct clp_posparam *paramv;        // Option specific positional parameters
     void                *priv;          // Free for use by caller of clp_parse()
+    int                  afterphase;    // Call after() concurrently in this phase (if > 0)
 
     /* The following fields are used by the option parser, whereas the above
      * fields are supplied by the user.
@@ -282,7 +466,7 @@ struct clp_option {
     const char          *optarg;        // optarg from getopt()
     int                  given;         // Count of times this option was given
     int                  longidx;       // Index into cli->longopts[]
-    unsigned char        cvtdstbuf[16] __attribute__((__aligned__(16)));
+    unsigned char        cvtdstbuf[32] __attribute__((__aligned__(16)));
 };
 
 struct clp_subcmd {
@@ -298,12 +482,50 @@ struct clp {
     struct clp_posparam *paramv;        // Argument from clp_parsev()
     int                  opthelp;       // The option tied to opt_help()
     size_t               optionc;       // Count of elements in optionv[]
-    char                *optstring;     // The optstring for getopt
-    struct option       *longopts;      // Table of long options for getopt_long()
-    struct clp_posparam *params;        // posparam list head
+    struct clp_table    *table;         // Compiled table (nil for clp_parsev())
+    struct clp_level    *level;         // Current level of the command tree
+    int                  optind;        // Index of next argv[] element to scan
+    const char          *nextchar;      // Next option letter to scan
+    int                  optopt;        // Option letter last scanned
+    char               **argv;          // From clp_parsev()
+    struct clp_error    *error;         // Structured error of a failed parse
+    struct clp_cvtlog   *cvtlog;        // Conversions of a cached parse (if any)
+    struct clp_async    *async;         // Completion handle of a pending command
+    bool                 concurrent;    // In a concurrent after() (cannot pend)
     char                 errbuf[CLP_ERRBUF_MAX];
 };
 
+/* Kinds of errors reported via struct clp_error.
+ */
+#define CLP_ERR_NONE        (0)
+#define CLP_ERR_OPTION      (1)     // Invalid or ambiguous option
+#define CLP_ERR_NOARG       (2)     // Option requires a parameter
+#define CLP_ERR_EXCLUDES    (3)     // Option excludes a previously given option
+#define CLP_ERR_CONVERT     (4)     // Option or posparam conversion failed
+#define CLP_ERR_SUBCMD      (5)     // Invalid or ambiguous subcommand
+#define CLP_ERR_TOOFEW      (6)     // Too few positional arguments
+#define CLP_ERR_TOOMANY     (7)     // Too many positional arguments
+#define CLP_ERR_CALLBACK    (8)     // An action or after callback failed
+
+/* A parse error, as detected by clp_table_parsev_error().  String pointers
+ * refer to the argv[] given to the parser, and are valid only as long as
+ * argv[] is.  No message is formatted unless clp_error_format() is called.
+ */
+struct clp_error {
+    int                  code;          // Exit code from sysexits.h (0 if none)
+    int                  kind;          // One of CLP_ERR_*
+    int                  argind;        // Index into argv[] of arg (-1 if none)
+    int                  optopt;        // Offending option (0 if none)
+    int                  xoptopt;       // Option excluded by optopt
+    int                  count;         // Count of missing/extraneous args or matches
+    int                  xerrno;        // errno at time of the error
+    int                  opthelp;       // Help option of the subcommand (0 if none)
+    const char          *basename;      // Name of the (sub)command in error
+    const char          *arg;           // Offending argument (if any)
+    const char          *longopt;       // Long option name if optopt given as such
+    char                 detail[CLP_ERRBUF_MAX]; // Message from converter or callback
+};
+
 struct clp_suftab {
     const char *list;
     double mult[];
@@ -388,7 +610,7 @@ clp_cvt_ ## _xsuffix(struct clp *clp, const char *optarg, int flags, void *parms
     errno = 0;                                                          \
                                                                         \
     for (n = 0; n < vector->size && str; ++n, ++result) {               \
-        char *tok, *end;                                                \
+        char *tok, *end, *digits;                                       \
         long double val;                                                \
                                                                         \
         if (strbase) {                                                  \
@@ -402,8 +624,23 @@ clp_cvt_ ## _xsuffix(struct clp *clp, const char *optarg, int flags, void *parms
             str = NULL;                                                 \
         }                                                               \
                                                                         \
+        /* Plain decimal tokens (by far the most common) are converted  \
+         * in a single pass over their digits, all others by strtold(). \
+         * At most 15 digits are accumulated so that val remains exact. \
+         */                                                             \
         errno = 0;                                                      \
-        val = strtold(tok, &end);                                       \
+        digits = tok + (*tok == '-' || *tok == '+');                    \
+        end = digits;                                                   \
+        val = 0;                                                        \
+                                                                        \
+        while (*end >= '0' && *end <= '9' && end - digits < 15)         \
+            val = val * 10 + (*end++ - '0');                            \
+                                                                        \
+        if (*end || end == digits) {                                    \
+            val = strtold(tok, &end);                                   \
+        } else if (*tok == '-') {                                       \
+            val = -val;                                                 \
+        }                                                               \
                                                                         \
         if (errno) {                                                    \
             if (errno != ERANGE) {                                      \
@@ -497,6 +734,7 @@ extern struct clp_posparam clp_posparam_none[];
 
 extern struct clp_option *clp_find(int optopt, struct clp_option *optionv);
 extern struct clp_option *clp_given(int optopt, struct clp_option *optionv, void *dst);
+extern void *clp_value(struct clp *clp, int optopt);
 
 extern struct clp_suftab clp_suftab_si;
 extern struct clp_suftab clp_suftab_iec;
@@ -509,6 +747,13 @@ extern clp_cvt_cb clp_cvt_incr;
 extern clp_cvt_cb clp_cvt_open;
 extern clp_cvt_cb clp_cvt_fopen;
 extern clp_cvt_cb clp_cvt_string;
+extern clp_cvt_cb clp_cvt_mmap;
+extern clp_cvt_cb clp_cvt_openx;
+extern clp_cvt_cb clp_cvt_fopenx;
+extern clp_cvt_cb clp_cvt_list;
+extern clp_cvt_cb clp_cvt_kvmap;
+extern clp_cvt_cb clp_cvt_enum;
+extern clp_cvt_cb clp_cvt_flags;
 
 extern clp_cvt_cb clp_cvt_char, clp_cvt_u_char;
 extern clp_cvt_cb clp_cvt_short, clp_cvt_u_short;
@@ -542,6 +787,13 @@ extern clp_get_cb clp_get_incr;
 extern clp_get_cb clp_get_open;
 extern clp_get_cb clp_get_fopen;
 extern clp_get_cb clp_get_string;
+extern clp_get_cb clp_get_mmap;
+extern clp_get_cb clp_get_openx;
+extern clp_get_cb clp_get_fopenx;
+extern clp_get_cb clp_get_list;
+extern clp_get_cb clp_get_kvmap;
+extern clp_get_cb clp_get_enum;
+extern clp_get_cb clp_get_flags;
 
 extern clp_get_cb clp_get_char, clp_get_u_char;
 extern clp_get_cb clp_get_short, clp_get_u_short;
@@ -570,10 +822,40 @@ extern clp_get_cb clp_get_time_t;
 
 extern clp_option_cb clp_help;
 extern clp_option_cb clp_version;
+extern clp_option_cb clp_config;
+
+extern void clp_munmap(struct clp_mmap *map);
+extern void clp_list_free(struct clp_list *list);
+
+extern const struct clp_kvent *clp_kvmap_find(const struct clp_kvmap *map, const char *key);
+extern const char *clp_kvmap_get(const struct clp_kvmap *map, const char *key, const char *dflt);
+extern void clp_kvmap_free(struct clp_kvmap *map);
+
+extern void clp_enumtab_free(struct clp_enumtab *tab);
+
+extern int clp_fclose(FILE *fp);
 
 extern int clp_breakargs(const char *src, const char *delim,
                          int *argcp, char ***argvp);
 
+/* An incremental tokenizer breaks a stream of bytes (e.g., as read from
+ * a socket) into commands, calling the given callback with the words of
+ * each command as soon as it is terminated by a newline.
+ */
+struct clp_tokenizer;
+
+typedef int clp_tokenizer_cb(int argc, char **argv, void *arg);
+
+extern int clp_tokenizer_create(const char *delim, struct clp_tokenizer **tokp);
+
+extern void clp_tokenizer_destroy(struct clp_tokenizer *tok);
+
+extern int clp_tokenizer_feed(struct clp_tokenizer *tok, const void *buf, size_t len,
+                              clp_tokenizer_cb *cb, void *arg);
+
+extern int clp_tokenizer_finish(struct clp_tokenizer *tok,
+                                clp_tokenizer_cb *cb, void *arg);
+
 extern int clp_parsev(int argc, char **argv,
                       struct clp_option *optionv,
                       struct clp_posparam *paramv);
@@ -582,6 +864,157 @@ extern int clp_parsel(const char *line, const char *delim,
                       struct clp_option *optionv,
                       struct clp_posparam *paramv);
 
+/* A table is the compiled form of an option vector, a posparam vector,
+ * and every subcommand reachable through them.  Compile it once and then
+ * parse any number of command lines against it without re-validating
+ * the vectors or rebuilding the option and subcommand indices.
+ */
+extern int clp_table_create(struct clp_option *optionv,
+                            struct clp_posparam *paramv,
+                            struct clp_table **tablep);
+
+extern void clp_table_destroy(struct clp_table *table);
+
+extern int clp_table_parsev(struct clp_table *table, int argc, char **argv);
+
+extern int clp_table_parsel(struct clp_table *table,
+                            const char *line, const char *delim);
+
+/* Parse a sequence of commands separated by ';' or "&&" against a table.
+ */
+extern int clp_table_parseseq(struct clp_table *table, const char *line, const char *delim,
+                              const char *progname, int *cmdnop);
+
+/* Cache the results of up to nentries distinct lines given to
+ * clp_table_parsel() (or disable the cache if nentries is zero).
+ */
+extern int clp_table_cache(struct clp_table *table, size_t nentries);
+
+extern void clp_table_cache_stats(struct clp_table *table,
+                                  unsigned long *hitsp, unsigned long *missesp);
+
+/* Parse each line of the command script at path against a table.
+ */
+extern int clp_parsefile(struct clp_table *table, const char *path, const char *delim,
+                         const char *progname, int *linenop);
+
+/* Flags for clp_batch() and clp_batchfile().
+ */
+#define CLP_BATCH_ORDERED   (0x01)  // Deliver results in the order of the lines
+
+/* Called with the result of each command of a batch, and the error message
+ * if rc is not zero.  Return non-zero to cancel the rest of the batch.
+ */
+typedef int clp_batch_cb(long lineno, int rc, const char *errmsg, void *arg);
+
+/* Parse the command lines of a buffer or file against a table in parallel
+ * on a pool of threads, each of which parses against a private copy of
+ * the table's vectors.  Callbacks must therefore read values via their
+ * option or param argument or via clp_value(), not via the variables
+ * named by the vectors.
+ */
+extern int clp_batch(struct clp_table *table, const char *buf, size_t len,
+                     const char *delim, const char *progname, int nthreads, int flags,
+                     clp_batch_cb *cb, void *arg);
+
+extern int clp_batchfile(struct clp_table *table, const char *path,
+                         const char *delim, const char *progname, int nthreads, int flags,
+                         clp_batch_cb *cb, void *arg);
+
+/* Serve commands sent by clp_client() over a Unix domain socket, parsing
+ * each against a table so that the program need not be run anew for each
+ * command.
+ */
+extern int clp_serve(struct clp_table *table, const char *path,
+                     const volatile sig_atomic_t *stopp);
+
+extern int clp_client(const char *path, int argc, char **argv);
+
+/* Asynchronous commands:  A long running command's callback calls
+ * clp_async_pend() to obtain a completion handle, hands it off, and
+ * returns CLP_PENDING.  The handle is later completed with the command's
+ * exit code by clp_async_complete() (from any thread).  Commands parsed
+ * by clp_table_parsev_async() then return immediately, and their exit
+ * codes are reaped from a completion queue, whose fd is readable when
+ * completions are waiting.  All other parsers wait for the command.
+ */
+struct clp_asyncq;
+
+extern struct clp_async *clp_async_pend(struct clp *clp);
+
+extern void clp_async_complete(struct clp_async *async, int code);
+
+extern int clp_async_fd(const struct clp_async *async, int fd);
+
+extern int clp_asyncq_create(struct clp_asyncq **qp);
+
+extern void clp_asyncq_destroy(struct clp_asyncq *q);
+
+extern int clp_asyncq_fd(const struct clp_asyncq *q);
+
+extern bool clp_asyncq_reap(struct clp_asyncq *q, int *codep, void **argp);
+
+extern int clp_table_parsev_async(struct clp_table *table, int argc, char **argv,
+                                  struct clp_asyncq *q, void *arg);
+
+/* Flags for clp_table_help() and clp_table_help_fd().
+ */
+#define CLP_HELP_LONG       (0x01)  // Show long options (as does --help)
+#define CLP_HELP_USAGE      (0x02)  // Show only the usage lines
+
+extern ssize_t clp_table_help(struct clp_table *table, const char *cmd,
+                              int flags, char *buf, size_t bufsz);
+
+extern ssize_t clp_table_help_fd(struct clp_table *table, const char *cmd,
+                                 int flags, int fd);
+
+/* Like clp_table_parsev(), but on error fills in *err rather than printing
+ * a message to stderr.  Call clp_error_format() to render the message.
+ */
+extern int clp_table_parsev_error(struct clp_table *table, int argc, char **argv,
+                                  struct clp_error *err);
+
+extern int clp_error_format(const struct clp_error *err, char *buf, size_t bufsz);
+
+/* Reload the options of a table from argv[], converting, committing, and
+ * firing the callbacks of only those options whose values have changed.
+ */
+extern int clp_table_reload(struct clp_table *table, int argc, char **argv,
+                            struct clp_error *err);
+
+/* A snapshot is an immutable, reference counted copy of the values of a
+ * table's root options.  Publish a snapshot after each reload, and have
+ * reader threads acquire the published snapshot (lock-free) rather than
+ * read the option variables directly.  Files and other resources shared
+ * by a snapshot remain open until it is released.
+ */
+struct clp_snap;
+
+extern int clp_table_publish(struct clp_table *table);
+
+extern const struct clp_snap *clp_snap_acquire(struct clp_table *table);
+
+extern void clp_snap_release(const struct clp_snap *snap);
+
+extern const void *clp_snap_value(const struct clp_snap *snap, int optopt);
+
+extern unsigned long clp_snap_gen(const struct clp_snap *snap);
+
+/* Watch a config file for changes (Linux only).  When the returned fd is
+ * readable call clp_table_watch_reload() to reload and publish.
+ */
+extern int clp_table_watch(struct clp_table *table, const char *path);
+
+extern int clp_table_watch_reload(struct clp_table *table, int argc, char **argv,
+                                  struct clp_error *err);
+
+/* Save the results of the last parse of a table to fd, and later bind
+ * them to the same table (e.g., in a worker process) without reparsing.
+ */
+extern int clp_table_save(struct clp_table *table, int fd);
+
+extern int clp_table_restore(struct clp_table *table, int fd);
+
 extern void clp_eprint(struct clp *clp, const char *fmt, ...)
     __printflike(2, 3);
 
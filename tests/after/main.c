@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clp.h"
+
+int ams, bms, ecode, fcode;
+bool pflag;
+bool adone, bdone, cflag, sflag;
+char *one, *two;
+int onedone, twodone;
+
+clp_option_cb a_after, b_after, c_after, e_after, f_after, p_after, s_after;
+clp_posparam_cb one_after, two_after;
+
+#define OPTION_PHASE(_xoptopt, _xargname, _xcvtfunc, _xdst, _xafter, _xphase, _xhelp) \
+    {                                                                   \
+        .optopt = (_xoptopt), .argname = (_xargname),                   \
+        .cvtfunc = (_xcvtfunc), .cvtdst = &(_xdst),                     \
+        .cvtdstsz = sizeof(_xdst), .after = (_xafter),                  \
+        .afterphase = (_xphase), .help = (_xhelp),                      \
+    }
+
+struct clp_option optionv[] = {
+    OPTION_PHASE('a', "ms", clp_cvt_int, ams, a_after, 1, "warm cache a"),
+    OPTION_PHASE('b', "ms", clp_cvt_int, bms, b_after, 1, "warm cache b"),
+    OPTION_PHASE('c', NULL, clp_cvt_bool, cflag, c_after, 2, "load index (after a and b)"),
+    OPTION_PHASE('e', "code", clp_cvt_int, ecode, e_after, 1, "fail slowly"),
+    OPTION_PHASE('f', "code", clp_cvt_int, fcode, f_after, 1, "fail quickly"),
+    OPTION_PHASE('p', NULL, clp_cvt_bool, pflag, p_after, 1, "try to pend"),
+    OPTION_PHASE('s', NULL, clp_cvt_bool, sflag, s_after, 0, "serial after"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "[one]", .help = "open device one",
+        .cvtfunc = clp_cvt_string, .cvtdst = &one, .cvtdstsz = sizeof(one),
+        .after = one_after, .afterphase = 1,
+    },
+    {
+        .name = "[two]", .help = "open device two",
+        .cvtfunc = clp_cvt_string, .cvtdst = &two, .cvtdstsz = sizeof(two),
+        .after = two_after, .afterphase = 1,
+    },
+    CLP_POSPARAM_END
+};
+
+int
+a_after(struct clp_option *option)
+{
+    (void)option;
+    usleep(ams * 1000);
+    __atomic_store_n(&adone, true, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+int
+b_after(struct clp_option *option)
+{
+    (void)option;
+    usleep(bms * 1000);
+    __atomic_store_n(&bdone, true, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+int
+c_after(struct clp_option *option)
+{
+    (void)option;
+    printf("c: a %s, b %s\n",
+           __atomic_load_n(&adone, __ATOMIC_SEQ_CST) ? "done" : "not done",
+           __atomic_load_n(&bdone, __ATOMIC_SEQ_CST) ? "done" : "not done");
+
+    return 0;
+}
+
+int
+e_after(struct clp_option *option)
+{
+    usleep(200 * 1000);
+    clp_eprint(option->clp, "e failed with %d", ecode);
+
+    return ecode;
+}
+
+int
+f_after(struct clp_option *option)
+{
+    clp_eprint(option->clp, "f failed with %d", fcode);
+
+    return fcode;
+}
+
+int
+p_after(struct clp_option *option)
+{
+    struct clp_async *async;
+
+    async = clp_async_pend(option->clp);
+    if (!async) {
+        clp_eprint(option->clp, "unable to pend");
+        return EX_SOFTWARE;
+    }
+
+    clp_async_complete(async, 0);
+
+    return CLP_PENDING;
+}
+
+int
+s_after(struct clp_option *option)
+{
+    (void)option;
+    printf("s: a %s\n", __atomic_load_n(&adone, __ATOMIC_SEQ_CST) ? "done" : "not done");
+
+    return 0;
+}
+
+int
+one_after(struct clp_posparam *param)
+{
+    (void)param;
+    usleep(300 * 1000);
+    __atomic_store_n(&onedone, 1, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+int
+two_after(struct clp_posparam *param)
+{
+    (void)param;
+    usleep(300 * 1000);
+    __atomic_store_n(&twodone, 1, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct timespec t0, t1;
+    long ms;
+    int rc;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000;
+
+    /* Each phase of concurrent after() callbacks takes about 300ms.
+     */
+    printf("rc %d, a %d, b %d, one %d, two %d, phases %ld\n", rc, adone, bdone,
+           onedone, twodone, (ms + 150) / 300);
+
+    free(one);
+    free(two);
+
+    return rc;
+}
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "clp.h"
+
+/* A flush job, which is run by the flusher thread in FIFO order.
+ */
+struct job {
+    struct job       *next;
+    struct clp_async *async;
+    int               ms;
+    int               code;
+};
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+static struct job *head, **tail = &head;
+static bool done;
+static bool serving;
+
+int ms, code;
+char *word;
+struct clp_subcmd *cmd;
+
+static volatile sig_atomic_t stop;
+
+clp_posparam_cb echo_action, echo_after, flush_after, now_after, quit_after;
+clp_posparam_cb defer_after, fail_after;
+
+struct clp_posparam posparamv_echo[] = {
+    CLP_POSPARAM("word...", string, word, echo_action, echo_after, "words to echo"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_flush[] = {
+    CLP_POSPARAM("ms", int, ms, NULL, flush_after, "milliseconds to flush"),
+    CLP_POSPARAM("[code]", int, code, NULL, NULL, "exit code of the flush"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_now[] = {
+    CLP_POSPARAM("code", int, code, NULL, now_after, "exit code"),
+    CLP_POSPARAM_END
+};
+
+/* A command that pends but then fails before the parse completes.
+ */
+struct clp_posparam posparamv_defer[] = {
+    CLP_POSPARAM("ms", int, ms, NULL, defer_after, "milliseconds to flush"),
+    CLP_POSPARAM("code", int, code, NULL, fail_after, "exit code of the failure"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_quit[] = {
+    { .name = "now", .after = quit_after, .help = "stop the server" },
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("echo", NULL, posparamv_echo, "echo words"),
+    CLP_SUBCMD("flush", NULL, posparamv_flush, "flush in the background"),
+    CLP_SUBCMD("now", NULL, posparamv_now, "pend and complete at once"),
+    CLP_SUBCMD("defer", NULL, posparamv_defer, "pend and then fail"),
+    CLP_SUBCMD("quit", NULL, posparamv_quit, "stop the server"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+echo_action(struct clp_posparam *param)
+{
+    printf("%s ", *(char **)param->cvtdst);
+    free(*(char **)param->cvtdst);
+    *(char **)param->cvtdst = NULL;
+
+    return 0;
+}
+
+int
+echo_after(struct clp_posparam *param)
+{
+    (void)param;
+    printf("\n");
+
+    return 0;
+}
+
+int
+flush_after(struct clp_posparam *param)
+{
+    struct job *job;
+
+    job = malloc(sizeof(*job));
+    if (!job)
+        return EX_OSERR;
+
+    job->async = clp_async_pend(param->clp);
+    if (!job->async) {
+        free(job);
+        return EX_OSERR;
+    }
+
+    job->ms = ms;
+    job->code = code;
+    job->next = NULL;
+    code = 0;
+
+    printf("flushing %d\n", job->ms);
+
+    pthread_mutex_lock(&mtx);
+    *tail = job;
+    tail = &job->next;
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&mtx);
+
+    return CLP_PENDING;
+}
+
+int
+defer_after(struct clp_posparam *param)
+{
+    int saved = code;
+    int rc;
+
+    rc = flush_after(param);
+    code = saved;
+
+    return (rc == CLP_PENDING) ? 0 : rc;
+}
+
+int
+fail_after(struct clp_posparam *param)
+{
+    (void)param;
+    printf("failing %d\n", code);
+
+    return code;
+}
+
+int
+now_after(struct clp_posparam *param)
+{
+    struct clp_async *async = clp_async_pend(param->clp);
+
+    if (!async)
+        return EX_OSERR;
+
+    clp_async_complete(async, code);
+    code = 0;
+
+    return CLP_PENDING;
+}
+
+int
+quit_after(struct clp_posparam *param)
+{
+    (void)param;
+    stop = 1;
+
+    return 0;
+}
+
+static void *
+flusher(void *arg)
+{
+    struct job *job;
+
+    (void)arg;
+
+    pthread_mutex_lock(&mtx);
+    while (1) {
+        while (!head && !done)
+            pthread_cond_wait(&cv, &mtx);
+
+        job = head;
+        if (!job)
+            break;
+
+        head = job->next;
+        if (!head)
+            tail = &head;
+        pthread_mutex_unlock(&mtx);
+
+        usleep(job->ms * 1000);
+
+        /* The server's stdio is no longer that of the client.
+         */
+        if (serving)
+            dprintf(clp_async_fd(job->async, 1), "flushed %d\n", job->ms);
+
+        clp_async_complete(job->async, job->code);
+        free(job);
+
+        pthread_mutex_lock(&mtx);
+    }
+    pthread_mutex_unlock(&mtx);
+
+    return NULL;
+}
+
+/* Parse each line of stdin without waiting for pending commands, and
+ * then collect the exit codes of those that were pending.
+ */
+static int
+pipeline(struct clp_table *table)
+{
+    char **argvv[64] = { NULL };
+    struct clp_asyncq *q;
+    char line[256];
+    int npending = 0;
+    long lineno = 0;
+    int rc;
+
+    rc = clp_asyncq_create(&q);
+    if (rc)
+        return rc;
+
+    while (lineno < 63 && fgets(line, sizeof(line), stdin)) {
+        char **argv;
+        int argc;
+
+        line[strcspn(line, "\n")] = '\000';
+        ++lineno;
+
+        rc = clp_breakargs(line, NULL, &argc, &argv);
+        if (rc)
+            break;
+
+        /* argv[] must remain valid until the command completes.
+         */
+        rc = clp_table_parsev_async(table, argc, argv, q, (void *)(intptr_t)lineno);
+        if (rc == CLP_PENDING) {
+            argvv[lineno] = argv;
+            ++npending;
+            continue;
+        }
+
+        printf("%ld: rc %d\n", lineno, rc);
+        fflush(stdout);
+        free(argv);
+    }
+
+    printf("%d pending\n", npending);
+    fflush(stdout);
+
+    while (npending > 0) {
+        struct pollfd pfd = { .fd = clp_asyncq_fd(q), .events = POLLIN };
+        void *arg;
+
+        poll(&pfd, 1, -1);
+
+        while (clp_asyncq_reap(q, &rc, &arg)) {
+            printf("%ld: rc %d (async)\n", (long)(intptr_t)arg, rc);
+            free(argvv[(intptr_t)arg]);
+            --npending;
+        }
+    }
+
+    clp_asyncq_destroy(q);
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    pthread_t tid;
+    char line[256];
+    int rc;
+
+    if (argc > 2 && 0 == strcmp(argv[1], "-c"))
+        return clp_client(argv[2], argc - 3, argv + 3);
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    pthread_create(&tid, NULL, flusher, NULL);
+
+    if (argc == 3 && 0 == strcmp(argv[1], "-s")) {
+        serving = true;
+        rc = clp_serve(table, argv[2], &stop);
+    } else if (argc == 2 && 0 == strcmp(argv[1], "-l")) {
+        /* Each pending command is waited for by clp_table_parsel().
+         */
+        while (fgets(line, sizeof(line), stdin)) {
+            line[strcspn(line, "\n")] = '\000';
+            rc = clp_table_parsel(table, line, NULL);
+            printf("rc %d\n", rc);
+            fflush(stdout);
+        }
+    } else if (argc == 1) {
+        rc = pipeline(table);
+    } else {
+        fprintf(stderr, "usage: %s [-l | -s path | -c path cmd [args...]]\n", argv[0]);
+        rc = EX_USAGE;
+    }
+
+    pthread_mutex_lock(&mtx);
+    done = true;
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&mtx);
+
+    pthread_join(tid, NULL);
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "clp.h"
+
+int mult = 1;
+int number;
+bool upper;
+char *name;
+int code;
+struct clp_subcmd *cmd;
+
+clp_posparam_cb add_action, name_after, fail_action;
+
+struct clp_option optionv_add[] = {
+    CLP_OPTION('m', int, mult, NULL, "multiplier"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+struct clp_posparam posparamv_add[] = {
+    CLP_POSPARAM("number...", int, number, add_action, NULL, "numbers to add"),
+    CLP_POSPARAM_END
+};
+
+struct clp_option optionv_name[] = {
+    CLP_OPTION('u', bool, upper, NULL, "count upper case"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+struct clp_posparam posparamv_name[] = {
+    CLP_POSPARAM("name", string, name, NULL, name_after, "name to count"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_fail[] = {
+    CLP_POSPARAM("code", int, code, fail_action, NULL, "exit code"),
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("add", optionv_add, posparamv_add, "add numbers"),
+    CLP_SUBCMD("name", optionv_name, posparamv_name, "count a name"),
+    CLP_SUBCMD("fail", NULL, posparamv_fail, "fail with code"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+static long total, names;
+
+/* Callbacks run concurrently, and must access values via their
+ * option or param (not via the variables named in the vectors).
+ */
+int
+add_action(struct clp_posparam *param)
+{
+    int *multp = clp_value(param->clp, 'm');
+
+    __atomic_add_fetch(&total, *(int *)param->cvtdst * *multp, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int
+name_after(struct clp_posparam *param)
+{
+    const char *str = *(char **)param->cvtdst;
+    long n = strlen(str);
+
+    if (clp_given('u', param->clp->optionv, NULL))
+        n *= 100;
+
+    __atomic_add_fetch(&names, n, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int
+fail_action(struct clp_posparam *param)
+{
+    int rc = *(int *)param->cvtdst;
+
+    if (rc > 0)
+        clp_eprint(param->clp, "failed with %d", rc);
+
+    return rc;
+}
+
+static long lines, failed, lastline;
+static bool ordered, verbose;
+static int stopat;
+
+static int
+result(long lineno, int rc, const char *errmsg, void *arg)
+{
+    ++*(long *)arg;
+
+    if (ordered && lineno <= lastline)
+        printf("line %ld out of order\n", lineno);
+    lastline = lineno;
+
+    if (rc) {
+        ++failed;
+        if (verbose)
+            printf("line %ld: rc %d: %s\n", lineno, rc, errmsg ? errmsg : "-");
+        if (stopat && failed >= stopat)
+            return 99;
+    }
+
+    return 0;
+}
+
+int nthreads;
+bool inbuf, quiet;
+char *path;
+
+struct clp_option optionv_main[] = {
+    CLP_OPTION('b', bool, inbuf, NULL, "read the file into a buffer"),
+    CLP_OPTION('j', int, nthreads, NULL, "number of threads"),
+    CLP_OPTION('o', bool, ordered, NULL, "ordered completion"),
+    CLP_OPTION('q', bool, quiet, NULL, "let clp_batch() print errors"),
+    CLP_OPTION('s', int, stopat, NULL, "stop after this many errors"),
+    CLP_OPTION('v', bool, verbose, NULL, "print each error"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_main[] = {
+    CLP_POSPARAM("file", string, path, NULL, NULL, "command lines"),
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    int flags, rc;
+
+    rc = clp_parsev(argc, argv, optionv_main, posparamv_main);
+    if (rc)
+        return rc;
+
+    flags = ordered ? CLP_BATCH_ORDERED : 0;
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    if (inbuf) {
+        struct stat sb;
+        char *buf;
+        int fd;
+
+        fd = open(path, O_RDONLY);
+        if (fd == -1 || fstat(fd, &sb))
+            return EX_NOINPUT;
+
+        buf = malloc(sb.st_size);
+        if (!buf || read(fd, buf, sb.st_size) != sb.st_size)
+            return EX_IOERR;
+        close(fd);
+
+        rc = clp_batch(table, buf, sb.st_size, NULL, "prog", nthreads, flags,
+                       quiet ? NULL : result, &lines);
+        free(buf);
+    } else {
+        rc = clp_batchfile(table, path, NULL, "prog", nthreads, flags,
+                           quiet ? NULL : result, &lines);
+    }
+
+    printf("rc %d lines %ld failed %ld total %ld names %ld\n",
+           rc, lines, failed, total, names);
+
+    printf("mult %d number %d name %s\n", mult, number, name ? name : "(nil)");
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+bool json, brief;
+int verbosity;
+long interval = 1;
+double ratio;
+char *label;
+FILE *fp;
+int number;
+struct clp_subcmd *cmd;
+long tick;
+int tickcalls;
+
+CLP_VECTOR(ports, u_short, 4, ",");
+
+clp_option_cb stats_after;
+clp_posparam_cb stats_number, health_after;
+clp_cvt_cb cvt_tick;
+
+struct clp_option optionv_stats[] = {
+    CLP_OPTION('j', bool, json, NULL, "print json"),
+    CLP_OPTION('v', incr, verbosity, NULL, "increase verbosity"),
+    CLP_OPTION('i', long, interval, NULL, "sample interval"),
+    CLP_OPTION('r', double, ratio, NULL, "sample ratio"),
+    CLP_OPTION('l', string, label, NULL, "label"),
+    CLP_OPTION('f', fopen, fp, NULL, "file"),
+    CLP_OPTION_TMPL('p', "ports", NULL, "ports", NULL, clp_cvt_u_short, 0,
+                    &ports, ports.data, NULL, NULL, NULL),
+    {
+        .optopt = 't',
+        .argname = "tick",
+        .help = "tick",
+        .cvtfunc = cvt_tick,
+        .cvtdst = &tick,
+        .cvtdstsz = sizeof(tick),
+    },
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+struct clp_posparam posparamv_stats[] = {
+    CLP_POSPARAM("[number...]", int, number, stats_number, NULL, "numbers"),
+    CLP_POSPARAM_END
+};
+
+struct clp_option optionv_health[] = {
+    CLP_XOPTION('b', bool, brief, NULL, "brief output", "brief", NULL, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("stats", optionv_stats, posparamv_stats, "print stats"),
+    CLP_SUBCMD("health", optionv_health, NULL, "print health"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+/* A custom converter, which the cache must run anew on every parse.
+ */
+int
+cvt_tick(struct clp *clp, const char *str, int flags, void *parms, void *dst)
+{
+    (void)clp;
+    (void)flags;
+    (void)parms;
+    ++tickcalls;
+    *(long *)dst = strtol(str, NULL, 0);
+
+    return 0;
+}
+
+int
+stats_number(struct clp_posparam *param)
+{
+    printf("  number %d\n", *(int *)param->cvtdst);
+
+    return 0;
+}
+
+static void
+stats_print(void)
+{
+    printf("  stats json=%d verbosity=%d interval=%ld ratio=%.3f label=%s fp=%s",
+           json, verbosity, interval, ratio, label ? label : "(nil)",
+           fp ? "open" : "(nil)");
+
+    if (clp_given('p', optionv_stats, NULL)) {
+        for (unsigned int i = 0; i < ports.len; ++i)
+            printf("%s%u", i ? "," : " ports=", ports.data[i]);
+    }
+
+    if (clp_given('t', optionv_stats, NULL))
+        printf(" tick=%ld calls=%d", tick, tickcalls);
+
+    printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    unsigned long hits, misses;
+    size_t nentries = 0;
+    char line[1024];
+    int rc;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (argc > 1)
+        nentries = strtoul(argv[1], NULL, 0);
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    rc = clp_table_cache(table, nentries);
+    if (rc)
+        return rc;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\n")] = '\000';
+
+        printf("%s\n", line);
+
+        json = brief = false;
+        verbosity = 0;
+        interval = 1;
+        ratio = 0;
+        free(label);
+        label = NULL;
+        if (fp)
+            fclose(fp);
+        fp = NULL;
+
+        rc = clp_table_parsel(table, line, NULL);
+        if (rc) {
+            printf("  rc %d\n", rc);
+            continue;
+        }
+
+        if (cmd == subcmdv)
+            stats_print();
+        else if (cmd == subcmdv + 1)
+            printf("  health brief=%d\n", brief);
+    }
+
+    clp_table_cache_stats(table, &hits, &misses);
+    printf("hits %lu misses %lu\n", hits, misses);
+
+    free(label);
+    clp_table_destroy(table);
+
+    return 0;
+}
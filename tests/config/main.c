@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+int verbosity, count;
+bool alpha, beta;
+char *name;
+u_int ports[4];
+FILE *conf;
+
+CLP_VECTOR(portv, u_int, 4, ",");
+
+int
+count_after(struct clp_option *option)
+{
+    printf("count after: %d\n", *(int *)option->cvtdst);
+
+    return 0;
+}
+
+struct clp_option optionv[] = {
+    CLP_OPTION('a', bool, alpha, "b", "alpha mode"),
+    CLP_OPTION('b', bool, beta, "a", "beta mode"),
+    CLP_OPTION_TMPL('c', "count", NULL, "specify count", NULL,
+                    clp_cvt_int, 0, NULL, &count, NULL, count_after, NULL),
+    CLP_OPTION('N', string, name, NULL, "specify name"),
+    CLP_OPTION_TMPL('p', "ports", NULL, "specify ports", NULL,
+                    clp_cvt_u_int, 0, &portv, ports, NULL, NULL, NULL),
+    CLP_OPTION_VERBOSITY(verbosity),
+    CLP_OPTION_CONFIG(conf),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, NULL);
+    if (rc)
+        return rc;
+
+    printf("alpha=%d beta=%d count=%d name=%s verbosity=%d ports=%u,%u,%u,%u\n",
+           alpha, beta, count, name ?: "-", verbosity,
+           ports[0], ports[1], ports[2], ports[3]);
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+enum mode { MODE_SYNC, MODE_ASYNC, MODE_DIRECT, MODE_DSYNC };
+
+#define TRACE_IO    (0x01)
+#define TRACE_LOCK  (0x02)
+#define TRACE_MEM   (0x04)
+
+struct clp_enum modev[] = {
+    { "sync", MODE_SYNC },
+    { "synchronous", MODE_SYNC },
+    { "async", MODE_ASYNC },
+    { "direct", MODE_DIRECT },
+    { "dsync", MODE_DSYNC },
+    { NULL }
+};
+
+struct clp_enum tracev[] = {
+    { "io", TRACE_IO },
+    { "iolock", TRACE_IO | TRACE_LOCK },
+    { "lock", TRACE_LOCK },
+    { "mem", TRACE_MEM },
+    { "all", TRACE_IO | TRACE_LOCK | TRACE_MEM },
+    { "none", 0 },
+    { NULL }
+};
+
+struct clp_enumtab modetab = { .enumv = modev };
+struct clp_enumtab tracetab = { .enumv = tracev };
+struct clp_enumtab nametab;
+
+int mode = MODE_ASYNC;
+unsigned int trace;
+int names;
+int value;
+long sum;
+
+struct clp_option optionv[] = {
+    CLP_OPTION_ENUM('m', enum, mode, modetab, NULL, "sync, async, direct, or dsync"),
+    CLP_OPTION_ENUM('t', flags, trace, tracetab, NULL, "io, lock, mem, all, or none"),
+    CLP_OPTION('n', int, names, NULL, "generate names name0 through nameN-1"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+sum_action(struct clp_posparam *param)
+{
+    (void)param;
+    sum += value;
+
+    return 0;
+}
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "[name...]",
+        .help = "generated names",
+        .cvtfunc = clp_cvt_enum,
+        .cvtparms = &nametab,
+        .cvtdst = &value,
+        .cvtdstsz = sizeof(value),
+        .action = sum_action,
+    },
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    struct clp_enum *enumv = NULL;
+    char *namebuf = NULL;
+    int rc;
+
+    /* The names must be generated before they can be parsed.
+     */
+    for (int i = 1; i < argc - 1; ++i) {
+        if (0 == strcmp(argv[i], "-n"))
+            names = atoi(argv[i + 1]);
+    }
+
+    if (names > 0) {
+        enumv = calloc(names + 1, sizeof(*enumv));
+        namebuf = malloc(names * 16);
+        if (!enumv || !namebuf)
+            abort();
+
+        for (int i = 0; i < names; ++i) {
+            snprintf(namebuf + i * 16, 16, "name%d", i);
+            enumv[i].name = namebuf + i * 16;
+            enumv[i].value = i;
+        }
+        nametab.enumv = enumv;
+    } else {
+        static struct clp_enum nonev[] = { { "none", 0 }, { NULL } };
+
+        nametab.enumv = nonev;
+    }
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc)
+        goto out;
+
+    printf("mode %d, trace 0x%x, sum %ld\n", mode, trace, sum);
+
+    /* Every name (each a prefix of ten others) must convert to its value.
+     */
+    if (names > 0) {
+        long expect = (long)names * (names - 1) / 2;
+        char line[64];
+
+        sum = 0;
+        for (int i = 0; i < names; ++i) {
+            snprintf(line, sizeof(line), "prog name%d", i);
+            rc = clp_parsel(line, NULL, optionv, posparamv);
+            if (rc)
+                break;
+        }
+
+        printf("%d names, sum %ld (expected %ld)\n", names, sum, expect);
+    }
+
+  out:
+    clp_enumtab_free(&nametab);
+    clp_enumtab_free(&modetab);
+    clp_enumtab_free(&tracetab);
+    free(namebuf);
+    free(enumv);
+
+    return rc;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "clp.h"
+
+FILE *in, *out;
+int fd = -1;
+bool append;
+
+struct clp_fileparms inparms = {
+    .mode = "r",
+    .noatime = true,
+    .advice = POSIX_FADV_SEQUENTIAL,
+    .bufsz = 1u << 20,
+};
+
+struct clp_fileparms outparms = {
+    .mode = "w",
+    .perm = 0600,
+    .cloexec = true,
+    .prealloc = 1u << 20,
+    .bufsz = 64u << 10,
+};
+
+struct clp_fileparms fdparms = {
+    .direct = true,
+    .noatime = true,
+    .advice = POSIX_FADV_WILLNEED,
+};
+
+clp_option_cb append_action;
+
+struct clp_option optionv[] = {
+    CLP_OPTION_TMPL('i', "input", NULL, "input file", NULL,
+                    clp_cvt_fopenx, 0, &inparms, &in, NULL, NULL, NULL),
+    CLP_OPTION_TMPL('o', "output", NULL, "output file", NULL,
+                    clp_cvt_fopenx, 0, &outparms, &out, NULL, NULL, NULL),
+    CLP_OPTION_TMPL('d', "device", NULL, "device to probe", NULL,
+                    clp_cvt_openx, O_RDONLY, &fdparms, &fd, NULL, NULL, NULL),
+    CLP_OPTION_TMPL('a', NULL, "", "append to output", NULL,
+                    clp_cvt_bool, 0, NULL, &append, append_action, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+/* -a must be given before -o in order to take effect.
+ */
+int
+append_action(struct clp_option *option)
+{
+    (void)option;
+    outparms.mode = "a";
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    char buf[4096];
+    struct stat sb;
+    size_t cc;
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, NULL);
+    if (rc)
+        return rc;
+
+    if (in && out) {
+        while ((cc = fread(buf, 1, sizeof(buf), in)) > 0)
+            fwrite(buf, 1, cc, out);
+
+        if (fflush(out) == 0 && fstat(fileno(out), &sb) == 0)
+            printf("copied %lld bytes, mode %03o, cloexec %d\n", (long long)sb.st_size,
+                   sb.st_mode & 0777, !!(fcntl(fileno(out), F_GETFD) & FD_CLOEXEC));
+    }
+
+    if (fd != -1) {
+        printf("device %s, cloexec %d\n", (fstat(fd, &sb) == 0) ? "open" : "closed",
+               !!(fcntl(fd, F_GETFD) & FD_CLOEXEC));
+        close(fd);
+    }
+
+    clp_fclose(in);
+    clp_fclose(out);
+
+    return 0;
+}
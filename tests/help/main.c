@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+char version[] = "version...";
+int verbosity, dryrun, count;
+bool all, brief;
+char *name;
+struct clp_subcmd *cmd;
+
+struct clp_posparam posparamv_start[] = {
+    { .name = "service...", .help = "one or more services" },
+    CLP_POSPARAM_END
+};
+struct clp_option optionv_start[] = {
+    CLP_OPTION('c', int, count, NULL, "specify start count"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_stop[] = {
+    { .name = "[service]", .help = "service to stop" },
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("start", optionv_start, posparamv_start, "start services"),
+    CLP_SUBCMD("stop", NULL, posparamv_stop, "stop a service"),
+    CLP_SUBCMD("status", NULL, NULL, "show status"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION('a', bool, all, "b", "show all"),
+    CLP_OPTION('b', bool, brief, "a", "be brief"),
+    CLP_OPTION('N', string, name, NULL, "specify name"),
+    CLP_OPTION_STD(verbosity, version, dryrun),
+    CLP_OPTION_END
+};
+
+/* usage: prog {help|usage|long|fd|trunc|parse} cmd
+ *
+ * Print the help of the command named by cmd via clp_table_help()
+ * or clp_table_help_fd(), or via clp_parsel() with -h appended.
+ */
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    char buf[4096];
+    ssize_t len;
+    int rc;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: prog {help|usage|long|fd|trunc|parse} cmd\n");
+        return 1;
+    }
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    if (0 == strcmp(argv[1], "parse")) {
+        snprintf(buf, sizeof(buf), "%s -h", argv[2]);
+        rc = clp_table_parsel(table, buf, NULL);
+    } else if (0 == strcmp(argv[1], "fd")) {
+        len = clp_table_help_fd(table, argv[2], 0, STDOUT_FILENO);
+        if (len == -1)
+            perror(argv[2]);
+        rc = (len == -1);
+    } else {
+        int flags = 0;
+        size_t bufsz = sizeof(buf);
+
+        if (0 == strcmp(argv[1], "usage"))
+            flags = CLP_HELP_USAGE;
+        else if (0 == strcmp(argv[1], "long"))
+            flags = CLP_HELP_LONG;
+        else if (0 == strcmp(argv[1], "trunc"))
+            bufsz = 32;
+
+        /* Call twice to exercise the cached help text.
+         */
+        for (int i = 0; i < 2; ++i) {
+            len = clp_table_help(table, argv[2], flags, buf, bufsz);
+            if (len == -1) {
+                perror(argv[2]);
+                rc = 1;
+                break;
+            }
+
+            printf("%zd %zu\n%s%s", len, strlen(buf), buf,
+                   (size_t)len >= bufsz ? "\n" : "");
+        }
+    }
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+struct clp_kvmap tunables;
+struct clp_kvmap labels;
+struct clp_kvmap env;
+char *keys;
+long count;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('c', long, count, NULL, "look up keys k1 through kN"),
+    CLP_OPTION('k', string, keys, NULL, "comma separated keys to look up"),
+    {
+        .optopt = 'l',
+        .argname = "label",
+        .help = "add a unique label",
+        .getfunc = clp_get_kvmap,
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtflags = CLP_KVMAP_UNIQUE,
+        .cvtdst = &labels,
+        .cvtdstsz = sizeof(labels),
+    },
+    {
+        .optopt = 'o',
+        .argname = "name=value[,...]",
+        .help = "set tunables",
+        .getfunc = clp_get_kvmap,
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtparms = ",",
+        .cvtdst = &tunables,
+        .cvtdstsz = sizeof(tunables),
+    },
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "[name=value...]",
+        .help = "environment (the first value of a name wins)",
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtflags = CLP_KVMAP_FIRST,
+        .cvtdst = &env,
+        .cvtdstsz = sizeof(env),
+    },
+    CLP_POSPARAM_END
+};
+
+void
+show(const char *name, const struct clp_kvmap *map)
+{
+    printf("%s: %zu", name, map->entc);
+    for (size_t i = 0; i < map->entc && map->entc < 16; ++i) {
+        const struct clp_kvent *ent = map->entv + i;
+
+        printf(" %s%s%s", ent->key, ent->val ? "=" : "", ent->val ? ent->val : "");
+    }
+    printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc)
+        return rc;
+
+    show("tunables", &tunables);
+    show("labels", &labels);
+    show("env", &env);
+
+    for (char *key = keys ? strtok(keys, ",") : NULL; key; key = strtok(NULL, ",")) {
+        printf("lookup %s: %s%s\n", key,
+               clp_kvmap_find(&tunables, key) ? "found " : "",
+               clp_kvmap_get(&tunables, key, "(default)"));
+    }
+
+    if (count > 0) {
+        long found = 0, matched = 0;
+
+        for (long i = 1; i <= count; ++i) {
+            char key[32], val[32];
+            const char *pc;
+
+            snprintf(key, sizeof(key), "k%ld", i);
+            snprintf(val, sizeof(val), "v%ld", i);
+
+            pc = clp_kvmap_get(&tunables, key, NULL);
+            found += !!pc;
+            matched += (pc && 0 == strcmp(pc, val));
+        }
+
+        printf("looked up %ld keys, %ld found, %ld matched\n", count, found, matched);
+    }
+
+    clp_kvmap_free(&tunables);
+    clp_kvmap_free(&labels);
+    clp_kvmap_free(&env);
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+struct clp_list incdirs;
+struct clp_list defines;
+struct clp_list files;
+char *line;
+bool verbose;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('I', list, incdirs, NULL, "add dir to the include path"),
+    {
+        .optopt = 'D',
+        .argname = "name",
+        .help = "define name (by reference)",
+        .getfunc = clp_get_list,
+        .cvtfunc = clp_cvt_list,
+        .cvtflags = CLP_LIST_REF,
+        .cvtdst = &defines,
+        .cvtdstsz = sizeof(defines),
+    },
+    CLP_OPTION('l', string, line, NULL, "reparse the given line"),
+    CLP_OPTION('v', bool, verbose, NULL, "print each element"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "[file...]",
+        .help = "files",
+        .cvtfunc = clp_cvt_list,
+        .cvtdst = &files,
+        .cvtdstsz = sizeof(files),
+    },
+    CLP_POSPARAM_END
+};
+
+void
+show(const char *name, int optopt)
+{
+    struct clp_list list = { .argc = 0 };
+
+    if (!optopt)
+        list = files;
+    else
+        clp_given(optopt, optionv, &list);
+
+    printf("%s: %zu", name, list.argc);
+    if (list.argc > 0)
+        printf(" first %s last %s", list.argv[0], list.argv[list.argc - 1]);
+    printf("%s\n", list.argv && list.argv[list.argc] ? " unterminated" : "");
+
+    for (size_t i = 0; verbose && i < list.argc; ++i)
+        printf("  [%zu] %s\n", i, list.argv[i]);
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc)
+        return rc;
+
+    show("incdirs", 'I');
+    show("defines", 'D');
+    show("files", 0);
+
+    /* The copied elements of -I must survive the line's argv, and each
+     * parse starts a given list anew.
+     */
+    if (line) {
+        char *copy = line;
+
+        line = NULL;
+        rc = clp_parsel(copy, NULL, optionv, posparamv);
+        free(copy);
+        if (rc)
+            return rc;
+
+        show("incdirs", 'I');
+        show("files", 0);
+    }
+
+    clp_list_free(&incdirs);
+    clp_list_free(&defines);
+    clp_list_free(&files);
+
+    return 0;
+}
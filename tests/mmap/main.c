@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+#include "clp.h"
+
+struct clp_mmap pattern = { .fd = -1 };
+struct clp_mmap input = { .fd = -1 };
+int advice = MADV_SEQUENTIAL;
+
+clp_posparam_cb input_action;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('p', mmap, pattern, NULL, "file of patterns"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "file...",
+        .help = "files to scan",
+        .cvtfunc = clp_cvt_mmap,
+        .cvtflags = MAP_POPULATE,
+        .cvtparms = &advice,
+        .cvtdst = &input,
+        .cvtdstsz = sizeof(input),
+        .action = input_action,
+    },
+    CLP_POSPARAM_END
+};
+
+/* Count the lines of each mapped file, and the number of times the
+ * first line of the pattern file appears within it.
+ */
+int
+input_action(struct clp_posparam *param)
+{
+    const char *pc = input.ptr, *end = pc + input.len;
+    static int idx;
+    size_t patlen = 0;
+    long nlines = 0, nmatches = 0;
+
+    if (pattern.ptr) {
+        const char *eol = memchr(pattern.ptr, '\n', pattern.len);
+
+        patlen = eol ? (size_t)(eol - (char *)pattern.ptr) : pattern.len;
+    }
+
+    while (pc < end) {
+        const char *eol = memchr(pc, '\n', end - pc);
+        size_t len = (eol ? eol : end) - pc;
+
+        if (patlen > 0 && len == patlen && 0 == memcmp(pc, pattern.ptr, patlen))
+            ++nmatches;
+
+        ++nlines;
+        pc += len + 1;
+    }
+
+    printf("%s: %zu bytes, %ld lines", param->argv[idx++], input.len, nlines);
+    if (patlen > 0)
+        printf(", %ld matches", nmatches);
+    printf("\n");
+
+    clp_munmap(&input);
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_mmap map;
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    if (clp_given('p', optionv, &map))
+        printf("pattern %s, fd %s\n", map.ptr ? "mapped" : "empty",
+               (map.fd > 2) ? "open" : "invalid");
+
+    clp_munmap(&pattern);
+
+    return rc;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+char version[] = "version...";
+int verbosity, dryrun;
+char *cluster_name = "default";
+bool force;
+int timeout;
+char *key;
+struct clp_subcmd *cmd, *cluster_cmd, *node_cmd;
+
+clp_posparam_cb node_action, list_action, config_action;
+
+/* prog cluster node {drain,add} ...
+ */
+struct clp_posparam posparamv_drain[] = {
+    CLP_POSPARAM("node...", string, key, node_action, NULL, "one or more nodes"),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv_drain[] = {
+    CLP_OPTION('t', int, timeout, NULL, "specify drain timeout"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_add[] = {
+    CLP_POSPARAM("node", string, key, node_action, NULL, "node to add"),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv_add[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_subcmd subcmdv_node[] = {
+    CLP_SUBCMD("drain", optionv_drain, posparamv_drain, "drain nodes"),
+    CLP_SUBCMD("add", optionv_add, posparamv_add, "add a node"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv_node[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv_node, &node_cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv_node[] = {
+    CLP_OPTION('f', bool, force, NULL, "force"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+/* prog cluster {node,list} ...
+ */
+struct clp_posparam posparamv_list[] = {
+    { .name = "[pattern]", .help = "list nodes matching pattern", .after = list_action },
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv_cluster[] = {
+    CLP_SUBCMD("node", optionv_node, posparamv_node, "node commands"),
+    CLP_SUBCMD("nodes", NULL, posparamv_list, "list nodes"),
+    CLP_SUBCMD("list", NULL, posparamv_list, "list nodes"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv_cluster[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv_cluster, &cluster_cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv_cluster[] = {
+    CLP_OPTION('c', string, cluster_name, NULL, "specify cluster name"),
+    CLP_OPTION_VERBOSITY(verbosity),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+/* prog {cluster,config} ...
+ */
+struct clp_posparam posparamv_config[] = {
+    CLP_POSPARAM("[key]", string, key, config_action, NULL, "config key"),
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("cluster", optionv_cluster, posparamv_cluster, "cluster commands"),
+    CLP_SUBCMD("config", NULL, posparamv_config, "show config"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    { .name = "[args...]", .help = "subcommand arguments" },
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_STD(verbosity, version, dryrun),
+    CLP_OPTION_END
+};
+
+int
+node_action(struct clp_posparam *param)
+{
+    printf("%s %s: cluster=%s force=%d timeout=%d verbosity=%d %s=%s\n",
+           cluster_cmd->name, node_cmd->name, cluster_name, force,
+           timeout, verbosity, param->name, key);
+
+    free(key);
+    key = NULL;
+
+    return 0;
+}
+
+int
+list_action(struct clp_posparam *param)
+{
+    printf("%s: cluster=%s verbosity=%d pattern=%s\n",
+           cluster_cmd->name, cluster_name, verbosity, param->argv[0]);
+
+    return 0;
+}
+
+int
+config_action(struct clp_posparam *param)
+{
+    printf("%s: %s=%s\n", cmd->name, param->name, key);
+
+    free(key);
+    key = NULL;
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    struct clp_error err;
+    char errbuf[CLP_ERRBUF_MAX];
+    int rc, i;
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    /* Parse the command line with clp_parsev() and then again with
+     * the compiled table, both of which should produce the same output.
+     * If both fail, then parse it once more to get the structured error.
+     */
+    for (i = 0; i < 3; ++i) {
+        force = false;
+        timeout = 0;
+        verbosity = 0;
+
+        if (i == 0) {
+            rc = clp_parsev(argc, argv, optionv, posparamv);
+        } else if (i == 1) {
+            rc = clp_table_parsev(table, argc, argv);
+            if (!rc)
+                break;
+        } else {
+            rc = clp_table_parsev_error(table, argc, argv, &err);
+
+            clp_error_format(&err, errbuf, sizeof(errbuf));
+            printf("error %d: kind=%d argind=%d optopt=%c count=%d arg=%s: %s\n",
+                   err.code, err.kind, err.argind, err.optopt ?: '-', err.count,
+                   err.arg ? err.arg : "-", errbuf);
+        }
+    }
+
+    clp_table_destroy(table);
+
+    return rc;
+}
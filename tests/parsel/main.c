@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+int ival;
+u_int uval;
+long lval;
+int8_t i8val;
+double dval;
+int words;
+size_t wordlen;
+char *word;
+
+CLP_VECTOR(intv, int, 4, ",");
+
+struct clp_option optionv[] = {
+    CLP_OPTION('i', int, ival, NULL, "int"),
+    CLP_OPTION('u', u_int, uval, NULL, "u_int"),
+    CLP_OPTION('l', long, lval, NULL, "long"),
+    CLP_OPTION('b', int8_t, i8val, NULL, "int8_t"),
+    CLP_OPTION('d', double, dval, NULL, "double"),
+    CLP_OPTION_TMPL('v', "intv", NULL, "int vector", NULL, clp_cvt_int, 0,
+                    &intv, intv.data, NULL, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+word_action(struct clp_posparam *param)
+{
+    (void)param;
+    ++words;
+    wordlen += strlen(word);
+    free(word);
+    word = NULL;
+
+    return 0;
+}
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("[word...]", string, word, word_action, NULL, "words"),
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table = NULL;
+    char line[8192];
+    int rc;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (argc > 1 && 0 == strcmp(argv[1], "table")) {
+        rc = clp_table_create(optionv, posparamv, &table);
+        if (rc)
+            return rc;
+    }
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\n")] = '\000';
+
+        ival = uval = lval = i8val = 0;
+        dval = 0;
+        words = wordlen = 0;
+        intv.len = 0;
+
+        if (table)
+            rc = clp_table_parsel(table, line, NULL);
+        else
+            rc = clp_parsel(line, NULL, optionv, posparamv);
+
+        printf("rc %d%s%s: i %d u %u l %ld b %d d %.3f v",
+               rc, rc ? " " : "", rc ? strerror(errno) : "",
+               ival, uval, lval, i8val, dval);
+
+        for (unsigned int i = 0; i < intv.len; ++i)
+            printf("%s%d", i ? "," : " ", intv.data[i]);
+
+        printf(" words %d len %zu\n", words, wordlen);
+    }
+
+    clp_table_destroy(table);
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <dirent.h>
+
+#include "clp.h"
+
+int threads = 1;
+FILE *fp;
+long value;
+long nfiles, nlines, order;
+long nvalues, sum;
+struct clp_subcmd *cmd;
+
+clp_option_cb threads_action;
+clp_posparam_cb file_action, file_after, value_action, value_after;
+
+struct clp_option optionv[] = {
+    CLP_OPTION_TMPL('t', "threads", NULL, "number of conversion threads",
+                    NULL, clp_cvt_int, 0, NULL, &threads, threads_action, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_lines[] = {
+    {
+        .name = "file...",
+        .help = "files to count",
+        .cvtfunc = clp_cvt_fopen,
+        .cvtdst = &fp,
+        .cvtdstsz = sizeof(fp),
+        .action = file_action,
+        .after = file_after,
+    },
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_sum[] = {
+    {
+        .name = "value...",
+        .help = "values to sum",
+        .cvtfunc = clp_cvt_long,
+        .cvtdst = &value,
+        .cvtdstsz = sizeof(value),
+        .action = value_action,
+        .after = value_after,
+        .stream = CLP_STREAM_NL,
+    },
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("lines", NULL, posparamv_lines, "count lines of files"),
+    CLP_SUBCMD("sum", NULL, posparamv_sum, "sum values"),
+    CLP_SUBCMD_END
+};
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+
+int
+threads_action(struct clp_option *option)
+{
+    (void)option;
+    posparamv_lines[0].cvtthreads = threads;
+    posparamv_sum[0].cvtthreads = threads;
+
+    return 0;
+}
+
+int
+file_action(struct clp_posparam *param)
+{
+    char line[128];
+    long n = 0;
+
+    (void)param;
+
+    while (fgets(line, sizeof(line), fp))
+        ++n;
+
+    fclose(fp);
+    fp = NULL;
+
+    /* order is sensitive to the order in which the files are counted.
+     */
+    order = (order * 31 + n) % 1000000007;
+    nlines += n;
+    ++nfiles;
+
+    return 0;
+}
+
+int
+file_after(struct clp_posparam *param)
+{
+    (void)param;
+    printf("%ld files, %ld lines, order %ld\n", nfiles, nlines, order);
+
+    return 0;
+}
+
+int
+value_action(struct clp_posparam *param)
+{
+    (void)param;
+    sum += value;
+    ++nvalues;
+
+    if (value < 0)
+        return EX_DATAERR;
+
+    return 0;
+}
+
+int
+value_after(struct clp_posparam *param)
+{
+    (void)param;
+    printf("%ld values, sum %ld\n", nvalues, sum);
+
+    return 0;
+}
+
+/* Count our open file descriptors (to verify that unused files are closed).
+ */
+static int
+nfds(void)
+{
+    struct dirent *dent;
+    DIR *dir;
+    int n = 0;
+
+    dir = opendir("/proc/self/fd");
+    if (!dir)
+        return -1;
+
+    while ((dent = readdir(dir)))
+        n += (dent->d_name[0] != '.');
+
+    closedir(dir);
+
+    return n - 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    int fds = nfds();
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    if (rc)
+        printf("rc %d, %ld files, %ld values, sum %ld\n", rc, nfiles, nvalues, sum);
+
+    if (nfds() != fds)
+        printf("leaked %d fds\n", nfds() - fds);
+
+    return rc;
+}
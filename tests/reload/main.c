@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+int verbosity, count = 10;
+bool alpha, beta;
+char *name = "default";
+u_int ports[4];
+FILE *log_fp;
+struct clp_list incdirs;
+struct clp_kvmap tunables;
+
+CLP_VECTOR(portv, u_int, 4, ",");
+
+int
+changed(struct clp_option *option)
+{
+    printf("  changed -%c %s\n", option->optopt, option->optarg ?: "");
+
+    return 0;
+}
+
+int
+log_after(struct clp_option *option)
+{
+    printf("  after -%c %s (%s)\n", option->optopt, option->optarg,
+           *(FILE **)option->cvtdst ? "open" : "closed");
+
+    return 0;
+}
+
+struct clp_option optionv[] = {
+    CLP_XOPTION('a', bool, alpha, "b", "alpha mode", NULL, changed, NULL, NULL),
+    CLP_XOPTION('b', bool, beta, "a", "beta mode", NULL, changed, NULL, NULL),
+    CLP_XOPTION('c', int, count, NULL, "specify count", NULL, changed, NULL, NULL),
+    {
+        .optopt = 'o',
+        .argname = "name[=value][,...]",
+        .help = "set tunables",
+        .getfunc = clp_get_kvmap,
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtparms = ",",
+        .cvtdst = &tunables,
+        .cvtdstsz = sizeof(tunables),
+        .action = changed,
+    },
+    CLP_XOPTION('N', string, name, NULL, "specify name", NULL, changed, NULL, NULL),
+    CLP_XOPTION('I', list, incdirs, NULL, "add dir to the include path", NULL, changed, NULL, NULL),
+    CLP_XOPTION('l', fopen, log_fp, NULL, "specify log file", NULL, NULL, log_after, NULL),
+    CLP_OPTION_TMPL('p', "ports", NULL, "specify ports", NULL,
+                    clp_cvt_u_int, 0, &portv, ports, changed, NULL, NULL),
+    CLP_XOPTION('v', incr, verbosity, NULL, "increase verbosity", NULL, changed, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+/* Reload the table from each argument in turn (each of which is a
+ * command line), printing the options' values after each reload.
+ */
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    int rc, i;
+
+    rc = clp_table_create(optionv, NULL, &table);
+    if (rc)
+        return rc;
+
+    for (i = 1; i < argc; ++i) {
+        char **xargv;
+        int xargc;
+
+        rc = clp_breakargs(argv[i], NULL, &xargc, &xargv);
+        if (rc)
+            break;
+
+        printf("reload: %s\n", argv[i]);
+
+        rc = clp_table_reload(table, xargc, xargv, NULL);
+
+        printf("  rc=%d alpha=%d beta=%d count=%d name=%s log=%s verbosity=%d ports=%u,%u\n",
+               rc, alpha, beta, count, name, log_fp ? "open" : "closed",
+               verbosity, ports[0], ports[1]);
+
+        if (incdirs.argc > 0) {
+            printf("  incdirs:");
+            for (size_t j = 0; j < incdirs.argc; ++j)
+                printf(" %s", incdirs.argv[j]);
+            printf("\n");
+        }
+
+        if (tunables.entc > 0) {
+            printf("  tunables:");
+            for (size_t j = 0; j < tunables.entc; ++j)
+                printf(" %s=%s", tunables.entv[j].key, tunables.entv[j].val ?: "(nil)");
+            printf("\n");
+        }
+
+        free(xargv);
+    }
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+int verbosity, shown = 5;
+char *prefix;
+long value;
+long nvalues, sum;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('s', int, shown, NULL, "number of values to show"),
+    CLP_OPTION('v', incr, verbosity, NULL, "increase verbosity"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+prefix_action(struct clp_posparam *param)
+{
+    printf("prefix %s\n", *(char **)param->cvtdst);
+
+    return 0;
+}
+
+int
+value_action(struct clp_posparam *param)
+{
+    if (nvalues++ < shown)
+        printf("value %ld\n", *(long *)param->cvtdst);
+    sum += *(long *)param->cvtdst;
+
+    return 0;
+}
+
+int
+value_after(struct clp_posparam *param)
+{
+    printf("%ld values (from %d arguments), sum %ld\n", nvalues, param->argc, sum);
+
+    return 0;
+}
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("prefix", string, prefix, prefix_action, NULL, "a prefix"),
+    {
+        .name = "value...",
+        .help = "values (or @file of values)",
+        .cvtfunc = clp_cvt_long,
+        .cvtdst = &value,
+        .cvtdstsz = sizeof(value),
+        .action = value_action,
+        .after = value_after,
+        .rspfile = true,
+    },
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    return rc;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "clp.h"
+
+int verbosity, count;
+double ratio = 0.5;
+char *name = "none";
+u_int ports[4];
+FILE *input;
+char *file;
+struct clp_list incdirs;
+struct clp_kvmap tunables;
+
+CLP_VECTOR(portv, u_int, 4, ",");
+
+struct clp_option optionv[] = {
+    CLP_OPTION('c', int, count, NULL, "specify count"),
+    CLP_OPTION('i', fopen, input, NULL, "specify input file"),
+    CLP_OPTION('I', list, incdirs, NULL, "add dir to the include path"),
+    CLP_OPTION('N', string, name, NULL, "specify name"),
+    {
+        .optopt = 'o',
+        .argname = "name[=value][,...]",
+        .help = "set tunables",
+        .getfunc = clp_get_kvmap,
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtparms = ",",
+        .cvtdst = &tunables,
+        .cvtdstsz = sizeof(tunables),
+    },
+    CLP_OPTION_TMPL('p', "ports", NULL, "specify ports", NULL,
+                    clp_cvt_u_int, 0, &portv, ports, NULL, NULL, NULL),
+    CLP_OPTION('r', double, ratio, NULL, "specify ratio"),
+    CLP_OPTION('v', incr, verbosity, NULL, "increase verbosity"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("files...", string, file, NULL, NULL, "one or more files"),
+    CLP_POSPARAM_END
+};
+
+/* An incompatible table, to which a saved parse must not be bound.
+ */
+struct clp_option otheroptionv[] = {
+    CLP_OPTION('c', int, count, NULL, "specify count"),
+    CLP_OPTION_END
+};
+
+static void
+show(void)
+{
+    char line[64];
+
+    printf("count=%d (given %d) name=%s ratio=%.2f verbosity=%d ports=%u,%u,%u\n",
+           count, optionv[0].given, name, ratio, verbosity,
+           ports[0], ports[1], ports[2]);
+
+    printf("input=%s (%s)", input ? "open" : "closed", optionv[1].optarg ?: "-");
+    if (input && fgets(line, sizeof(line), input))
+        printf(" first line: %s", line);
+    else
+        printf("\n");
+
+    printf("incdirs argc=%zu:", incdirs.argc);
+    for (size_t i = 0; i < incdirs.argc; ++i)
+        printf(" %s", incdirs.argv[i]);
+    printf("\n");
+
+    printf("tunables entc=%zu:", tunables.entc);
+    for (size_t i = 0; i < tunables.entc; ++i)
+        printf(" %s=%s", tunables.entv[i].key, tunables.entv[i].val ?: "(nil)");
+    printf(" (c=%s)\n", clp_kvmap_get(&tunables, "c", "-"));
+
+    printf("file=%s argc=%d:", file, posparamv[0].argc);
+    for (int i = 0; i < posparamv[0].argc; ++i)
+        printf(" %s", posparamv[0].argv[i]);
+    printf("\n");
+}
+
+/* Usage:  prog save path args...
+ *         prog restore path
+ *         prog reload path args...
+ *         prog other path
+ *         prog corrupt path
+ */
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    int rc, fd;
+
+    if (argc < 3)
+        return EX_USAGE;
+
+    /* Point the value of the first option (count) beyond the end of the
+     * blob, leaving its header intact.
+     */
+    if (0 == strcmp(argv[1], "corrupt")) {
+        uint64_t valoff = UINT64_MAX - 8;
+
+        fd = open(argv[2], O_WRONLY);
+        if (fd == -1 || pwrite(fd, &valoff, sizeof(valoff), 40) != sizeof(valoff))
+            return EX_IOERR;
+        close(fd);
+
+        return 0;
+    }
+
+    rc = clp_table_create(0 == strcmp(argv[1], "other") ? otheroptionv : optionv,
+                          posparamv, &table);
+    if (rc)
+        return rc;
+
+    if (0 == strcmp(argv[1], "save")) {
+        rc = clp_table_parsev(table, argc - 2, argv + 2);
+        if (!rc) {
+            fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            rc = clp_table_save(table, fd);
+            close(fd);
+            show();
+        }
+    } else if (0 == strcmp(argv[1], "reload")) {
+        const char *line = "-c 1 y";
+        unsigned long hits, misses;
+
+        /* Restoring must discard the cached parses, but not the cache.
+         */
+        clp_table_cache(table, 8);
+        clp_table_parsel(table, line, NULL);
+
+        fd = open(argv[2], O_RDONLY);
+        rc = clp_table_restore(table, fd);
+        if (!rc) {
+            clp_table_parsel(table, line, NULL);
+            clp_table_parsel(table, line, NULL);
+            clp_table_cache_stats(table, &hits, &misses);
+            printf("cache hits=%lu misses=%lu\n", hits, misses);
+
+            /* Options not given to the reload revert to their defaults.
+             */
+            rc = clp_table_restore(table, fd);
+            if (!rc)
+                rc = clp_table_reload(table, argc - 3, argv + 3, NULL);
+        }
+        close(fd);
+        if (rc)
+            printf("reload: %s\n", strerror(errno));
+        show();
+    } else {
+        fd = open(argv[2], O_RDONLY);
+        rc = clp_table_restore(table, fd);
+        close(fd);
+        if (rc)
+            printf("restore: %s\n", strerror(errno));
+        show();
+    }
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <ctype.h>
+
+#include "clp.h"
+
+int count = 1;
+bool upper;
+char *word;
+int number;
+struct clp_subcmd *cmd;
+char *delim;
+char *progname = "prog";
+
+clp_posparam_cb echo_action, sum_action, sum_after;
+
+struct clp_option optionv_echo[] = {
+    CLP_OPTION('n', int, count, NULL, "repeat count"),
+    CLP_OPTION('u', bool, upper, NULL, "convert to upper case"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+struct clp_posparam posparamv_echo[] = {
+    CLP_POSPARAM("word...", string, word, echo_action, NULL, "words to echo"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_sum[] = {
+    CLP_POSPARAM("number...", int, number, sum_action, sum_after, "numbers to sum"),
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("echo", optionv_echo, posparamv_echo, "echo words"),
+    CLP_SUBCMD("sum", NULL, posparamv_sum, "sum numbers"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+echo_action(struct clp_posparam *param)
+{
+    char *pc = *(char **)param->cvtdst;
+
+    for (int i = 0; i < count; ++i) {
+        for (char *c = pc; upper && *c; ++c)
+            *c = toupper(*c);
+        printf("%s%s", pc, (i < count - 1) ? " " : "\n");
+    }
+
+    free(pc);
+    count = 1;
+    upper = false;
+
+    return 0;
+}
+
+static long sum;
+
+int
+sum_action(struct clp_posparam *param)
+{
+    sum += *(int *)param->cvtdst;
+
+    return 0;
+}
+
+int
+sum_after(struct clp_posparam *param)
+{
+    printf("sum of %d numbers is %ld\n", param->argc, sum);
+    sum = 0;
+
+    return 0;
+}
+
+struct clp_option optionv_main[] = {
+    CLP_OPTION('d', string, delim, NULL, "specify delimiters"),
+    CLP_OPTION('p', string, progname, NULL, "specify program name (- for none)"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_main[] = {
+    CLP_POSPARAM("script", string, word, NULL, NULL, "command script"),
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    int rc, lineno;
+
+    rc = clp_parsev(argc, argv, optionv_main, posparamv_main);
+    if (rc)
+        return rc;
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    rc = clp_parsefile(table, word, delim,
+                       strcmp(progname, "-") ? progname : NULL, &lineno);
+
+    printf("rc %d at line %d\n", rc, lineno);
+
+    clp_table_destroy(table);
+
+    return rc;
+}
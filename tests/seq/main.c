@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+bool fail;
+int verbosity;
+long count;
+char *word;
+struct clp_subcmd *cmd;
+
+clp_posparam_cb echo_word;
+clp_option_cb count_after, fail_after;
+
+struct clp_option optionv_run[] = {
+    CLP_OPTION('f', bool, fail, NULL, "fail"),
+    CLP_OPTION('v', incr, verbosity, NULL, "increase verbosity"),
+    CLP_OPTION('c', long, count, NULL, "count"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+struct clp_posparam posparamv_echo[] = {
+    CLP_POSPARAM("[word...]", string, word, echo_word, NULL, "words"),
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("run", optionv_run, NULL, "run"),
+    CLP_SUBCMD("echo", NULL, posparamv_echo, "echo words"),
+    CLP_SUBCMD_END
+};
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+echo_word(struct clp_posparam *param)
+{
+    printf("  echo [%s]\n", *(char **)param->cvtdst);
+    free(word);
+    word = NULL;
+
+    return 0;
+}
+
+int
+count_after(struct clp_option *option)
+{
+    printf("  run -%c verbosity=%d count=%ld\n", option->optopt, verbosity, count);
+
+    return 0;
+}
+
+int
+fail_after(struct clp_option *option)
+{
+    printf("  run -%c\n", option->optopt);
+
+    return EX_SOFTWARE;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *progname = "prog";
+    struct clp_table *table;
+    char line[8192];
+    int cmdno, rc;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    setvbuf(stderr, NULL, _IOLBF, 0);
+
+    if (argc > 1 && 0 == strcmp(argv[1], "noprog"))
+        progname = NULL;
+
+    optionv_run[0].after = fail_after;
+    optionv_run[2].after = count_after;
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\n")] = '\000';
+
+        printf("%s\n", line);
+
+        fail = false;
+        verbosity = 0;
+        count = 0;
+
+        rc = clp_table_parseseq(table, line, NULL, progname, &cmdno);
+
+        printf("rc %d cmdno %d\n", rc, cmdno);
+    }
+
+    clp_table_destroy(table);
+
+    return 0;
+}
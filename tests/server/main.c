@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <ctype.h>
+
+#include "clp.h"
+
+int number;
+char *word;
+bool upper;
+struct clp_subcmd *cmd;
+
+static volatile sig_atomic_t stop;
+
+clp_posparam_cb echo_action, echo_after, sum_action, sum_after, cat_after, quit_after;
+
+struct clp_option optionv_echo[] = {
+    CLP_OPTION('u', bool, upper, NULL, "convert to upper case"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+struct clp_posparam posparamv_echo[] = {
+    CLP_POSPARAM("word...", string, word, echo_action, echo_after, "words to echo"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_sum[] = {
+    CLP_POSPARAM("number...", int, number, sum_action, sum_after, "numbers to sum"),
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_cat[] = {
+    { .name = "file", .after = cat_after, .help = "file to count (- for stdin)" },
+    CLP_POSPARAM_END
+};
+
+struct clp_posparam posparamv_quit[] = {
+    { .name = "now", .after = quit_after, .help = "stop the server" },
+    CLP_POSPARAM_END
+};
+
+struct clp_subcmd subcmdv[] = {
+    CLP_SUBCMD("echo", optionv_echo, posparamv_echo, "echo words"),
+    CLP_SUBCMD("sum", NULL, posparamv_sum, "sum numbers"),
+    CLP_SUBCMD("cat", NULL, posparamv_cat, "count lines"),
+    CLP_SUBCMD("quit", NULL, posparamv_quit, "stop the server"),
+    CLP_SUBCMD_END
+};
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM_SUBCMD("cmd", subcmdv, &cmd, NULL),
+    CLP_POSPARAM_END
+};
+struct clp_option optionv[] = {
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+echo_action(struct clp_posparam *param)
+{
+    char *pc = *(char **)param->cvtdst;
+
+    for (char *c = pc; upper && *c; ++c)
+        *c = toupper(*c);
+
+    printf("%s ", pc);
+    free(pc);
+    *(char **)param->cvtdst = NULL;
+
+    return 0;
+}
+
+int
+echo_after(struct clp_posparam *param)
+{
+    (void)param;
+    printf("\n");
+    upper = false;
+
+    return 0;
+}
+
+static long sum;
+
+int
+sum_action(struct clp_posparam *param)
+{
+    sum += *(int *)param->cvtdst;
+
+    return 0;
+}
+
+int
+sum_after(struct clp_posparam *param)
+{
+    printf("sum of %d numbers is %ld\n", param->argc, sum);
+    sum = 0;
+
+    return 0;
+}
+
+int
+cat_after(struct clp_posparam *param)
+{
+    FILE *fp = stdin;
+    char line[128];
+    int n = 0;
+
+    if (strcmp(param->argv[0], "-")) {
+        fp = fopen(param->argv[0], "r");
+        if (!fp) {
+            clp_eprint(param->clp, "unable to open %s", param->argv[0]);
+            return EX_NOINPUT;
+        }
+    }
+
+    while (fgets(line, sizeof(line), fp))
+        ++n;
+
+    printf("%d lines\n", n);
+
+    if (fp != stdin)
+        fclose(fp);
+
+    return 0;
+}
+
+int
+quit_after(struct clp_posparam *param)
+{
+    (void)param;
+    stop = 1;
+
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_table *table;
+    int rc;
+
+    if (argc > 2 && 0 == strcmp(argv[1], "-c"))
+        return clp_client(argv[2], argc - 3, argv + 3);
+
+    if (argc != 3 || strcmp(argv[1], "-s")) {
+        fprintf(stderr, "usage: %s -s path | -c path cmd [args...]\n", argv[0]);
+        return EX_USAGE;
+    }
+
+    rc = clp_table_create(optionv, posparamv, &table);
+    if (rc)
+        return rc;
+
+    rc = clp_serve(table, argv[2], &stop);
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#include "clp.h"
+
+int left, right;
+char *name = "none";
+int verbosity;
+FILE *conf;
+int infd = -1;
+struct clp_list incdirs;
+struct clp_kvmap tunables;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('l', int, left, NULL, "specify left"),
+    CLP_OPTION('r', int, right, NULL, "specify right"),
+    CLP_OPTION('N', string, name, NULL, "specify name"),
+    CLP_OPTION('v', incr, verbosity, NULL, "increase verbosity"),
+    CLP_OPTION('i', open, infd, NULL, "specify input file"),
+    CLP_OPTION('I', list, incdirs, NULL, "add dir to the include path"),
+    {
+        .optopt = 'o',
+        .argname = "name[=value][,...]",
+        .help = "set tunables",
+        .getfunc = clp_get_kvmap,
+        .cvtfunc = clp_cvt_kvmap,
+        .cvtparms = ",",
+        .cvtdst = &tunables,
+        .cvtdstsz = sizeof(tunables),
+    },
+    CLP_OPTION_CONFIG(conf),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+static struct clp_table *table;
+static bool stop;
+
+static void
+show(const struct clp_snap *snap)
+{
+    printf("gen %lu: left=%d right=%d name=%s verbosity=%d\n",
+           clp_snap_gen(snap),
+           *(const int *)clp_snap_value(snap, 'l'),
+           *(const int *)clp_snap_value(snap, 'r'),
+           *(char * const *)clp_snap_value(snap, 'N'),
+           *(const int *)clp_snap_value(snap, 'v'));
+}
+
+/* Check that every snapshot seen has left == right, and that the name
+ * agrees with them, while the main thread reloads and publishes.
+ */
+static void *
+reader(void *arg)
+{
+    long *errs = arg;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        const struct clp_snap *snap;
+        char buf[32];
+        int l, r;
+
+        snap = clp_snap_acquire(table);
+        l = *(const int *)clp_snap_value(snap, 'l');
+        r = *(const int *)clp_snap_value(snap, 'r');
+
+        snprintf(buf, sizeof(buf), "name-%d", l);
+        if (l != r || strcmp(buf, *(char * const *)clp_snap_value(snap, 'N')))
+            ++*errs;
+
+        clp_snap_release(snap);
+    }
+
+    return NULL;
+}
+
+static int
+race(int nreaders, int nreloads)
+{
+    pthread_t tidv[nreaders];
+    long errv[nreaders];
+    long errs = 0;
+    int rc = 0;
+
+    for (int i = 0; i <= nreloads && !rc; ++i) {
+        char line[128];
+        char **argv;
+        int argc;
+
+        snprintf(line, sizeof(line), "prog -l %d -N name-%d -r %d", i, i, i);
+
+        rc = clp_breakargs(line, NULL, &argc, &argv);
+        if (!rc) {
+            rc = clp_table_reload(table, argc, argv, NULL);
+            if (!rc)
+                rc = clp_table_publish(table);
+            free(argv);
+        }
+
+        /* Start the readers once the first snapshot is published.
+         */
+        for (int j = 0; j < nreaders && i == 0; ++j) {
+            errv[j] = 0;
+            pthread_create(tidv + j, NULL, reader, errv + j);
+        }
+    }
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < nreaders; ++i) {
+        pthread_join(tidv[i], NULL);
+        errs += errv[i];
+    }
+
+    printf("%d readers, %d reloads, %ld inconsistent snapshots\n",
+           nreaders, nreloads, errs);
+
+    return rc;
+}
+
+static int
+watch(const char *path)
+{
+    char *argv[] = { "prog", "-C", (char *)path, NULL };
+    const struct clp_snap *old, *snap;
+    struct pollfd pfd;
+    FILE *fp;
+    int rc;
+
+    rc = clp_table_reload(table, 3, argv, NULL);
+    if (!rc)
+        rc = clp_table_publish(table);
+    if (rc)
+        return rc;
+
+    old = clp_snap_acquire(table);
+    show(old);
+
+    pfd.fd = clp_table_watch(table, path);
+    pfd.events = POLLIN;
+    if (pfd.fd == -1) {
+        perror("clp_table_watch");
+        return EX_OSERR;
+    }
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return EX_CANTCREAT;
+    fprintf(fp, "-l 7\n-r 8\n-N changed\n-v\n-v\n");
+    fclose(fp);
+
+    if (poll(&pfd, 1, 5000) != 1) {
+        printf("no change detected\n");
+        return EX_SOFTWARE;
+    }
+
+    rc = clp_table_watch_reload(table, 3, argv, NULL);
+    if (rc)
+        return rc;
+
+    /* The old snapshot is unaffected by the reload.
+     */
+    snap = clp_snap_acquire(table);
+    show(old);
+    show(snap);
+    printf("globals: left=%d right=%d name=%s\n", left, right, name);
+    clp_snap_release(snap);
+    clp_snap_release(old);
+
+    /* Nothing more is pending, so this is a no-op.
+     */
+    rc = clp_table_watch_reload(table, 3, argv, NULL);
+    snap = clp_snap_acquire(table);
+    show(snap);
+    clp_snap_release(snap);
+
+    return rc;
+}
+
+/* Check that a file opened by one reload remains open while a snapshot
+ * that shares it is held, even if a later reload replaces the file and
+ * further snapshots are published, and that the snapshot's copies of a
+ * list and a map are unaffected by the reload.
+ */
+static int
+hold(const char *path1, const char *path2)
+{
+    char *argv1[] = { "prog", "-i", (char *)path1, "-I", "x", "-I", "y", "-o", "k=v1", NULL };
+    char *argv2[] = { "prog", "-i", (char *)path2, "-I", "z", "-o", "k=v2", NULL };
+    const struct clp_list *list;
+    const struct clp_snap *snap;
+    int fd, rc;
+
+    rc = clp_table_reload(table, 9, argv1, NULL);
+    if (!rc)
+        rc = clp_table_publish(table);
+    if (rc)
+        return rc;
+
+    snap = clp_snap_acquire(table);
+    fd = *(const int *)clp_snap_value(snap, 'i');
+
+    rc = clp_table_publish(table);
+    if (!rc)
+        rc = clp_table_reload(table, 7, argv2, NULL);
+    if (!rc)
+        rc = clp_table_publish(table);
+
+    list = clp_snap_value(snap, 'I');
+    printf("held fd %s, list", fcntl(fd, F_GETFD) == -1 ? "closed" : "open");
+    for (size_t i = 0; i < list->argc; ++i)
+        printf(" %s", list->argv[i]);
+    printf(" (live list %s), k=%s (live k=%s)\n", incdirs.argv[0],
+           clp_kvmap_get(clp_snap_value(snap, 'o'), "k", "-"),
+           clp_kvmap_get(&tunables, "k", "-"));
+    clp_snap_release(snap);
+    printf("released fd %s\n", fcntl(fd, F_GETFD) == -1 ? "closed" : "open");
+
+    return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_table_create(optionv, NULL, &table);
+    if (rc)
+        return rc;
+
+    if (!clp_snap_acquire(table))
+        printf("no snapshot\n");
+
+    if (argc > 2 && 0 == strcmp(argv[1], "watch"))
+        rc = watch(argv[2]);
+    else if (argc > 3 && 0 == strcmp(argv[1], "hold"))
+        rc = hold(argv[2], argv[3]);
+    else if (argc > 3 && 0 == strcmp(argv[1], "race"))
+        rc = race(atoi(argv[2]), atoi(argv[3]));
+    else
+        rc = EX_USAGE;
+
+    clp_table_destroy(table);
+
+    return rc;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "clp.h"
+
+int shown = 5;
+bool nul;
+char *prefix;
+long value;
+long nvalues, sum;
+
+struct clp_posparam posparamv[];
+
+int
+nul_action(struct clp_option *option)
+{
+    if (*(bool *)option->cvtdst)
+        posparamv[1].stream = CLP_STREAM_NUL;
+
+    return 0;
+}
+
+struct clp_option optionv[] = {
+    CLP_XOPTION('0', bool, nul, NULL, "arguments are NUL terminated",
+                NULL, nul_action, NULL, NULL),
+    CLP_OPTION('s', int, shown, NULL, "number of values to show"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+value_action(struct clp_posparam *param)
+{
+    if (nvalues++ < shown)
+        printf("value %ld\n", *(long *)param->cvtdst);
+    sum += *(long *)param->cvtdst;
+
+    return 0;
+}
+
+int
+value_after(struct clp_posparam *param)
+{
+    printf("%ld values (%d given, %ld streamed), sum %ld\n",
+           nvalues, param->argc, param->streamc, sum);
+
+    return 0;
+}
+
+struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("prefix", string, prefix, NULL, NULL, "a prefix"),
+    {
+        .name = "value...",
+        .help = "values (or - to read values from stdin)",
+        .cvtfunc = clp_cvt_long,
+        .cvtdst = &value,
+        .cvtdstsz = sizeof(value),
+        .action = value_action,
+        .after = value_after,
+        .stream = CLP_STREAM_NL,
+    },
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    printf("prefix %s, rc %d\n", prefix ?: "-", rc);
+
+    return rc;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "clp.h"
+
+int chunk = 4096;
+char *delim;
+int limit;
+
+struct clp_option optionv[] = {
+    CLP_OPTION('c', int, chunk, NULL, "feed stdin in chunks of this size"),
+    CLP_OPTION('d', string, delim, NULL, "specify delimiters"),
+    CLP_OPTION('n', int, limit, NULL, "stop after this many commands"),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+static int
+command(int argc, char **argv, void *arg)
+{
+    int *ncmds = arg;
+
+    printf("%d:", argc);
+    for (int i = 0; i < argc; ++i)
+        printf(" [%s]", argv[i]);
+    printf("\n");
+
+    return (++*ncmds == limit) ? EX_SOFTWARE : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct clp_tokenizer *tok;
+    int ncmds = 0;
+    ssize_t cc;
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, NULL);
+    if (rc)
+        return rc;
+
+    if (chunk < 1)
+        return EX_USAGE;
+
+    rc = clp_tokenizer_create(delim, &tok);
+    if (rc)
+        return rc;
+
+    char buf[chunk];
+
+    while (!rc && (cc = read(0, buf, chunk)) > 0)
+        rc = clp_tokenizer_feed(tok, buf, cc, command, &ncmds);
+
+    if (!rc)
+        rc = clp_tokenizer_finish(tok, command, &ncmds);
+
+    printf("%d commands, rc %d\n", ncmds, rc);
+
+    clp_tokenizer_destroy(tok);
+
+    return rc;
+}
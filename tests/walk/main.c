@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include "clp.h"
+
+struct clp_walk walk = { .flags = CLP_WALK_GLOB };
+bool recurse, hidden;
+char *types;
+long minsize, maxsize;
+int nthreads;
+long limit;
+
+char *path;
+char **pathv;
+size_t pathc, pathmax;
+
+/* Apply the walk options as they are given (i.e., before the posparams
+ * are converted).
+ */
+int
+walk_action(struct clp_option *option)
+{
+    (void)option;
+    walk.flags = CLP_WALK_GLOB;
+    if (recurse)
+        walk.flags |= CLP_WALK_RECURSE;
+    if (hidden)
+        walk.flags |= CLP_WALK_HIDDEN;
+
+    walk.types = 0;
+    for (char *pc = types; pc && *pc; ++pc) {
+        walk.types |= (*pc == 'f') ? CLP_WALK_REG : (*pc == 'd') ? CLP_WALK_DIR :
+            (*pc == 'l') ? CLP_WALK_LNK : CLP_WALK_OTHER;
+    }
+
+    walk.minsize = minsize;
+    walk.maxsize = maxsize;
+    walk.nthreads = nthreads;
+
+    return 0;
+}
+
+struct clp_option optionv[] = {
+    CLP_XOPTION('a', bool, hidden, NULL, "include hidden files",
+                NULL, walk_action, NULL, NULL),
+    CLP_XOPTION('j', int, nthreads, NULL, "number of walker threads",
+                NULL, walk_action, NULL, NULL),
+    CLP_OPTION('l', long, limit, NULL, "fail after this many paths"),
+    CLP_XOPTION('M', long, maxsize, NULL, "max size of regular files",
+                NULL, walk_action, NULL, NULL),
+    CLP_XOPTION('m', long, minsize, NULL, "min size of regular files",
+                NULL, walk_action, NULL, NULL),
+    CLP_XOPTION('r', bool, recurse, NULL, "walk directories",
+                NULL, walk_action, NULL, NULL),
+    CLP_XOPTION('t', string, types, NULL, "types of paths (f, d, l, o)",
+                NULL, walk_action, NULL, NULL),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+int
+path_action(struct clp_posparam *param)
+{
+    (void)param;
+    if (limit > 0 && (long)pathc >= limit) {
+        fprintf(stderr, "limit of %ld paths reached\n", limit);
+        return EX_SOFTWARE;
+    }
+
+    if (pathc >= pathmax) {
+        pathmax = pathmax ? pathmax * 2 : 64;
+        pathv = realloc(pathv, sizeof(*pathv) * pathmax);
+        if (!pathv)
+            abort();
+    }
+
+    pathv[pathc++] = path;
+    path = NULL;
+
+    return 0;
+}
+
+int
+pathcmp(const void *lhs, const void *rhs)
+{
+    return strcmp(*(char * const *)lhs, *(char * const *)rhs);
+}
+
+struct clp_posparam posparamv[] = {
+    {
+        .name = "path...",
+        .help = "files, directories, or glob patterns",
+        .cvtfunc = clp_cvt_string,
+        .cvtdst = &path,
+        .cvtdstsz = sizeof(path),
+        .action = path_action,
+        .walk = &walk,
+    },
+    CLP_POSPARAM_END
+};
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+
+    qsort(pathv, pathc, sizeof(*pathv), pathcmp);
+
+    for (size_t i = 0; i < pathc; ++i) {
+        printf("%s\n", pathv[i]);
+        free(pathv[i]);
+    }
+    printf("%zu paths, rc %d\n", pathc, rc);
+
+    free(pathv);
+    free(types);
+
+    return rc;
+}